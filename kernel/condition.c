@@ -4,18 +4,63 @@
  * 线程自动放弃 CPU，等待条件满足再被唤醒的机制
 ***********************************************************************/
 
+#include "types.h"
+#include "riscv.h"
+#include "consts.h"
 #include "condition.h"
 #include "thread.h"
+#include "ktimer.h"
+
+// 初始化条件变量，等待队列为空；静态分配的条件变量全为 0，无需调用
+void
+initCondition(Condvar *self)
+{
+    self->waitQueue.head = 0;
+    self->waitQueue.tail = 0;
+}
 
 // 将当前线程加入到等待队列中
+// 调用者需持有 lock，函数返回时重新持有 lock
 void
-waitCondition(Condvar *self)
+waitCondition(Condvar *self, Spinlock *lock)
 {
     pushBack(&self->waitQueue, getCurrentTid());    // 插入等待队列
-    yieldCPU();     // 主动放弃 CPU，并进入休眠状态
+    prepareSleepCPU();  // 先标记为休眠，释放锁之后到达的唤醒会撤销这次休眠
+    releaseLock(lock);
+    yieldCPU();         // 主动放弃 CPU，并进入休眠状态
+    acquireLock(lock);
+}
+
+// 超时定时器回调，唤醒等待线程
+static void
+conditionTimeout(Ktimer *t)
+{
+    wakeupCPU((int)t->data);
+}
+
+// 与 waitCondition 相同，但最多等待 timeout 个 time 计数
+// 返回：0-被通知唤醒，-ETIMEDOUT-超时（或被其他原因唤醒）且未被通知
+long
+waitConditionTimeout(Condvar *self, Spinlock *lock, usize timeout)
+{
+    int tid = getCurrentTid();
+    Ktimer t;
+    initKtimer(&t, conditionTimeout, tid);
+    pushBack(&self->waitQueue, tid);
+    prepareSleepCPU();
+    addKtimer(&t, r_time() + timeout, timerSlack(timeout));
+    releaseLock(lock);
+    yieldCPU();
+    cancelKtimer(&t);
+    acquireLock(lock);
+    // 仍在等待队列中说明没有被通知，将自己移出，之后的通知不会落空
+    if(removeItem(&self->waitQueue, tid)) {
+        return -ETIMEDOUT;
+    }
+    return 0;
 }
 
-// 从等待队列中唤醒一个线程
+// 从等待队列中唤醒一个线程，调用者需持有 waitCondition 时使用的锁
 void
 notifyCondition(Condvar *self)
 {
@@ -25,3 +70,12 @@ notifyCondition(Condvar *self)
         wakeupCPU(tid);     // 唤醒线程，参与调度
     }
 }
+
+// 唤醒等待队列中的所有线程
+void
+notifyAllCondition(Condvar *self)
+{
+    while(!isEmpty(&self->waitQueue)) {
+        wakeupCPU((int)popFront(&self->waitQueue));
+    }
+}
@@ -8,13 +8,18 @@
 #define _CONDITION_H
 
 #include "queue.h"
+#include "spinlock.h"
 
 // 条件变量，内部为等待该条件满足的等待线程队列
+// 等待队列由调用者传入的自旋锁保护，检查条件、加入队列和休眠在同一把锁下完成，不会丢失唤醒
 typedef struct {
     Queue waitQueue;
 } Condvar;
 
-void waitCondition(Condvar *self);
+void initCondition(Condvar *self);
+void waitCondition(Condvar *self, Spinlock *lock);
+long waitConditionTimeout(Condvar *self, Spinlock *lock, usize timeout);
 void notifyCondition(Condvar *self);
+void notifyAllCondition(Condvar *self);
 
-#endif
\ No newline at end of file
+#endif
@@ -16,10 +16,10 @@ extern void bss_end();                          /* .bbs 段结束虚拟地址 */
 extern void kernel_end();                       /* 内核所在内存空间结束的虚拟地址 */
 
 /* 动态内存中定义堆的相关常量 */
-#define KERNEL_HEAP_SIZE    0x800000            /* 堆空间大小 8M */
+#define KERNEL_HEAP_SIZE    0x2000000           /* 堆空间大小 32M */
 #define MIN_BLOCK_SIZE      0x40                /* 最小分配的内存块大小 64bytes */
-#define HEAP_BLOCK_NUM      0x20000             /* 管理的总块数 */
-#define BUDDY_NODE_NUM      0x3ffff             /* 二叉树节点个数 HEAP_BLOCK_NUM*2-1 */
+#define HEAP_BLOCK_NUM      0x80000             /* 管理的总块数 */
+#define BUDDY_NODE_NUM      0xfffff             /* 二叉树节点个数 HEAP_BLOCK_NUM*2-1 */
 
 #define PAGE_SIZE           4096                /* 页/帧大小 */
 #define MEMORY_START_PADDR  0x80000000          /* 可以访问的内存区域起始地址 */
@@ -31,10 +31,39 @@ extern void kernel_end();                       /* 内核所在内存空间结
 #define KERNEL_PAGE_OFFSET  0xffffffff00000     /* 内核页面线性映射偏移 */
 #define PDE_MASK            0x003ffffffffffC00  /* 该掩码用于从页表项中获取物理页号 */
 
-#define KERNEL_STACK_SIZE   0x80000             /* 内核栈大小 */
+#define KERNEL_STACK_SIZE   0x4000              /* 内核栈大小 */
+#define MAX_KERNEL_STACKS   (KERNEL_HEAP_SIZE / 2 / KERNEL_STACK_SIZE) /* 内核栈最多占用一半堆空间，超出时拒绝创建线程 */
 #define USER_STACK_SIZE     0x80000             /* 用户栈大小 */
 #define USER_STACK_OFFSET   0xffffffff00000000  /* 用户栈起始虚拟地址 */
+#define USER_THREAD_STACK_SIZE 0x10000          /* 进程中其他线程的用户栈大小，依次排在主线程栈之后，之间隔一个保护页 */
+#define USER_VDSO_ADDR      (USER_STACK_OFFSET - 2 * PAGE_SIZE) /* 共享数据页的用户虚拟地址，与用户栈之间隔一个保护页 */
+#define USER_URING_PAGES    2                   /* 提交/完成环形队列共享区的页数 */
+#define USER_URING_ADDR     (USER_VDSO_ADDR - (USER_URING_PAGES + 1) * PAGE_SIZE) /* 环形队列共享区的用户虚拟地址，与共享数据页之间隔一个保护页 */
+#define USER_SHM_END        (USER_URING_ADDR - PAGE_SIZE)   /* 共享内存段只能映射在 [USER_SHM_BASE, USER_SHM_END) 中，内核从高往低分配 */
+#define USER_SHM_BASE       (USER_SHM_END - 0x10000000)
+#define MAX_PROCESS_THREADS 16                  /* 每个进程最多同时存在的线程数（用户栈槽位数） */
+#define MAX_FDS             16                  /* 每个进程的文件描述符表大小 */
 
-#define MAX_THREAD          0x40                /* 线程池最大线程数 */
+#define TID_INDEX_BITS      12                  /* 线程号的低位为线程表下标，高位为槽位的代数 */
+#define MAX_THREAD          (1 << TID_INDEX_BITS) /* 线程号中下标的编码范围 */
+#define MAX_LIVE_THREADS    MAX_KERNEL_STACKS   /* 线程表最大容量：每个线程（含 idle）占用一个内核栈，槽位与栈一起回收 */
+#define THREAD_CHUNK        64                  /* 线程表每次增长的槽位数 */
+#define MAX_CPU             4                   /* 支持的最大 hart 数，需与 entry.S 中启动栈个数一致 */
+
+#define TIMEBASE_FREQ       10000000            /* time 寄存器的频率（QEMU virt 为 10MHz） */
+#define TICK_INTERVAL       100000              /* 时钟中断间隔（time 寄存器计数） */
+
+/* 系统调用错误码，系统调用返回其相反数 */
+#define EINTR               4                   /* 等待被其他原因打断 */
+#define EBADF               9                   /* 文件描述符无效 */
+#define EAGAIN              11                  /* 条件不满足，需要重试 */
+#define ENOMEM              12                  /* 内存或地址空间不足 */
+#define EFAULT              14                  /* 用户地址无效 */
+#define EBUSY               16                  /* 资源不足（如实时带宽） */
+#define EINVAL              22                  /* 参数无效 */
+#define EMFILE              24                  /* 文件描述符表已满 */
+#define ENOSPC              28                  /* 表项已用完 */
+#define EPIPE               32                  /* 管道的读端或 IPC 端口的服务端已全部关闭 */
+#define ETIMEDOUT           110                 /* 等待超时 */
 
 #endif
\ No newline at end of file
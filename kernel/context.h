@@ -8,6 +8,9 @@
 
 #include "types.h"
 
+/* 线程内核栈顶保留的字节数，线程在 U-Mode 运行时这里记录它所在 hart 的编号，进入内核时取回到 tp */
+#define KSTACK_TRAP_RESERVE     16
+
 /* 中断发生前后的程序上下文 */
 typedef struct
 {
@@ -13,13 +13,23 @@ void    consolePutchar(usize c);
 usize   consoleGetchar();
 void    shutdown() __attribute__((noreturn));
 void    setTimer(usize time);
+int     sbiProbeExtension(usize ext);
+void    sendIPI(usize hart);
+long    hartGetStatus(usize hart);
+int     hartStart(usize hart, usize startAddr, usize opaque);
+void    remoteSfenceVma(usize hartMask, usize start, usize size);
+long    sbiDebugWrite(char *buf, usize len);
 
 /* printf.c */
 void printf(char *, ...);
 void panic(char*) __attribute__((noreturn));
+void consoleWrite(char *buf, usize len);
+void consoleWriteSleep(char *buf, usize len);
+void klog(int level, char *, ...);
 
 /* heap.c */
 void *kalloc(int size);
+void *tryKalloc(int size);
 void kfree(void *ptr);
 
 /* memory.c */
@@ -29,6 +39,15 @@ void deallocFrame(usize ppn);
 /* processor.c */
 void exitFromCPU(usize code);
 
+/* timer.c */
+void printTimerStats();
+void benchTimerProgram();
+
+/* syscall.c */
+long sysRead(usize fd, char *buf, usize len);
+long sysWrite(usize fd, char *buf, usize len);
+usize sysExec(char *path, int *stdio);
+
 /* string.c */
 int strlen(char *str);
 int strcmp(char *str1, char *str2);
@@ -0,0 +1,507 @@
+/************************* EDF 实时调度类 ******************************
+ * Author：Joker001014
+ * 2025.03.27
+ * 实时线程在设置参数时被划分到一个 hart，之后只在该 hart 上运行，不参与窃取
+ *      准入控制：每个 hart 上实时线程的密度 runtime / deadline 之和不超过 EDF_MAX_BW，超出则拒绝
+ *      分派：本 hart 有就绪的实时线程时，运行绝对截止时刻最早的一个，否则交给普通调度算法
+ *      预算：时钟中断时扣除实时线程的运行时间，预算用完的线程被限流到下一个周期
+ *      线程通过 sched_yield 表示本周期的作业已完成；截止时刻到达仍未完成则记为一次错过
+ * 预算以时钟中断为粒度检查，一次超支最多一个 tick
+***********************************************************************/
+
+#include "types.h"
+#include "def.h"
+#include "consts.h"
+#include "riscv.h"
+#include "thread.h"
+#include "spinlock.h"
+#include "ipi.h"
+#include "edf.h"
+
+// 实时线程的调度信息，时间均为 time 寄存器计数
+typedef struct {
+    int rt;                 // 是否属于实时调度类
+    int hart;               // 划分到的 hart
+    usize runtime;          // 每个周期的预算
+    usize period;           // 周期
+    usize deadline;         // 相对截止时刻
+    usize bandwidth;        // 占用的带宽（密度）
+    usize release;          // 当前作业的释放时刻
+    usize absDeadline;      // 当前作业的绝对截止时刻
+    usize budget;           // 当前作业剩余预算
+    usize start;            // 本次开始运行（或上次扣除预算）的时刻
+    int ready;              // 可运行（已加入调度且尚未被选中）
+    int queued;             // 在 EDF 就绪队列中
+    int throttled;          // 预算用完或作业已完成，等待下一周期
+    int done;               // 本周期的作业已完成
+    int missed;             // 本周期的作业已记为错过
+    int next;               // 就绪队列中的下一个线程
+    int memberNext;         // 划分到同一 hart 的下一个实时线程
+    usize jobs;
+    usize misses;
+    usize overruns;
+} EdfInfo;
+
+static struct {
+    Spinlock lock;              // 保护实时调度类的全部状态
+    EdfInfo threads[MAX_LIVE_THREADS];
+    int queue[MAX_CPU];         // 各 hart 按绝对截止时刻排序的就绪队列，-1 为空
+    int current[MAX_CPU];       // 各 hart 正在运行的实时线程，-1 表示没有
+    usize bandwidth[MAX_CPU];   // 各 hart 已分配的实时带宽
+    int members[MAX_CPU];       // 划分到各 hart 的实时线程链表，时钟中断时只遍历本 hart 的链表
+    int count;                  // 实时线程数，为 0 时直接使用普通调度算法
+    usize misses;               // 所有实时线程错过截止时刻的总次数
+} edf;
+
+static Scheduler NORMAL;        // 被包装的普通调度算法
+
+// 微秒与 time 寄存器计数的换算
+#define US_TO_TIME(us)  ((us) * (TIMEBASE_FREQ / 1000000))
+#define TIME_TO_US(t)   ((t) / (TIMEBASE_FREQ / 1000000))
+
+// 按绝对截止时刻插入 hart 的就绪队列（需持有锁）
+static void
+enqueue(int tid)
+{
+    EdfInfo *e = &edf.threads[tid];
+    int *pp = &edf.queue[e->hart];
+    while(*pp != -1 && edf.threads[*pp].absDeadline <= e->absDeadline) {
+        pp = &edf.threads[*pp].next;
+    }
+    e->next = *pp;
+    *pp = tid;
+    e->queued = 1;
+}
+
+// 从就绪队列中移除（需持有锁）
+static void
+dequeue(int tid)
+{
+    EdfInfo *e = &edf.threads[tid];
+    int *pp = &edf.queue[e->hart];
+    while(*pp != -1) {
+        if(*pp == tid) {
+            *pp = e->next;
+            break;
+        }
+        pp = &edf.threads[*pp].next;
+    }
+    e->queued = 0;
+}
+
+// 加入/移出所划分 hart 的实时线程链表（需持有锁）
+static void
+addMember(int tid)
+{
+    EdfInfo *e = &edf.threads[tid];
+    e->memberNext = edf.members[e->hart];
+    edf.members[e->hart] = tid;
+}
+
+static void
+removeMember(int tid)
+{
+    EdfInfo *e = &edf.threads[tid];
+    int *pp = &edf.members[e->hart];
+    while(*pp != -1) {
+        if(*pp == tid) {
+            *pp = e->memberNext;
+            break;
+        }
+        pp = &edf.threads[*pp].memberNext;
+    }
+}
+
+// 扣除 hart 当前实时线程的运行时间（需持有锁）
+static void
+chargeCurrent(int hart, usize now)
+{
+    int tid = edf.current[hart];
+    if(tid == -1) {
+        return;
+    }
+    EdfInfo *e = &edf.threads[tid];
+    usize used = now - e->start;
+    e->budget = used >= e->budget ? 0 : e->budget - used;
+    e->start = now;
+}
+
+// hart 上的实时线程停止运行（需持有锁）
+static void
+putCurrent(int hart)
+{
+    chargeCurrent(hart, r_time());
+    edf.current[hart] = -1;
+}
+
+static void
+edfInit()
+{
+    initLock(&edf.lock, "edf");
+    int i;
+    for(i = 0; i < MAX_CPU; i ++) {
+        edf.queue[i] = -1;
+        edf.current[i] = -1;
+        edf.bandwidth[i] = 0;
+        edf.members[i] = -1;
+    }
+    edf.count = 0;
+    NORMAL.init();
+}
+
+// 普通线程交给被包装的调度算法，被唤醒的线程优先使用其 wake
+static void
+normalPush(int tid, int wakeup)
+{
+    if(wakeup && NORMAL.wake != 0) {
+        NORMAL.wake(tid);
+    } else {
+        NORMAL.push(tid);
+    }
+}
+
+// 实时线程加入其所属 hart 的 EDF 就绪队列，被限流时先不入队，到下一周期再入队
+static void
+edfEnqueue(int tid, int wakeup)
+{
+    if(__atomic_load_n(&edf.count, __ATOMIC_ACQUIRE) == 0) {
+        normalPush(tid, wakeup);
+        return;
+    }
+    acquireLock(&edf.lock);
+    EdfInfo *e = &edf.threads[tid];
+    if(!e->rt) {
+        releaseLock(&edf.lock);
+        normalPush(tid, wakeup);
+        return;
+    }
+    if(edf.current[cpuid()] == tid) {
+        putCurrent(cpuid());
+    }
+    e->ready = 1;
+    int kick = 0;
+    if(!e->throttled && !e->queued) {
+        enqueue(tid);
+        kick = e->hart != cpuid();
+    }
+    int hart = e->hart;
+    releaseLock(&edf.lock);
+    getLoadStats(cpuid())->enqueued += 1;
+    if(kick) {
+        sendIPIMessage(hart, IPI_WAKEUP);   // 目标 hart 可能在 wfi 中空闲
+    }
+}
+
+static void
+edfPush(int tid)
+{
+    edfEnqueue(tid, 0);
+}
+
+static void
+edfWake(int tid)
+{
+    edfEnqueue(tid, 1);
+}
+
+// 优先选择本 hart 截止时刻最早的实时线程
+static int
+edfPop()
+{
+    if(__atomic_load_n(&edf.count, __ATOMIC_ACQUIRE) == 0) {
+        return NORMAL.pop();
+    }
+    int hart = cpuid();
+    acquireLock(&edf.lock);
+    putCurrent(hart);
+    int tid = edf.queue[hart];
+    if(tid != -1) {
+        dequeue(tid);
+        edf.threads[tid].ready = 0;
+        edf.threads[tid].start = r_time();
+        edf.current[hart] = tid;
+    }
+    releaseLock(&edf.lock);
+    if(tid != -1) {
+        getLoadStats(hart)->dispatched += 1;
+        return tid;
+    }
+    return NORMAL.pop();
+}
+
+// 时钟中断时检查当前线程是否需要切换出去
+// 普通线程在有实时线程就绪时被抢占；实时线程在预算用完、需要迁移或有截止时刻更早的实时线程就绪时被抢占
+static int
+edfTick()
+{
+    if(__atomic_load_n(&edf.count, __ATOMIC_ACQUIRE) == 0) {
+        return NORMAL.tick();
+    }
+    int hart = cpuid();
+    acquireLock(&edf.lock);
+    int tid = edf.current[hart];
+    if(tid == -1) {
+        int rtReady = edf.queue[hart] != -1;
+        releaseLock(&edf.lock);
+        int normal = NORMAL.tick();
+        return normal || rtReady;
+    }
+    chargeCurrent(hart, r_time());
+    EdfInfo *e = &edf.threads[tid];
+    int preempt = 0;
+    if(!e->rt || e->hart != hart) {
+        preempt = 1;    // 已离开实时调度类，或被划分到其他 hart
+    } else if(e->budget == 0) {
+        e->throttled = 1;
+        e->overruns += 1;
+        preempt = 1;
+    } else if(edf.queue[hart] != -1 && edf.threads[edf.queue[hart]].absDeadline < e->absDeadline) {
+        preempt = 1;
+    }
+    releaseLock(&edf.lock);
+    return preempt;
+}
+
+// 线程退出，释放其实时带宽
+static void
+edfExit(int tid)
+{
+    acquireLock(&edf.lock);
+    EdfInfo *e = &edf.threads[tid];
+    if(edf.current[cpuid()] == tid) {
+        edf.current[cpuid()] = -1;
+    }
+    if(e->rt) {
+        if(e->queued) dequeue(tid);
+        removeMember(tid);
+        edf.bandwidth[e->hart] -= e->bandwidth;
+        e->rt = 0;
+        __atomic_fetch_sub(&edf.count, 1, __ATOMIC_RELEASE);
+    }
+    releaseLock(&edf.lock);
+    NORMAL.exit(tid);
+}
+
+static int
+edfSetPriority(int tid, int nice)
+{
+    if(NORMAL.setPriority == 0) {
+        return -EINVAL;
+    }
+    return NORMAL.setPriority(tid, nice);
+}
+
+// 有实时线程在 hart 上运行（需要检查预算）或等待时需要周期 tick
+static int
+edfNeedTick(int hart)
+{
+    if(__atomic_load_n(&edf.count, __ATOMIC_ACQUIRE) != 0 &&
+        (__atomic_load_n(&edf.current[hart], __ATOMIC_RELAXED) != -1 ||
+         __atomic_load_n(&edf.queue[hart], __ATOMIC_RELAXED) != -1)) {
+        return 1;
+    }
+    return NORMAL.needTick(hart);
+}
+
+// 用实时调度类包装普通调度算法
+Scheduler
+edfWrap(Scheduler normal)
+{
+    NORMAL = normal;
+    Scheduler s = {edfInit, edfPush, edfPop, edfTick, edfExit, edfSetPriority, edfNeedTick, edfWake};
+    return s;
+}
+
+/*
+ * 每次时钟中断时调用，处理划分到本 hart 的实时线程的周期
+ * 截止时刻已过而作业未完成时记一次错过；新周期开始时补充预算，解除限流并重新入队
+ */
+void
+edfTimer()
+{
+    if(__atomic_load_n(&edf.count, __ATOMIC_ACQUIRE) == 0) {
+        return;
+    }
+    int hart = cpuid();
+    usize now = r_time();
+    acquireLock(&edf.lock);
+    int tid;
+    for(tid = edf.members[hart]; tid != -1; tid = edf.threads[tid].memberNext) {
+        EdfInfo *e = &edf.threads[tid];
+        if(!e->done && !e->missed && now >= e->absDeadline) {
+            e->missed = 1;
+            e->misses += 1;
+            edf.misses += 1;
+        }
+        if(now < e->release + e->period) continue;
+        // 新周期开始，跳过整个错过的周期
+        while(e->release + e->period <= now) {
+            e->release += e->period;
+        }
+        e->absDeadline = e->release + e->deadline;
+        e->budget = e->runtime;
+        e->throttled = 0;
+        e->done = 0;
+        e->missed = 0;
+        e->jobs += 1;
+        if(edf.current[hart] == tid) {
+            e->start = now;
+        } else if(e->ready && !e->queued) {
+            enqueue(tid);
+        }
+    }
+    releaseLock(&edf.lock);
+}
+
+/*
+ * 本 hart 上实时线程的下一个定时事件（周期释放或截止时刻），没有时返回 -1
+ * 时钟在空闲或只有一个可运行线程时不再周期触发，需要按这些时刻设置时钟中断
+ */
+usize
+edfNextEvent()
+{
+    usize next = (usize)-1;
+    if(__atomic_load_n(&edf.count, __ATOMIC_ACQUIRE) == 0) {
+        return next;
+    }
+    int hart = cpuid();
+    acquireLock(&edf.lock);
+    int tid;
+    for(tid = edf.members[hart]; tid != -1; tid = edf.threads[tid].memberNext) {
+        EdfInfo *e = &edf.threads[tid];
+        if(e->release + e->period < next) {
+            next = e->release + e->period;
+        }
+        if(!e->done && !e->missed && e->absDeadline < next) {
+            next = e->absDeadline;
+        }
+    }
+    releaseLock(&edf.lock);
+    return next;
+}
+
+// 当前实时线程完成本周期的作业，限流到下一周期；调用者随后让出 CPU
+void
+edfYield()
+{
+    usize flags = acquireLockIrqsave(&edf.lock);
+    int hart = cpuid();
+    int tid = edf.current[hart];
+    if(tid != -1 && tid == getCurrentTid() && edf.threads[tid].rt) {
+        edf.threads[tid].done = 1;
+        edf.threads[tid].throttled = 1;
+    }
+    releaseLockIrqrestore(&edf.lock, flags);
+}
+
+/*
+ * 设置当前线程的实时参数（微秒），runtime 为 0 时回到普通调度类
+ * 要求 0 < runtime <= deadline <= period <= EDF_MAX_PERIOD，没有 hart 能容纳其带宽时返回 -EBUSY
+ */
+long
+edfSetAttr(usize runtime, usize period, usize deadline)
+{
+    int tid = getCurrentTid();
+    if(runtime != 0 && (runtime > deadline || deadline > period || period > EDF_MAX_PERIOD)) {
+        return -EINVAL;     // 过大的参数会使 rt * EDF_BW_UNIT 溢出，回绕后的带宽能绕过准入控制
+    }
+    usize rt = US_TO_TIME(runtime), pd = US_TO_TIME(period), dl = US_TO_TIME(deadline);
+    usize bw = runtime == 0 ? 0 : rt * EDF_BW_UNIT / dl;
+    usize flags = acquireLockIrqsave(&edf.lock);
+    EdfInfo *e = &edf.threads[tid];
+    // 先释放原有带宽，再重新准入
+    if(e->rt) {
+        edf.bandwidth[e->hart] -= e->bandwidth;
+        if(e->queued) dequeue(tid);
+        removeMember(tid);
+    }
+    if(runtime == 0) {
+        if(e->rt) {
+            e->rt = 0;
+            __atomic_fetch_sub(&edf.count, 1, __ATOMIC_RELEASE);
+        }
+        edf.current[cpuid()] = -1;
+        releaseLockIrqrestore(&edf.lock, flags);
+        return 0;
+    }
+    int hart, best = -1;
+    for(hart = 0; hart < MAX_CPU; hart ++) {
+        if(!isHartOnline(hart) || edf.bandwidth[hart] + bw > EDF_MAX_BW) continue;
+        if(best == -1 || edf.bandwidth[hart] < edf.bandwidth[best]) {
+            best = hart;
+        }
+    }
+    if(best == -1) {
+        if(e->rt) {
+            edf.bandwidth[e->hart] += e->bandwidth;     // 保持原有参数
+            addMember(tid);
+        }
+        releaseLockIrqrestore(&edf.lock, flags);
+        return -EBUSY;
+    }
+    if(!e->rt) {
+        __atomic_fetch_add(&edf.count, 1, __ATOMIC_RELEASE);
+    }
+    usize now = r_time();
+    e->rt = 1;
+    e->hart = best;
+    e->runtime = rt;
+    e->period = pd;
+    e->deadline = dl;
+    e->bandwidth = bw;
+    e->release = now;
+    e->absDeadline = now + dl;
+    e->budget = rt;
+    e->start = now;
+    e->ready = 0;
+    e->throttled = 0;
+    e->done = 0;
+    e->missed = 0;
+    e->jobs = 1;
+    e->misses = 0;
+    e->overruns = 0;
+    edf.bandwidth[best] += bw;
+    addMember(tid);
+    edf.current[cpuid()] = tid;     // 从现在起按实时线程计算预算，不在 best 上时下一个 tick 迁移
+    releaseLockIrqrestore(&edf.lock, flags);
+    return 0;
+}
+
+// 读取当前线程的实时参数和统计到内核缓冲区 attr，由调用者拷贝到用户空间
+long
+edfGetAttr(SchedAttr *attr)
+{
+    usize flags = acquireLockIrqsave(&edf.lock);
+    EdfInfo *e = &edf.threads[getCurrentTid()];
+    if(!e->rt) {
+        releaseLockIrqrestore(&edf.lock, flags);
+        return -EINVAL;
+    }
+    attr->runtime = TIME_TO_US(e->runtime);
+    attr->period = TIME_TO_US(e->period);
+    attr->deadline = TIME_TO_US(e->deadline);
+    attr->jobs = e->jobs;
+    attr->misses = e->misses;
+    attr->overruns = e->overruns;
+    releaseLockIrqrestore(&edf.lock, flags);
+    return 0;
+}
+
+// 打印实时调度类统计
+void
+printEdfStats()
+{
+    int hart, tid;
+    printf("edf: %d rt threads, %d deadline misses\n", edf.count, (int)edf.misses);
+    for(hart = 0; hart < MAX_CPU; hart ++) {
+        if(edf.bandwidth[hart] != 0) {
+            printf("  hart %d: bandwidth %d%%\n", hart, (int)(edf.bandwidth[hart] * 100 / EDF_BW_UNIT));
+        }
+    }
+    for(tid = 0; tid < MAX_LIVE_THREADS; tid ++) {
+        EdfInfo *e = &edf.threads[tid];
+        if(!e->rt) continue;
+        printf("  tid %d on hart %d: jobs %d, misses %d, overruns %d\n",
+            tid, e->hart, (int)e->jobs, (int)e->misses, (int)e->overruns);
+    }
+}
@@ -0,0 +1,36 @@
+/************************* EDF 实时调度类 ******************************
+ * Author：Joker001014
+ * 2025.03.27
+ * 实时线程以 (runtime, period, deadline) 描述：每个周期最多运行 runtime，须在周期开始后 deadline 内完成
+ * 实时调度类包装普通调度算法，实时线程总是优先于普通线程运行
+***********************************************************************/
+
+#ifndef _EDF_H
+#define _EDF_H
+
+#include "types.h"
+#include "thread.h"
+
+#define EDF_BW_UNIT     (1 << 20)                   // 带宽的单位，1 表示占满一个 hart
+#define EDF_MAX_BW      (EDF_BW_UNIT / 100 * 95)    // 每个 hart 留给实时线程的最大带宽，其余留给普通线程
+#define EDF_MAX_PERIOD  1000000000UL                // 周期的上限（微秒，1000 秒），换算和带宽计算不会溢出
+
+// sched_getattr 返回给用户的实时参数和统计，时间单位为微秒
+typedef struct {
+    usize runtime;
+    usize period;
+    usize deadline;
+    usize jobs;         // 已开始的作业数
+    usize misses;       // 错过截止时刻的作业数
+    usize overruns;     // 用完预算被限流的次数
+} SchedAttr;
+
+Scheduler edfWrap(Scheduler normal);
+void edfTimer();
+usize edfNextEvent();
+void edfYield();
+long edfSetAttr(usize runtime, usize period, usize deadline);
+long edfGetAttr(SchedAttr *attr);
+void printEdfStats();
+
+#endif
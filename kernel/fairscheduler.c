@@ -0,0 +1,315 @@
+/*************************** 加权公平调度算法 ****************************
+ * Author：Joker001014
+ * 2025.03.26
+ * 实现 thread.h 中定义的 Scheduler 结构体中的调度器算法
+ * 每个线程记录虚拟运行时间 vruntime = 实际运行时间 * NICE_0_WEIGHT / 权重，总是运行 vruntime 最小的线程
+ * 权重由 nice 值决定，nice 每增加 1 权重约减少 25%，权重越大的线程 vruntime 增长越慢，得到的 CPU 时间越多
+ * 运行时间用 time 寄存器（r_time）计量，而不是 tick 数
+ * 每个 hart 的就绪线程按 vruntime 组织成最小堆，本 hart 没有就绪线程时从最忙的 hart 窃取
+***********************************************************************/
+
+#include "types.h"
+#include "def.h"
+#include "consts.h"
+#include "thread.h"
+#include "riscv.h"
+#include "spinlock.h"
+
+#define NICE_MIN            (-20)
+#define NICE_MAX            19
+#define NICE_0_WEIGHT       1024
+#define SCHED_LATENCY       (4 * TICK_INTERVAL)     // 所有就绪线程各运行一次的目标周期
+#define MIN_GRANULARITY     TICK_INTERVAL           // 一次运行的最短时间
+#define SLEEPER_CREDIT      (SCHED_LATENCY / 2)     // 被唤醒线程最多可以领先的 vruntime
+
+// nice 值 -20 ~ 19 对应的权重，相邻两级相差约 1.25 倍
+static const uint32 NICE_TO_WEIGHT[40] = {
+    88761, 71755, 56483, 46273, 36291,
+    29154, 23254, 18705, 14949, 11916,
+     9548,  7620,  6100,  4904,  3906,
+     3121,  2501,  1991,  1586,  1277,
+     1024,   820,   655,   526,   423,
+      335,   272,   215,   172,   137,
+      110,    87,    70,    56,    45,
+       36,    29,    23,    18,    15,
+};
+
+// 线程的调度信息
+typedef struct {
+    usize vruntime;     // 虚拟运行时间
+    usize start;        // 本次开始运行（或上次计入运行时间）的时刻
+    int nice;           // nice 值
+    uint32 weight;      // 由 nice 值得到的权重
+    int pos;            // 在所在 hart 最小堆中的下标，-1 表示不在堆中
+    uint32 queuedWeight;    // 入堆时计入 hart 权重之和的权重，出堆时减去同样的值
+    int started;        // 是否已经加入过调度，新线程从当前最小 vruntime 开始
+} FairInfo;
+
+// 调度器信息结构体
+struct
+{
+    FairInfo threads[MAX_LIVE_THREADS];
+    int heap[MAX_CPU][MAX_LIVE_THREADS];      // 各 hart 的就绪线程最小堆，按 vruntime 排序
+    int size[MAX_CPU];                  // 各 hart 堆中的线程数
+    usize totalWeight[MAX_CPU];         // 各 hart 就绪线程的权重之和
+    usize minVruntime[MAX_CPU];         // 各 hart 单调不减的最小 vruntime，用于放置新线程和被唤醒线程
+    Spinlock lock[MAX_CPU];             // 各 hart 就绪队列的锁
+    int current[MAX_CPU];               // 各 hart 当前正在运行的线程，-1 表示没有
+} fairScheduler;
+
+#define VRUNTIME(tid)   (fairScheduler.threads[tid].vruntime)
+
+/* 最小堆操作（需持有对应 hart 的队列锁） */
+static void
+heapSet(int hart, int i, int tid)
+{
+    fairScheduler.heap[hart][i] = tid;
+    fairScheduler.threads[tid].pos = i;
+}
+
+static void
+siftUp(int hart, int i)
+{
+    int tid = fairScheduler.heap[hart][i];
+    while(i > 0) {
+        int parent = (i - 1) / 2;
+        int ptid = fairScheduler.heap[hart][parent];
+        if(VRUNTIME(ptid) <= VRUNTIME(tid)) break;
+        heapSet(hart, i, ptid);
+        i = parent;
+    }
+    heapSet(hart, i, tid);
+}
+
+static void
+siftDown(int hart, int i)
+{
+    int n = fairScheduler.size[hart];
+    int tid = fairScheduler.heap[hart][i];
+    while(1) {
+        int child = 2 * i + 1;
+        if(child >= n) break;
+        if(child + 1 < n && VRUNTIME(fairScheduler.heap[hart][child + 1]) < VRUNTIME(fairScheduler.heap[hart][child])) {
+            child += 1;
+        }
+        int ctid = fairScheduler.heap[hart][child];
+        if(VRUNTIME(tid) <= VRUNTIME(ctid)) break;
+        heapSet(hart, i, ctid);
+        i = child;
+    }
+    heapSet(hart, i, tid);
+}
+
+static void
+heapPush(int hart, int tid)
+{
+    int i = fairScheduler.size[hart] ++;
+    heapSet(hart, i, tid);
+    siftUp(hart, i);
+    fairScheduler.threads[tid].queuedWeight = fairScheduler.threads[tid].weight;
+    fairScheduler.totalWeight[hart] += fairScheduler.threads[tid].queuedWeight;
+}
+
+// 删除堆中下标为 i 的线程并返回
+static int
+heapRemove(int hart, int i)
+{
+    int tid = fairScheduler.heap[hart][i];
+    int last = -- fairScheduler.size[hart];
+    if(i != last) {
+        heapSet(hart, i, fairScheduler.heap[hart][last]);
+        siftDown(hart, i);
+        siftUp(hart, fairScheduler.threads[fairScheduler.heap[hart][i]].pos);
+    }
+    fairScheduler.threads[tid].pos = -1;
+    fairScheduler.totalWeight[hart] -= fairScheduler.threads[tid].queuedWeight;
+    return tid;
+}
+
+// 将实际运行时间按权重折算后计入 vruntime
+static void
+account(int tid, usize now)
+{
+    FairInfo *fi = &fairScheduler.threads[tid];
+    usize delta = now - fi->start;
+    fi->vruntime += delta * NICE_0_WEIGHT / fi->weight;
+    fi->start = now;
+}
+
+// 当前线程停止运行，计入其最后一段运行时间
+static void
+putCurrent(int hart)
+{
+    int tid = fairScheduler.current[hart];
+    if(tid != -1) {
+        account(tid, r_time());
+        fairScheduler.current[hart] = -1;
+    }
+}
+
+// 初始化调度器
+void
+fairInit()
+{
+    int hart, tid;
+    for(hart = 0; hart < MAX_CPU; hart ++) {
+        fairScheduler.size[hart] = 0;
+        fairScheduler.totalWeight[hart] = 0;
+        fairScheduler.minVruntime[hart] = 0;
+        fairScheduler.current[hart] = -1;
+        initLock(&fairScheduler.lock[hart], "runqueue");
+    }
+    for(tid = 0; tid < MAX_LIVE_THREADS; tid ++) {
+        FairInfo fi = {0, 0, 0, NICE_0_WEIGHT, -1, 0, 0};
+        fairScheduler.threads[tid] = fi;
+    }
+}
+
+// 将一个线程加入当前 hart 的线程调度
+void
+fairPush(int tid)
+{
+    if(tid < 0 || tid >= MAX_LIVE_THREADS) {
+        panic("Cannot push to scheduler!\n");
+    }
+    int hart = cpuid();
+    FairInfo *fi = &fairScheduler.threads[tid];
+    acquireLock(&fairScheduler.lock[hart]);
+    if(fairScheduler.current[hart] == tid) {
+        putCurrent(hart);       // 时间片用完被切换出去
+    }
+    usize min = fairScheduler.minVruntime[hart];
+    if(!fi->started) {
+        // 新线程从当前最小 vruntime 开始，不能因为 vruntime 为 0 而长期独占 CPU
+        fi->vruntime = min;
+        fi->started = 1;
+    } else if(fi->vruntime + SLEEPER_CREDIT < min) {
+        // 休眠较久的线程最多领先 SLEEPER_CREDIT，被唤醒后能尽快运行，但不会补偿全部休眠时间
+        fi->vruntime = min - SLEEPER_CREDIT;
+    }
+    heapPush(hart, tid);
+    releaseLock(&fairScheduler.lock[hart]);
+    getLoadStats(hart)->enqueued += 1;
+}
+
+// 从就绪线程最多的 hart 窃取一个线程，取堆的最后一个元素（叶子，vruntime 较大）
+// vruntime 按两个 hart 最小 vruntime 的差值平移，保持在新 hart 上的相对位置
+static int
+stealThread(int self)
+{
+    int victim = -1, most = 0, hart;
+    for(hart = 0; hart < MAX_CPU; hart ++) {
+        if(hart == self || !isHartOnline(hart)) continue;
+        int len = __atomic_load_n(&fairScheduler.size[hart], __ATOMIC_RELAXED);
+        if(len > most) {
+            most = len;
+            victim = hart;
+        }
+    }
+    if(victim == -1) {
+        return -1;
+    }
+    int tid = -1;
+    acquireLock(&fairScheduler.lock[victim]);
+    if(fairScheduler.size[victim] > 0) {
+        tid = heapRemove(victim, fairScheduler.size[victim] - 1);
+        long offset = (long)fairScheduler.threads[tid].vruntime - (long)fairScheduler.minVruntime[victim];
+        if(offset < 0) offset = 0;
+        fairScheduler.threads[tid].vruntime = fairScheduler.minVruntime[self] + offset;
+    }
+    releaseLock(&fairScheduler.lock[victim]);
+    if(tid != -1) {
+        getLoadStats(self)->stolen += 1;
+        getLoadStats(victim)->donated += 1;
+    }
+    return tid;
+}
+
+// 选择 vruntime 最小的线程运行，如果没有可运行的线程则返回 -1
+int
+fairPop()
+{
+    int hart = cpuid();
+    int tid = -1;
+    acquireLock(&fairScheduler.lock[hart]);
+    putCurrent(hart);       // 上一个线程主动休眠或退出
+    if(fairScheduler.size[hart] > 0) {
+        tid = heapRemove(hart, 0);
+    }
+    releaseLock(&fairScheduler.lock[hart]);
+    if(tid == -1) {
+        tid = stealThread(hart);
+    }
+    if(tid == -1) {
+        return -1;
+    }
+    FairInfo *fi = &fairScheduler.threads[tid];
+    if(fi->vruntime > fairScheduler.minVruntime[hart]) {
+        fairScheduler.minVruntime[hart] = fi->vruntime;
+    }
+    fi->start = r_time();
+    fairScheduler.current[hart] = tid;
+    getLoadStats(hart)->dispatched += 1;
+    return tid;
+}
+
+// 提醒调度算法当前线程又运行了一个 tick
+// 当前线程运行满按权重分得的时间片，或者 vruntime 已超过堆顶线程一个最小粒度时需要切换
+int
+fairTick()
+{
+    int hart = cpuid();
+    int tid = fairScheduler.current[hart];
+    if(tid == -1) {
+        return 1;
+    }
+    FairInfo *fi = &fairScheduler.threads[tid];
+    usize now = r_time();
+    usize ran = now - fi->start;    // 本次计入前已运行的时间，用于判断时间片
+    account(tid, now);
+    acquireLock(&fairScheduler.lock[hart]);
+    int preempt = 0;
+    if(fairScheduler.size[hart] > 0) {
+        usize total = fairScheduler.totalWeight[hart] + fi->weight;
+        usize slice = SCHED_LATENCY * fi->weight / total;
+        if(slice < MIN_GRANULARITY) slice = MIN_GRANULARITY;
+        int top = fairScheduler.heap[hart][0];
+        if(ran >= slice || fi->vruntime > VRUNTIME(top) + MIN_GRANULARITY) {
+            preempt = 1;
+        }
+    }
+    releaseLock(&fairScheduler.lock[hart]);
+    return preempt;
+}
+
+// 告诉调度算法某个线程已经结束，重置其调度信息
+void
+fairExit(int tid)
+{
+    int hart = cpuid();
+    if(fairScheduler.current[hart] == tid) {
+        fairScheduler.current[hart] = -1;
+    }
+    FairInfo fi = {0, 0, 0, NICE_0_WEIGHT, -1, 0, 0};
+    fairScheduler.threads[tid] = fi;
+}
+
+// 设置线程的 nice 值，超出范围时取边界值
+// 之后的运行时间按新的权重折算，线程若已在堆中，hart 的权重之和在其下次入堆时更新
+int
+fairSetPriority(int tid, int nice)
+{
+    if(nice < NICE_MIN) nice = NICE_MIN;
+    if(nice > NICE_MAX) nice = NICE_MAX;
+    FairInfo *fi = &fairScheduler.threads[tid];
+    fi->nice = nice;
+    __atomic_store_n(&fi->weight, NICE_TO_WEIGHT[nice - NICE_MIN], __ATOMIC_RELAXED);
+    return 0;
+}
+
+// hart 的堆中是否还有线程等待，没有时当前线程不会被抢占，运行时间在下次出入堆时按 time 计入
+int
+fairNeedTick(int hart)
+{
+    return __atomic_load_n(&fairScheduler.size[hart], __ATOMIC_RELAXED) > 0;
+}
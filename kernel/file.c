@@ -0,0 +1,162 @@
+/************************** 文件描述符 *********************************
+ * Author：Joker001014
+ * 2025.03.30
+ * 文件描述符表属于进程，进程中的线程通过所属进程访问同一张表
+ * 新进程的 0、1、2 号描述符指向控制台，执行程序时可以将标准输入输出重定向到管道
+ * 打开的文件带引用计数，最后一个引用释放时才关闭（管道的一端关闭后对端读到结束或写入失败）
+***********************************************************************/
+
+#include "types.h"
+#include "def.h"
+#include "consts.h"
+#include "thread.h"
+#include "file.h"
+#include "pipe.h"
+
+// 控制台的标准输入和标准输出，所有进程共享，不会被关闭
+static File CONSOLE_IN  = {FILE_CONSOLE, 1, 0, 1, 0};
+static File CONSOLE_OUT = {FILE_CONSOLE, 0, 1, 1, 0};
+
+// 新进程的 0、1、2 号描述符指向控制台
+void
+initStdio(Process *process)
+{
+    int fd;
+    for(fd = 0; fd < MAX_FDS; fd ++) {
+        process->files[fd] = 0;
+    }
+    process->files[0] = &CONSOLE_IN;
+    process->files[1] = &CONSOLE_OUT;
+    process->files[2] = &CONSOLE_OUT;
+}
+
+// 进程销毁时关闭所有仍打开的描述符
+void
+closeFiles(Process *process)
+{
+    int fd;
+    for(fd = 0; fd < MAX_FDS; fd ++) {
+        if(process->files[fd] != 0) {
+            putFile(process->files[fd]);
+            process->files[fd] = 0;
+        }
+    }
+}
+
+// 创建一个打开的文件，初始引用数为 1
+File *
+newFile(int type, int readable, int writable, struct Pipe *pipe)
+{
+    File *f = kalloc(sizeof(File));
+    f->type = type;
+    f->readable = readable;
+    f->writable = writable;
+    f->refs = 1;
+    f->pipe = pipe;
+    return f;
+}
+
+// 增加文件的引用
+void
+getFile(File *file)
+{
+    if(file->type != FILE_CONSOLE) {
+        __atomic_fetch_add(&file->refs, 1, __ATOMIC_RELAXED);
+    }
+}
+
+// 释放文件的引用，最后一个引用释放时关闭
+void
+putFile(File *file)
+{
+    if(file->type == FILE_CONSOLE) {
+        return;
+    }
+    if(__atomic_sub_fetch(&file->refs, 1, __ATOMIC_ACQ_REL) != 0) {
+        return;
+    }
+    if(file->type == FILE_PIPE) {
+        closePipe(file->pipe, file->writable);
+    }
+    kfree(file);
+}
+
+// 将文件放入线程所属进程的描述符表中最小的空闲位置，描述符表持有调用者传入的引用
+// 返回描述符，表已满返回 -EMFILE
+int
+allocFd(Thread *thread, File *file)
+{
+    Process *p = thread->process;
+    if(p == 0) {
+        return -EINVAL;
+    }
+    usize flags = acquireLockIrqsave(&p->lock);
+    int fd;
+    for(fd = 0; fd < MAX_FDS; fd ++) {
+        if(p->files[fd] == 0) {
+            p->files[fd] = file;
+            break;
+        }
+    }
+    releaseLockIrqrestore(&p->lock, flags);
+    return fd == MAX_FDS ? -EMFILE : fd;
+}
+
+// 从描述符表中取下 fd，返回其文件（引用转交给调用者），fd 无效返回 0
+File *
+takeFd(Thread *thread, int fd)
+{
+    Process *p = thread->process;
+    if(p == 0 || fd < 0 || fd >= MAX_FDS) {
+        return 0;
+    }
+    usize flags = acquireLockIrqsave(&p->lock);
+    File *f = p->files[fd];
+    p->files[fd] = 0;
+    releaseLockIrqrestore(&p->lock, flags);
+    return f;
+}
+
+// 关闭描述符 fd，返回 0，fd 无效返回 -EBADF
+int
+deallocFd(Thread *thread, int fd)
+{
+    File *f = takeFd(thread, fd);
+    if(f == 0) {
+        return -EBADF;
+    }
+    putFile(f);
+    return 0;
+}
+
+// 获取描述符 fd 对应的文件并增加引用，使用完后需调用 putFile，fd 无效返回 0
+File *
+fileOfFd(Thread *thread, int fd)
+{
+    Process *p = thread->process;
+    if(p == 0 || fd < 0 || fd >= MAX_FDS) {
+        return 0;
+    }
+    usize flags = acquireLockIrqsave(&p->lock);
+    File *f = p->files[fd];
+    if(f != 0) {
+        getFile(f);
+    }
+    releaseLockIrqrestore(&p->lock, flags);
+    return f;
+}
+
+// 将新进程的标准输入、标准输出替换为 in、out（为 0 的保持控制台），接管传入的引用
+// 进程尚未开始运行，不需要加锁
+void
+redirectStdio(Process *process, File *in, File *out)
+{
+    if(in != 0) {
+        putFile(process->files[0]);
+        process->files[0] = in;
+    }
+    if(out != 0) {
+        putFile(process->files[1]);
+        process->files[1] = out;
+    }
+}
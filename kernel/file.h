@@ -0,0 +1,34 @@
+/************************** 文件描述符 *********************************
+ * Author：Joker001014
+ * 2025.03.30
+***********************************************************************/
+
+#ifndef _FILE_H
+#define _FILE_H
+
+#include "types.h"
+#include "thread.h"
+
+/* 打开文件的类型 */
+#define FILE_CONSOLE    1       // 控制台（标准输入输出）
+#define FILE_PIPE       2       // 管道的一端
+
+// 打开的文件，可以被多个文件描述符（包括不同进程的）引用
+typedef struct File {
+    int type;           // 文件类型
+    int readable;       // 是否可读
+    int writable;       // 是否可写
+    int refs;           // 引用数，为 0 时关闭
+    struct Pipe *pipe;  // FILE_PIPE 对应的管道
+} File;
+
+void  initStdio(Process *process);
+void  closeFiles(Process *process);
+File *newFile(int type, int readable, int writable, struct Pipe *pipe);
+void  getFile(File *file);
+void  putFile(File *file);
+File *fileOfFd(Thread *thread, int fd);
+File *takeFd(Thread *thread, int fd);
+void  redirectStdio(Process *process, File *in, File *out);
+
+#endif
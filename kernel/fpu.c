@@ -0,0 +1,169 @@
+/************************** 浮点上下文管理 *****************************
+ * Author：Joker001014
+ * 2025.03.30
+ * 惰性保存和恢复用户线程的浮点寄存器，只使用整数的线程不产生任何开销
+ *      内核中 sstatus.FS 始终为 Off（进入内核时清除，见 interrupt.S），内核代码误用浮点寄存器会立即触发异常
+ *      用户线程开始时 FS 为 Off，第一条浮点指令触发非法指令异常，此时才分配浮点上下文并打开 FS
+ *      线程切换出去时，只有用户态的 FS 为 Dirty（上次保存后改写过浮点寄存器）才保存
+ *      线程切换回来时，本 hart 的浮点寄存器中仍是它的状态则不必恢复
+ * 向量扩展的状态（sstatus.VS）同样保持 Off，用户程序暂不能使用向量指令
+***********************************************************************/
+
+#include "types.h"
+#include "def.h"
+#include "consts.h"
+#include "riscv.h"
+#include "context.h"
+#include "thread.h"
+#include "fpu.h"
+
+// 各 hart 浮点寄存器中当前是哪个线程的状态，只由该 hart 自己访问（关中断）
+// 上下文被释放后地址可能被复用，因此还需核对 FpContext.hart
+static FpContext *FP_OWNER[MAX_CPU];
+
+// 浮点上下文统计
+static struct {
+    usize firstUses;    // 线程第一次使用浮点指令的次数
+    usize saves;        // 切换时保存浮点寄存器的次数
+    usize restores;     // 切换时恢复浮点寄存器的次数
+    usize skips;        // 切换回来时寄存器中仍是其状态而跳过恢复的次数
+} FP_STATS[MAX_CPU];
+
+#define FSD(n)  "fsd f" #n ", " #n "*8(%0)\n"
+#define FLD(n)  "fld f" #n ", " #n "*8(%0)\n"
+#define FP_8(op, a, b, c, d, e, f, g, h)    op(a) op(b) op(c) op(d) op(e) op(f) op(g) op(h)
+
+// 将浮点寄存器保存到 fp，调用者需已打开 FS
+static void
+fpStore(FpContext *fp)
+{
+    asm volatile(
+        FP_8(FSD, 0, 1, 2, 3, 4, 5, 6, 7)
+        FP_8(FSD, 8, 9, 10, 11, 12, 13, 14, 15)
+        FP_8(FSD, 16, 17, 18, 19, 20, 21, 22, 23)
+        FP_8(FSD, 24, 25, 26, 27, 28, 29, 30, 31)
+        : : "r"(fp->f) : "memory");
+    asm volatile("frcsr %0" : "=r"(fp->fcsr));
+}
+
+// 从 fp 加载浮点寄存器，调用者需已打开 FS
+static void
+fpLoad(FpContext *fp)
+{
+    asm volatile(
+        FP_8(FLD, 0, 1, 2, 3, 4, 5, 6, 7)
+        FP_8(FLD, 8, 9, 10, 11, 12, 13, 14, 15)
+        FP_8(FLD, 16, 17, 18, 19, 20, 21, 22, 23)
+        FP_8(FLD, 24, 25, 26, 27, 28, 29, 30, 31)
+        : : "r"(fp->f) : "memory");
+    asm volatile("fscsr %0" : : "r"(fp->fcsr));
+    fp->hart = cpuid();
+    FP_OWNER[cpuid()] = fp;
+}
+
+// 内核临时打开浮点单元以读写浮点寄存器，完成后关闭
+static inline void
+fpEnable()
+{
+    w_sstatus(r_sstatus() | SSTATUS_FS_CLEAN);
+}
+
+static inline void
+fpDisable()
+{
+    w_sstatus(r_sstatus() & ~SSTATUS_FS);
+}
+
+// 线程从 U-Mode 进入内核时保存的上下文，位于内核栈顶保留区之下
+static inline InterruptContext *
+userContext(Thread *thread)
+{
+    return (InterruptContext *)(thread->kstack + KERNEL_STACK_SIZE - KSTACK_TRAP_RESERVE) - 1;
+}
+
+/*
+ * U-Mode 在 FS 为 Off 时执行浮点指令触发的非法指令异常
+ * 为当前线程分配全零的浮点上下文并加载，返回后重新执行该指令
+ * 返回：1-已处理，0-线程已有浮点上下文，是真正的非法指令
+ */
+int
+fpFirstUse(InterruptContext *context)
+{
+    Thread *thread = getCurrentThread();
+    if(thread->fp != 0) {
+        return 0;
+    }
+    FpContext *fp = kalloc(sizeof(FpContext));
+    int i;
+    for(i = 0; i < 32; i ++) {
+        fp->f[i] = 0;
+    }
+    fp->fcsr = 0;
+    fpEnable();
+    fpLoad(fp);
+    fpDisable();
+    thread->fp = fp;
+    context->sstatus = (context->sstatus & ~SSTATUS_FS) | SSTATUS_FS_CLEAN;
+    FP_STATS[cpuid()].firstUses += 1;
+    return 1;
+}
+
+// 线程切换出去前调用（关中断），用户态改写过浮点寄存器时才保存
+void
+fpSwitchOut(Thread *thread)
+{
+    if(thread->fp == 0) {
+        return;
+    }
+    InterruptContext *uc = userContext(thread);
+    if((uc->sstatus & SSTATUS_FS) != SSTATUS_FS_DIRTY) {
+        return;
+    }
+    fpEnable();
+    fpStore(thread->fp);
+    fpDisable();
+    uc->sstatus = (uc->sstatus & ~SSTATUS_FS) | SSTATUS_FS_CLEAN;
+    FP_STATS[cpuid()].saves += 1;
+}
+
+// 线程切换回来后调用（关中断），本 hart 的浮点寄存器中不是它的状态时才恢复
+void
+fpSwitchIn(Thread *thread)
+{
+    FpContext *fp = thread->fp;
+    if(fp == 0) {
+        return;
+    }
+    int hart = cpuid();
+    if(FP_OWNER[hart] == fp && fp->hart == hart) {
+        FP_STATS[hart].skips += 1;
+        return;
+    }
+    fpEnable();
+    fpLoad(fp);
+    fpDisable();
+    FP_STATS[hart].restores += 1;
+}
+
+// 回收线程时释放其浮点上下文
+void
+fpFree(Thread *thread)
+{
+    if(thread->fp != 0) {
+        kfree(thread->fp);
+        thread->fp = 0;
+    }
+}
+
+// 打印各 hart 的浮点上下文统计
+void
+printFpStats()
+{
+    int hart;
+    for(hart = 0; hart < MAX_CPU; hart ++) {
+        if(!isHartOnline(hart)) continue;
+        printf("fpu hart %d: first uses %d, saves %d, restores %d, skipped restores %d\n", hart,
+                (int)FP_STATS[hart].firstUses, (int)FP_STATS[hart].saves,
+                (int)FP_STATS[hart].restores, (int)FP_STATS[hart].skips);
+    }
+}
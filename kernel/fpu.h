@@ -0,0 +1,26 @@
+/************************** 浮点上下文管理 *****************************
+ * Author：Joker001014
+ * 2025.03.30
+***********************************************************************/
+
+#ifndef _FPU_H
+#define _FPU_H
+
+#include "types.h"
+#include "context.h"
+#include "thread.h"
+
+// 线程的浮点寄存器，第一次使用浮点指令时才分配
+typedef struct FpContext {
+    usize f[32];        // f0-f31
+    usize fcsr;         // 浮点控制状态寄存器
+    int hart;           // 最近一次被加载到哪个 hart 的浮点寄存器中，-1 表示没有
+} FpContext;
+
+int  fpFirstUse(InterruptContext *context);
+void fpSwitchOut(Thread *thread);
+void fpSwitchIn(Thread *thread);
+void fpFree(Thread *thread);
+void printFpStats();
+
+#endif
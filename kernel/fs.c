@@ -7,10 +7,34 @@
 #include "types.h"
 #include "def.h"
 #include "fs.h"
+#include "spinlock.h"
+#include "rcu.h"
 
 Inode *ROOT_INODE;      // 声明一个指针 ROOT_INODE，指向根目录的 Inode 结构
 char *FREEMAP;          // 声明一个指针 FREEMAP，指向文件系统的 freemap
 
+/*
+ * 路径查找缓存：以绝对路径为键缓存查找到的 Inode
+ * 读者在 RCU 读临界区内无锁遍历，写者持锁插入新项，淘汰的旧项在宽限期结束后释放
+ */
+#define PATH_CACHE_BUCKETS  32      // 哈希桶数
+#define PATH_CACHE_DEPTH    4       // 每个桶最多缓存的项数
+
+typedef struct pathentry {
+    struct pathentry *next;     // 桶内下一项
+    RcuHead rcu;                // 被淘汰后推迟释放
+    uint32 hash;                // 路径的哈希值
+    Inode *inode;               // 查找结果
+    char path[];                // 绝对路径
+} PathEntry;
+
+static struct {
+    Spinlock lock;                          // 写者之间互斥
+    PathEntry *buckets[PATH_CACHE_BUCKETS];
+    usize hits;                             // 命中次数
+    usize misses;                           // 未命中次数
+} PATH_CACHE;
+
 /* 
  * 目前文件系统被装载到 .data 段中
  * _fs_img_start 为文件系统部分内存的起始符号
@@ -35,6 +59,7 @@ initFs()
     SuperBlock* spBlock = (SuperBlock *)_fs_img_start;  
     // 根目录的 Inode 紧接在 freemap 块之后
     ROOT_INODE = (Inode *)getBlockAddr(spBlock->freemapBlocks + 1);
+    initLock(&PATH_CACHE.lock, "pathcache");
 }
 
 /*
@@ -112,6 +137,112 @@ lookup(Inode *node, char *filename)
     }
 }
 
+// 计算路径的哈希值
+static uint32
+hashPath(char *path)
+{
+    uint32 h = 5381;
+    while(*path) {
+        h = h * 33 + (uint8)*path;
+        path ++;
+    }
+    return h;
+}
+
+// 在缓存中查找路径，需在 RCU 读临界区内调用
+static PathEntry *
+findPathEntry(char *path, uint32 hash)
+{
+    PathEntry *e = RCU_DEREFERENCE(PATH_CACHE.buckets[hash % PATH_CACHE_BUCKETS]);
+    while(e != 0) {
+        if(e->hash == hash && !strcmp(e->path, path)) {
+            return e;
+        }
+        e = RCU_DEREFERENCE(e->next);
+    }
+    return 0;
+}
+
+// RCU 回调：释放被淘汰的缓存项
+static void
+freePathEntry(RcuHead *head)
+{
+    kfree(CONTAINER_OF(head, PathEntry, rcu));
+}
+
+// 将查找结果插入缓存头部，桶满时淘汰最旧的一项
+static void
+insertPathEntry(char *path, uint32 hash, Inode *inode)
+{
+    int len = strlen(path);
+    PathEntry *ne = kalloc(sizeof(PathEntry) + len + 1);
+    ne->hash = hash;
+    ne->inode = inode;
+    int i;
+    for(i = 0; i <= len; i ++) {
+        ne->path[i] = path[i];
+    }
+    usize flags = acquireLockIrqsave(&PATH_CACHE.lock);
+    if(findPathEntry(path, hash) != 0) {
+        // 其他 hart 已经插入
+        releaseLockIrqrestore(&PATH_CACHE.lock, flags);
+        kfree(ne);
+        return;
+    }
+    PathEntry **bucket = &PATH_CACHE.buckets[hash % PATH_CACHE_BUCKETS];
+    ne->next = *bucket;
+    // 新项初始化完成后再发布，读者看到它时内容一定完整
+    RCU_ASSIGN_POINTER(*bucket, ne);
+    // 找到第 PATH_CACHE_DEPTH 项，把它之后的项摘下
+    PathEntry *e = ne, *victim = 0;
+    for(i = 1; e != 0 && i < PATH_CACHE_DEPTH; i ++) {
+        e = e->next;
+    }
+    if(e != 0 && e->next != 0) {
+        victim = e->next;
+        RCU_ASSIGN_POINTER(e->next, (PathEntry *)0);
+    }
+    releaseLockIrqrestore(&PATH_CACHE.lock, flags);
+    // 摘下的项可能正被其他 hart 的读者访问，宽限期后释放
+    if(victim != 0) {
+        callRcu(&victim->rcu, freePathEntry);
+    }
+}
+
+/*
+ * 根据绝对路径查找文件，查找结果会被缓存
+ * 文件系统镜像只读，缓存的结果不会失效
+ */
+Inode *
+lookupPath(char *path)
+{
+    if(path[0] != '/') {
+        return lookup(0, path);
+    }
+    uint32 hash = hashPath(path);
+    rcuReadLock();
+    PathEntry *e = findPathEntry(path, hash);
+    Inode *inode = e ? e->inode : 0;
+    rcuReadUnlock();
+    if(e != 0) {
+        __atomic_fetch_add(&PATH_CACHE.hits, 1, __ATOMIC_RELAXED);
+        return inode;
+    }
+    __atomic_fetch_add(&PATH_CACHE.misses, 1, __ATOMIC_RELAXED);
+    inode = lookup(0, path);
+    if(inode != 0) {
+        insertPathEntry(path, hash, inode);
+    }
+    return inode;
+}
+
+// 打印路径查找缓存统计
+void
+printPathCacheStats()
+{
+    printf("path cache: hits %d, misses %d\n", PATH_CACHE.hits, PATH_CACHE.misses);
+}
+
 // 将数据从块中复制到 buf 中
 void
 copyByteToBuf(char *src, char *dst, int length)
@@ -33,6 +33,8 @@ typedef struct
 } Inode;
 
 Inode *lookup(Inode *node, char *filename);
+Inode *lookupPath(char *path);
+void printPathCacheStats();
 void readall(Inode *node, char *buf);
 // void ls(Inode *node);
 // char *getInodePath(Inode *inode, char path[256]);
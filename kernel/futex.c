@@ -0,0 +1,167 @@
+/****************************** Futex **********************************
+ * Author：Joker001014
+ * 2025.03.23
+ * 等待者按 futex 字的物理地址散列到等待队列中，共享同一物理页的不同地址空间可以互相唤醒
+ * 检查 futex 字的值和加入等待队列在同一把桶锁下完成，唤醒者修改值之后再唤醒，不会丢失唤醒
+ * 超时由每个等待者自己的内核定时器处理，时钟中断不再扫描等待队列
+***********************************************************************/
+
+#include "types.h"
+#include "def.h"
+#include "consts.h"
+#include "riscv.h"
+#include "thread.h"
+#include "mapping.h"
+#include "spinlock.h"
+#include "futex.h"
+#include "ktimer.h"
+
+// 等待状态
+#define FUTEX_WAITING   0   // 仍在等待队列中
+#define FUTEX_WOKEN     1   // 被 futexWake 唤醒
+#define FUTEX_TIMEOUT   2   // 等待超时
+
+// 一个等待者，存放在等待线程的内核栈上，被唤醒前已从队列中摘下
+typedef struct futexwaiter {
+    usize pa;                   // futex 字的物理地址
+    int tid;                    // 等待线程
+    int state;                  // 等待状态
+    Ktimer timer;               // 超时定时器
+    struct futexwaiter *next;
+} FutexWaiter;
+
+// 等待队列哈希桶
+typedef struct {
+    Spinlock lock;
+    FutexWaiter *head;
+} FutexBucket;
+
+static FutexBucket BUCKETS[FUTEX_BUCKETS];
+
+static FutexBucket *
+bucketOf(usize pa)
+{
+    return &BUCKETS[(pa >> 2) % FUTEX_BUCKETS];
+}
+
+// 将当前线程地址空间中的用户地址转换为物理地址，失败返回 0
+static usize
+userToPa(usize uaddr)
+{
+    Process *p = getCurrentThread()->process;
+    if(p == 0 || (uaddr & 3) != 0) {
+        return 0;
+    }
+    Mapping m = satpMapping(p->satp);
+    return translateVa(m, uaddr);
+}
+
+// 将等待者从桶中摘下（需持有桶锁）
+static void
+unlinkWaiter(FutexBucket *b, FutexWaiter *w)
+{
+    FutexWaiter **pp = &b->head;
+    while(*pp != 0) {
+        if(*pp == w) {
+            *pp = w->next;
+            return;
+        }
+        pp = &(*pp)->next;
+    }
+}
+
+// 超时定时器回调，等待者仍在队列中时将其摘下并唤醒
+static void
+futexTimeout(Ktimer *t)
+{
+    FutexWaiter *w = (FutexWaiter *)t->data;
+    FutexBucket *b = bucketOf(w->pa);
+    acquireLock(&b->lock);
+    if(w->state == FUTEX_WAITING) {
+        unlinkWaiter(b, w);
+        w->state = FUTEX_TIMEOUT;
+        wakeupCPU(w->tid);
+    }
+    releaseLock(&b->lock);
+}
+
+/*
+ * 若 uaddr 处的值仍等于 expected，则休眠直到被 futexWake 唤醒或超时
+ * timeout 为等待的纳秒数，0 表示一直等待
+ * 返回 0 表示被唤醒，-EAGAIN 表示值已改变，-ETIMEDOUT 表示超时
+ */
+long
+futexWait(usize uaddr, uint32 expected, usize timeout)
+{
+    usize pa = userToPa(uaddr);
+    if(pa == 0) {
+        return -EFAULT;
+    }
+    FutexBucket *b = bucketOf(pa);
+    FutexWaiter w;
+    w.pa = pa;
+    w.tid = getCurrentTid();
+    w.state = FUTEX_WAITING;
+    initKtimer(&w.timer, futexTimeout, (usize)&w);
+
+    usize flags = acquireLockIrqsave(&b->lock);
+    if(*(volatile uint32 *)accessVaViaPa(pa) != expected) {
+        releaseLockIrqrestore(&b->lock, flags);
+        return -EAGAIN;
+    }
+    w.next = b->head;
+    b->head = &w;
+    prepareSleepCPU();      // 先标记为休眠，释放锁之后到达的唤醒会撤销这次休眠
+    if(timeout != 0) {
+        // 定时器在本 hart 上到期，持有桶锁（关中断）期间回调不会执行
+        usize duration = nsToTime(timeout);
+        addKtimer(&w.timer, r_time() + duration, timerSlack(duration));
+    }
+    releaseLock(&b->lock);
+    yieldCPU();
+    cancelKtimer(&w.timer);     // 等待可能正在执行的回调完成后再检查状态，此时不能持有桶锁
+    acquireLock(&b->lock);
+    if(w.state == FUTEX_WAITING) {
+        unlinkWaiter(b, &w);    // 被其他原因唤醒
+    }
+    releaseLockIrqrestore(&b->lock, flags);
+
+    switch(w.state) {
+    case FUTEX_WOKEN:
+        return 0;
+    case FUTEX_TIMEOUT:
+        return -ETIMEDOUT;
+    default:
+        return -EINTR;
+    }
+}
+
+// 唤醒最多 n 个等待在 uaddr 上的线程，返回唤醒的线程数
+long
+futexWake(usize uaddr, int n)
+{
+    usize pa = userToPa(uaddr);
+    if(pa == 0) {
+        return -EFAULT;
+    }
+    if(n <= 0) {
+        return 0;
+    }
+    FutexBucket *b = bucketOf(pa);
+    int woken = 0;
+    usize flags = acquireLockIrqsave(&b->lock);
+    FutexWaiter **pp = &b->head;
+    while(*pp != 0 && woken < n) {
+        FutexWaiter *w = *pp;
+        if(w->pa != pa) {
+            pp = &w->next;
+            continue;
+        }
+        *pp = w->next;
+        w->state = FUTEX_WOKEN;
+        wakeupCPU(w->tid);
+        woken ++;
+    }
+    releaseLockIrqrestore(&b->lock, flags);
+    return woken;
+}
@@ -0,0 +1,17 @@
+/****************************** Futex **********************************
+ * Author：Joker001014
+ * 2025.03.23
+ * 用户态同步原语的内核部分：无竞争时用户程序只使用原子指令，有竞争时才通过系统调用休眠和唤醒
+***********************************************************************/
+
+#ifndef _FUTEX_H
+#define _FUTEX_H
+
+#include "types.h"
+
+#define FUTEX_BUCKETS   64      // 等待队列哈希桶数
+
+long futexWait(usize uaddr, uint32 expected, usize timeout);
+long futexWake(usize uaddr, int n);
+
+#endif
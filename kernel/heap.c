@@ -7,6 +7,7 @@
 #include "types.h"
 #include "def.h"
 #include "consts.h"
+#include "spinlock.h"
 
 #define LEFT_LEAF(index) ((index) * 2 + 1)      // 计算一个节点的左子节点索引
 #define RIGHT_LEAF(index) ((index) * 2 + 2)     // 计算一个节点的右子节点索引
@@ -18,6 +19,9 @@
 /* 用于分配的堆空间，存放在 .bss 段，8M bytes */
 static uint8 HEAP[KERNEL_HEAP_SIZE];
 
+/* 保护伙伴系统二叉树，中断处理程序中也可能分配内存，需关中断获取 */
+static Spinlock HEAP_LOCK;
+
 void buddyInit(int size);
 int buddyAlloc(int size);
 void buddyFree(int offset);
@@ -26,6 +30,7 @@ void buddyFree(int offset);
 void
 initHeap()
 {
+    initLock(&HEAP_LOCK, "heap");
     buddyInit(HEAP_BLOCK_NUM);
 }
 
@@ -48,10 +53,22 @@ fixSize(int size)
 /* 
  * 在内核堆上分配内存
  * 输入：size，单位为 Byte
- * 输出：分配空间的起始地址
+ * 输出：分配空间的起始地址，堆空间不足时 panic
 */
 void *
 kalloc(int size)
+{
+    void *ptr = tryKalloc(size);
+    if(ptr == 0 && size > 0) panic("Malloc failed!\n");
+    return ptr;
+}
+
+/*
+ * 在内核堆上分配内存，堆空间不足时返回 0
+ * 用于用户可以触发的大块分配（如线程的内核栈），失败时由调用者返回错误
+*/
+void *
+tryKalloc(int size)
 {
     if(size <= 0) return 0;
 
@@ -62,8 +79,10 @@ kalloc(int size)
     else
         n = size / MIN_BLOCK_SIZE;
     // 分配块，得到偏移地址（单位为MIN_BLOCK_SIZE）
+    usize flags = acquireLockIrqsave(&HEAP_LOCK);
     int block = buddyAlloc(n);
-    if(block == -1) panic("Malloc failed!\n");
+    releaseLockIrqrestore(&HEAP_LOCK, flags);
+    if(block == -1) return 0;
 
     /* 清零被分配的内存空间 */
     int totalBytes = fixSize(n) * MIN_BLOCK_SIZE;   // 计算所分配的大小，单位bytes
@@ -89,7 +108,9 @@ kfree(void *ptr)
     if((usize)ptr > (usize)HEAP + KERNEL_HEAP_SIZE - MIN_BLOCK_SIZE) return;
     /* 相对于堆空间起始地址的偏移 */
     usize offset = (usize)((usize)ptr - (usize)HEAP);
+    usize flags = acquireLockIrqsave(&HEAP_LOCK);
     buddyFree(offset / MIN_BLOCK_SIZE);
+    releaseLockIrqrestore(&HEAP_LOCK, flags);
 }
 
 /* 
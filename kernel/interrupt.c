@@ -10,45 +10,62 @@
 #include "interrupt.h"
 #include "consts.h"
 #include "stdin.h"
+#include "uart.h"
+#include "fpu.h"
 
 // 引入中断处理程序汇编，保存和恢复上下文
 asm(".include \"kernel/interrupt.S\"");
 
-// 打开 OpenSBI 的 VIRT_PLIC 外部中断响应
+// PLIC 寄存器，QEMU virt 上 hart n 的 S 态上下文编号为 2n+1（2n 为 M 态）
+// OpenSBI 不一定从 hart 0 启动，外部中断交给启动 hart 的 S 态上下文
+#define PLIC_BASE               (0x0C000000 + KERNEL_MAP_OFFSET)
+#define PLIC_PRIORITY(irq)      (PLIC_BASE + (irq) * 4)
+#define PLIC_SCONTEXT(hart)     (2 * (hart) + 1)
+#define PLIC_SENABLE(hart)      (PLIC_BASE + 0x2000 + PLIC_SCONTEXT(hart) * 0x80)
+#define PLIC_STHRESHOLD(hart)   (PLIC_BASE + 0x200000 + PLIC_SCONTEXT(hart) * 0x1000)
+#define PLIC_SCLAIM(hart)       (PLIC_STHRESHOLD(hart) + 4)     // claim/complete 寄存器
+
+// 打开 OpenSBI 的 VIRT_PLIC 外部中断响应，串口中断只送到当前（启动）hart
 void
 initExternalInterrupt()
 {
-    *(uint32 *)(0x0C002080 + KERNEL_MAP_OFFSET) = 1 << 0xa;
-    *(uint32 *)(0x0C000028 + KERNEL_MAP_OFFSET) = 0x7U;
-    *(uint32 *)(0x0C201000 + KERNEL_MAP_OFFSET) = 0x0U;
+    int hart = cpuid();
+    *(uint32 *)PLIC_SENABLE(hart) = 1 << UART0_IRQ;
+    *(uint32 *)PLIC_PRIORITY(UART0_IRQ) = 0x7U;
+    *(uint32 *)PLIC_STHRESHOLD(hart) = 0x0U;
 }
-// 打开 OpenSBI 的 VIRT_UART0 串口设备响应
-void
-initSerialInterrupt()
-{
-    *(uint8 *)(0x10000004 + KERNEL_MAP_OFFSET) = 0x0bU;
-    *(uint8 *)(0x10000001 + KERNEL_MAP_OFFSET) = 0x01U;
-}
-
 // 中断初始化
 // __attribute__((aligned(4))) void
 void
 initInterrupt()
 {
-    extern void __interrupt();  // 全局中断处理，保存 Context 并跳转到 handleInterrupt() 处
+    extern void __vectors();    // 中断向量表，系统调用、时钟中断和外部中断有各自的入口
     // 写 stvec 寄存器。设置中断处理程序入口 和 模式
-    w_stvec((usize)__interrupt | MODE_DIRECT);  
+    w_stvec((usize)__vectors | MODE_VECTOR);
 
-    // 开启外部中断
-    w_sie(r_sie() | SIE_SEIE);
+    // 内核不使用浮点和向量单元，用户线程第一次使用浮点指令时才打开（见 fpu.c）
+    w_sstatus(r_sstatus() & ~(SSTATUS_FS | SSTATUS_VS));
+
+    // 开启外部中断和软件中断（核间中断）
+    w_sie(r_sie() | SIE_SEIE | SIE_SSIE);
 
     /* 打开 OpenSBI 的外部中断响应和串口设备响应 */
     initExternalInterrupt();
-    initSerialInterrupt();
+    initUart();     // 初始化串口驱动，打开串口接收中断
 
     printf("==== Init Interrupt ====\n");
 }
 
+// 其他 hart 的中断初始化，外部中断只由启动 hart 处理，这里只需要设置入口和软件中断
+void
+initHartInterrupt()
+{
+    extern void __vectors();
+    w_stvec((usize)__vectors | MODE_VECTOR);
+    w_sstatus(r_sstatus() & ~(SSTATUS_FS | SSTATUS_VS));
+    w_sie(r_sie() | SIE_SSIE);
+}
+
 // 断点中断处理：输出断点信息并跳转到下一条指令
 void
 breakpoint(InterruptContext *context) 
@@ -62,10 +79,20 @@ breakpoint(InterruptContext *context)
 void
 supervisorTimer()
 {
-    extern void tick(); tick();         // 设置下一次时钟中断时间
+    extern void runKtimers(); runKtimers(); // 执行到期的内核定时器（休眠、futex 和条件变量的超时）
+    extern void edfTimer(); edfTimer();     // 实时线程的周期释放与截止时刻检查
+    extern void flushLog(); flushLog(); // 批量输出积累的内核日志
+    extern void tick(); tick();         // 处理完到期事件后，设置下一次时钟中断时间
     extern void tickCPU(); tickCPU();   // 检查当前线程的时间片是否用完
 }
 
+// 软件中断处理：其他 hart 通过 IPI 发来消息（跨核唤醒、停机等）
+void
+software()
+{
+    extern void handleIPI(); handleIPI();   // 处理其他 hart 发来的 IPI 消息
+}
+
 // 未知中断处理：直接打印信息并关机
 void
 fault(InterruptContext *context, usize scause, usize stval)
@@ -78,7 +105,7 @@ fault(InterruptContext *context, usize scause, usize stval)
     panic("");
 }
 
-// 系统调用中断处理
+// 系统调用中断处理，由 __exception 的快速路径直接调用，context 中只保存了调用者保存的寄存器
 void
 handleSyscall(InterruptContext *context)
 {
@@ -95,40 +122,42 @@ handleSyscall(InterruptContext *context)
     context->x[10] = ret;   // 将 a0 寄存器设置为系统调用处理的返回值
 }
 
-// 外部中断处理
+// 外部中断处理：从 PLIC 领取中断号，处理后通知 PLIC 完成
+// 只有启动 hart 打开了 SEIE，这里总是在启动 hart 上执行
 void external()
 {
-    // printf("externel interrupt happened!\n Input char is ");
-    // // 目前只处理串口中断
-    // usize ret = consoleGetchar();   // 从控制台读取一个字符
-    // consolePutchar(ret);            // 向终端输出一个字符
-
-    // 将输入的字符放到输ss入缓冲区
-    usize ret = consoleGetchar();   // 从控制台获取一个字符
-    // 若获取不到字符 ret = -1
-    if(ret != -1) {
-        char ch = (char)ret;
-        // 将字符放到缓冲区
-        if(ch == '\r') {
-            pushChar('\n');
-        } else {
-            pushChar(ch);
-        }
+    volatile uint32 *claim = (volatile uint32 *)PLIC_SCLAIM(cpuid());
+    uint32 irq = *claim;
+    if(irq == UART0_IRQ) {
+        uartInterrupt();    // 取出串口收到的所有字符，并继续发送
+    }
+    if(irq != 0) {
+        *claim = irq;
     }
 }
 
 // 中断处理函数，接受interrupt.S传递过来的三个参数 sp, scause, stval
+// 向量模式下系统调用、时钟中断和外部中断由 interrupt.S 中各自的入口直接处理，不经过这里
 // sp保存上下文向下移动34个usize，所以sp也是一个指向InterruptContext的指针！
 void 
 handleInterrupt(InterruptContext *context, usize scause, usize stval)
 {
     switch(scause) {
+        case ILLEGAL_INSTRUCTION:   // 非法指令，可能是用户线程第一次使用浮点指令
+            if(!(context->sstatus & SSTATUS_SPP) && (context->sstatus & SSTATUS_FS) == 0 && fpFirstUse(context)) {
+                break;
+            }
+            fault(context, scause, stval);
+            break;
         case BREAKPOINT:            // 断点中断
             breakpoint(context);
             break;
         case USER_ENV_CALL:         // U-Mode 系统调用
             handleSyscall(context);
             break;
+        case SUPERVISOR_SOFT:       // 软件中断（IPI）
+            software();
+            break;
         case SUPERVISOR_TIMER:      // 时钟中断
             supervisorTimer();
             break;
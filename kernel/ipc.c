@@ -0,0 +1,298 @@
+/************************** 同步消息传递 *********************************
+ * Author：Joker001014
+ * 2025.03.30
+ * 客户端 ipcCall 发送消息并等待回复，服务端 ipcReplyWait 回复上一个请求并等待下一个请求
+ * 消息在系统调用的 a1 ~ a4 中传递，内核只在两个线程的中断上下文之间拷贝，不访问用户内存
+ * 对方已经在等待时，当前线程不经过就绪队列直接把 CPU 交给对方（handoffCPU），
+ * 一次往返只有两次线程切换，不需要调度器参与
+ * 调用过 ipcReplyWait/ipcReply 的线程是端口的服务端，最后一个服务端线程退出时，
+ *      排队和等待回复的客户端返回 -EPIPE，之后的请求等待新的服务端
+***********************************************************************/
+
+#include "types.h"
+#include "def.h"
+#include "consts.h"
+#include "thread.h"
+#include "spinlock.h"
+#include "ipc.h"
+
+// 等待者状态
+#define IPC_SENDING     0   // 客户端在发送队列中等待服务端接收
+#define IPC_AWAIT_REPLY 1   // 客户端的消息已被接收，等待回复
+#define IPC_REPLIED     2   // 客户端已收到回复
+#define IPC_RECV_WAIT   3   // 服务端在接收队列中等待请求
+#define IPC_RECEIVED    4   // 服务端已收到请求
+#define IPC_FAILED      5   // 端口的服务端已全部退出，客户端不会再收到回复
+
+// 一个等待者，存放在等待线程的内核栈上，状态变化都在端口锁下完成
+typedef struct ipcwaiter {
+    int tid;                    // 线程表下标
+    int id;                     // 对外的线程号，服务端用它指定回复对象
+    int from;                   // 服务端收到的请求来自哪个线程
+    int state;                  // 等待状态
+    usize msg[IPC_WORDS];       // 请求或回复
+    struct ipcwaiter *next;
+} IpcWaiter;
+
+// 端口
+typedef struct {
+    Spinlock lock;              // 锁顺序：端口 -> 线程池
+    IpcWaiter *senders;         // 等待服务端接收的客户端，先进先出
+    IpcWaiter *sendersTail;
+    IpcWaiter *receivers;       // 等待请求的服务端线程
+    IpcWaiter *replies;         // 请求已被接收、等待回复的客户端
+    int servers;                // 尚未退出的服务端线程数
+} IpcPort;
+
+static IpcPort PORTS[IPC_PORTS];
+
+// 各线程作为服务端的端口位图，按线程表下标存放，只由线程自己修改
+static usize SERVING[MAX_LIVE_THREADS];
+
+// 初始化所有端口
+void
+initIpc()
+{
+    int i;
+    for(i = 0; i < IPC_PORTS; i ++) {
+        initLock(&PORTS[i].lock, "ipc");
+        PORTS[i].senders = 0;
+        PORTS[i].sendersTail = 0;
+        PORTS[i].receivers = 0;
+        PORTS[i].replies = 0;
+        PORTS[i].servers = 0;
+    }
+}
+
+// 把当前线程登记为端口 port 的服务端（需持有端口锁）
+static void
+addServer(IpcPort *p, int port)
+{
+    int tid = getCurrentTid();
+    if(!(SERVING[tid] & (1UL << port))) {
+        SERVING[tid] |= 1UL << port;
+        p->servers += 1;
+    }
+}
+
+// 让 list 中的客户端全部返回 -EPIPE（需持有端口锁，锁顺序允许在此唤醒）
+static void
+failWaiters(IpcWaiter *list)
+{
+    while(list != 0) {
+        IpcWaiter *next = list->next;   // 唤醒后 list 所在的栈可能已经失效
+        int tid = list->tid;
+        list->state = IPC_FAILED;
+        wakeupCPU(tid);
+        list = next;
+    }
+}
+
+/*
+ * 线程退出时调用，注销它服务的端口
+ * 端口的最后一个服务端退出后，不会再有线程接收或回复其中的请求，让这些客户端返回
+ */
+void
+ipcThreadExit(int tid)
+{
+    int port;
+    for(port = 0; port < IPC_PORTS; port ++) {
+        if(!(SERVING[tid] & (1UL << port))) continue;
+        IpcPort *p = &PORTS[port];
+        usize flags = acquireLockIrqsave(&p->lock);
+        p->servers -= 1;
+        if(p->servers == 0) {
+            failWaiters(p->senders);
+            failWaiters(p->replies);
+            p->senders = 0;
+            p->sendersTail = 0;
+            p->replies = 0;
+        }
+        releaseLockIrqrestore(&p->lock, flags);
+    }
+    SERVING[tid] = 0;
+}
+
+static inline void
+copyMsg(usize *dst, usize *src)
+{
+    int i;
+    for(i = 0; i < IPC_WORDS; i ++) {
+        dst[i] = src[i];
+    }
+}
+
+static void
+initWaiter(IpcWaiter *w, int state)
+{
+    w->tid = getCurrentTid();
+    w->id = getCurrentThreadId();
+    w->from = -1;
+    w->state = state;
+    w->next = 0;
+}
+
+/*
+ * 在端口锁下等待状态变为 state 或 IPC_FAILED，返回时仍持有端口锁
+ * 调用前已 prepareSleepCPU() 并释放端口锁，target 不为 -1 时直接切换到该线程
+ */
+static void
+waitState(IpcPort *p, IpcWaiter *w, int state, int target)
+{
+    if(target != -1) {
+        handoffCPU(target);
+    } else {
+        yieldCPU();
+    }
+    acquireLock(&p->lock);
+    while(w->state != state && w->state != IPC_FAILED) {
+        prepareSleepCPU();
+        releaseLock(&p->lock);
+        yieldCPU();
+        acquireLock(&p->lock);
+    }
+}
+
+/*
+ * 把 a1 ~ a4 作为回复交给等待回复的线程 replyTo（对外线程号），需持有端口锁
+ * 返回它的线程表下标，没有这样的线程返回 -1
+ */
+static int
+deliverReply(IpcPort *p, long replyTo, InterruptContext *context)
+{
+    IpcWaiter **pp = &p->replies;
+    while(*pp != 0 && (*pp)->id != replyTo) {
+        pp = &(*pp)->next;
+    }
+    if(*pp == 0) {
+        return -1;
+    }
+    IpcWaiter *c = *pp;
+    *pp = c->next;
+    copyMsg(c->msg, &context->x[11]);
+    c->state = IPC_REPLIED;
+    return c->tid;
+}
+
+/*
+ * 向端口发送 a1 ~ a4 中的请求并等待回复，回复写回 a1 ~ a4
+ * 有服务端线程在等待时直接切换到该线程，等待期间服务端全部退出时返回 -EPIPE
+ */
+long
+ipcCall(int port, InterruptContext *context)
+{
+    if(port < 0 || port >= IPC_PORTS) {
+        return -EINVAL;
+    }
+    IpcPort *p = &PORTS[port];
+    IpcWaiter self;
+    initWaiter(&self, IPC_SENDING);
+    int target = -1;
+
+    usize flags = acquireLockIrqsave(&p->lock);
+    IpcWaiter *r = p->receivers;
+    if(r != 0) {
+        // 服务端已在等待：请求直接交给它，自己转入等待回复
+        p->receivers = r->next;
+        copyMsg(r->msg, &context->x[11]);
+        r->from = self.id;
+        r->state = IPC_RECEIVED;
+        target = r->tid;    // 释放锁后 r 可能已经失效
+        self.state = IPC_AWAIT_REPLY;
+        self.next = p->replies;
+        p->replies = &self;
+    } else {
+        copyMsg(self.msg, &context->x[11]);
+        if(p->sendersTail != 0) {
+            p->sendersTail->next = &self;
+        } else {
+            p->senders = &self;
+        }
+        p->sendersTail = &self;
+    }
+    prepareSleepCPU();      // 先标记为休眠，释放锁之后到达的回复会撤销这次休眠
+    releaseLock(&p->lock);
+    waitState(p, &self, IPC_REPLIED, target);
+    releaseLockIrqrestore(&p->lock, flags);
+
+    if(self.state == IPC_FAILED) {
+        return -EPIPE;
+    }
+    copyMsg(&context->x[11], self.msg);
+    return 0;
+}
+
+/*
+ * 服务端：replyTo 不为 -1 时先把 a1 ~ a4 作为回复交给线程 replyTo，再等待下一个请求
+ * 请求写入 a1 ~ a4，返回发送者的线程号
+ * 没有排队的请求时，直接切换到刚收到回复的客户端
+ */
+long
+ipcReplyWait(int port, long replyTo, InterruptContext *context)
+{
+    if(port < 0 || port >= IPC_PORTS) {
+        return -EINVAL;
+    }
+    IpcPort *p = &PORTS[port];
+    int replied = -1;
+
+    usize flags = acquireLockIrqsave(&p->lock);
+    addServer(p, port);
+    if(replyTo != -1) {
+        replied = deliverReply(p, replyTo, context);
+        if(replied == -1) {
+            releaseLockIrqrestore(&p->lock, flags);
+            return -EINVAL;
+        }
+    }
+
+    IpcWaiter *s = p->senders;
+    if(s != 0) {
+        // 已有请求在排队，不需要休眠，刚收到回复的客户端按普通唤醒处理
+        p->senders = s->next;
+        if(p->senders == 0) {
+            p->sendersTail = 0;
+        }
+        s->state = IPC_AWAIT_REPLY;
+        s->next = p->replies;
+        p->replies = s;
+        copyMsg(&context->x[11], s->msg);
+        long from = s->id;
+        releaseLockIrqrestore(&p->lock, flags);
+        if(replied != -1) {
+            wakeupCPU(replied);
+        }
+        return from;
+    }
+
+    IpcWaiter self;
+    initWaiter(&self, IPC_RECV_WAIT);
+    self.next = p->receivers;
+    p->receivers = &self;
+    prepareSleepCPU();
+    releaseLock(&p->lock);
+    waitState(p, &self, IPC_RECEIVED, replied);
+    releaseLockIrqrestore(&p->lock, flags);
+
+    copyMsg(&context->x[11], self.msg);
+    return self.from;
+}
+
+// 只把 a1 ~ a4 作为回复交给线程 replyTo，不等待下一个请求，服务端退出前使用
+long
+ipcReply(int port, long replyTo, InterruptContext *context)
+{
+    if(port < 0 || port >= IPC_PORTS) {
+        return -EINVAL;
+    }
+    IpcPort *p = &PORTS[port];
+    usize flags = acquireLockIrqsave(&p->lock);
+    addServer(p, port);
+    int replied = deliverReply(p, replyTo, context);
+    releaseLockIrqrestore(&p->lock, flags);
+    if(replied == -1) {
+        return -EINVAL;
+    }
+    wakeupCPU(replied);
+    return 0;
+}
@@ -0,0 +1,24 @@
+/************************** 同步消息传递 *********************************
+ * Author：Joker001014
+ * 2025.03.30
+ * call/reply_wait 风格的同步 IPC，消息只有几个字，直接通过寄存器传递
+***********************************************************************/
+
+#ifndef _IPC_H
+#define _IPC_H
+
+#include "types.h"
+#include "context.h"
+
+#define IPC_PORTS   16      // 端口数，端口号即下标，所有进程共享
+#define IPC_WORDS   4       // 消息的字数，由 a1 ~ a4 携带
+
+_Static_assert(IPC_PORTS <= 64, "ipc ports must fit in a usize bitmap");
+
+void initIpc();
+long ipcCall(int port, InterruptContext *context);
+long ipcReplyWait(int port, long replyTo, InterruptContext *context);
+long ipcReply(int port, long replyTo, InterruptContext *context);
+void ipcThreadExit(int tid);
+
+#endif
@@ -0,0 +1,69 @@
+/***************************** 核间中断 *********************************
+ * Author：Joker001014
+ * 2025.03.21
+ * 发送方先在目标 hart 的待处理位图中置位，再通过 SBI 触发软件中断
+ * 目标 hart 在软件中断中一次性取走位图，同一消息在处理前重复发送只会被处理一次
+***********************************************************************/
+
+#include "types.h"
+#include "def.h"
+#include "consts.h"
+#include "riscv.h"
+#include "thread.h"
+#include "ipi.h"
+
+// 各 hart 待处理的 IPI 消息位图，下标为 hartid
+static usize PENDING[MAX_CPU];
+
+// 向 hart 发送一条消息，若该消息已在等待处理则不再重复触发软件中断
+void
+sendIPIMessage(int hart, int msg)
+{
+    usize bit = 1UL << msg;
+    usize old = __atomic_fetch_or(&PENDING[hart], bit, __ATOMIC_RELEASE);
+    if(old & bit) {
+        return;
+    }
+    getLoadStats(cpuid())->ipiSent += 1;
+    sendIPI(hart);
+}
+
+// 本 hart 停止运行，关闭中断后不再返回
+static void
+haltHart()
+{
+    disable_and_store();
+    while(1) {
+        asm volatile("wfi");
+    }
+}
+
+// 软件中断处理：取走本 hart 的全部待处理消息并依次处理
+void
+handleIPI()
+{
+    w_sip(r_sip() & ~SIP_SSIP);     // 先清除等待位，处理期间到达的新消息会再次触发软件中断
+    usize pending = __atomic_exchange_n(&PENDING[cpuid()], 0, __ATOMIC_ACQUIRE);
+    if(pending == 0) {
+        return;
+    }
+    getLoadStats(cpuid())->ipiReceived += 1;
+    if(pending & (1UL << IPI_HALT)) {
+        haltHart();
+    }
+    if(pending & (1UL << IPI_WAKEUP)) {
+        ipiCPU();       // 接收其他 hart 投递的线程
+    }
+}
+
+// 让其他在线 hart 停止运行，panic 时调用，防止其他 hart 继续修改内核状态
+void
+haltOtherHarts()
+{
+    int hart;
+    for(hart = 0; hart < MAX_CPU; hart ++) {
+        if(hart != cpuid() && isHartOnline(hart)) {
+            sendIPIMessage(hart, IPI_HALT);
+        }
+    }
+}
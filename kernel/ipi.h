@@ -0,0 +1,20 @@
+/***************************** 核间中断 *********************************
+ * Author：Joker001014
+ * 2025.03.21
+ * 在 SBI 软件中断之上携带消息类型，一次软件中断可以合并处理多条消息
+***********************************************************************/
+
+#ifndef _IPI_H
+#define _IPI_H
+
+#include "types.h"
+
+// IPI 消息类型，每种消息占待处理位图中的一位
+#define IPI_WAKEUP  0   // 目标 hart 的 inbox 中有被唤醒的线程
+#define IPI_HALT    1   // 目标 hart 停止运行（panic 时使用）
+
+void sendIPIMessage(int hart, int msg);
+void handleIPI();
+void haltOtherHarts();
+
+#endif
@@ -0,0 +1,344 @@
+/************************** 内核定时器 ********************************
+ * Author：Joker001014
+ * 2025.03.28
+ * 每个 hart 一个分层时间轮，定时器在加入它的 hart 上到期
+ *      第 L 层的一个槽覆盖 64^L 个 jiffy，定时器按距到期的时间放入对应层，加入和取消都是 O(1)
+ *      时钟走到第 L 层一个槽的起点时，把该槽的定时器重新放入更低的层（级联），最终在第 0 层准确到期
+ *      定时器可以带有松弛量，到期时间向后对齐到松弛量以内的 2 的幂，使相近的定时器在同一个 jiffy 一起到期
+ * 时钟中断不再周期触发，timer.c 按 nextKtimerEvent() 设置下一次中断；长时间空闲后处理时跳过空的层，不逐个 jiffy 追赶
+***********************************************************************/
+
+#include "types.h"
+#include "def.h"
+#include "consts.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "thread.h"
+#include "ktimer.h"
+
+// 一个 hart 的时间轮
+typedef struct {
+    Spinlock lock;
+    usize clk;                              // 下一个待处理的 jiffy
+    Ktimer *slots[WHEEL_LEVELS][WHEEL_SIZE];
+    usize bitmap[WHEEL_LEVELS];             // 各层非空槽的位图
+    int count;                              // 时间轮中的定时器数
+    Ktimer *running;                        // 正在执行回调的定时器，取消时需等待其完成
+    usize fired;                            // 已到期的定时器数（统计）
+    usize cascaded;                         // 级联移动的定时器数（统计）
+} Wheel;
+
+static Wheel WHEELS[MAX_CPU];
+static usize BOOT_TIME;                     // 启动时的 time 计数
+
+// 当前 jiffy
+static inline usize
+nowJiffy()
+{
+    return r_time() / WHEEL_GRAN;
+}
+
+// 最低的置位位下标（x 不为 0），不依赖 libgcc
+static int
+lowestBit(usize x)
+{
+    int n = 0;
+    if((x & 0xffffffffUL) == 0) { n += 32; x >>= 32; }
+    if((x & 0xffff) == 0) { n += 16; x >>= 16; }
+    if((x & 0xff) == 0) { n += 8; x >>= 8; }
+    if((x & 0xf) == 0) { n += 4; x >>= 4; }
+    if((x & 0x3) == 0) { n += 2; x >>= 2; }
+    if((x & 0x1) == 0) { n += 1; }
+    return n;
+}
+
+// 从第 from 个槽开始（含）循环向后，到第一个非空槽的距离
+static int
+slotDistance(usize bitmap, int from)
+{
+    usize rot = from == 0 ? bitmap : (bitmap >> from) | (bitmap << (WHEEL_SIZE - from));
+    return lowestBit(rot);
+}
+
+void
+initKtimers()
+{
+    BOOT_TIME = r_time();
+    int hart;
+    for(hart = 0; hart < MAX_CPU; hart ++) {
+        initLock(&WHEELS[hart].lock, "timerwheel");
+        WHEELS[hart].clk = 0;
+    }
+}
+
+void
+initKtimer(Ktimer *t, void (*func)(Ktimer *), usize data)
+{
+    t->next = 0;
+    t->pprev = 0;
+    t->hart = -1;
+    t->func = func;
+    t->data = data;
+}
+
+// 按距到期的时间放入对应的层（需持有时间轮锁）
+static void
+enqueue(Wheel *w, Ktimer *t)
+{
+    usize e = t->expires < w->clk ? w->clk : t->expires;   // 已过期的在下一次处理时到期
+    usize delta = e - w->clk;
+    int level;
+    for(level = 0; level < WHEEL_LEVELS - 1; level ++) {
+        if(delta < (1UL << (WHEEL_BITS * (level + 1)))) break;
+    }
+    if(delta >= (1UL << (WHEEL_BITS * WHEEL_LEVELS))) {
+        // 超出时间轮范围，先放在最远的槽，级联时重新计算
+        e = w->clk + (1UL << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+    }
+    int slot = (e >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    Ktimer **head = &w->slots[level][slot];
+    t->next = *head;
+    if(*head != 0) {
+        (*head)->pprev = &t->next;
+    }
+    *head = t;
+    t->pprev = head;
+    t->level = level;
+    t->slot = slot;
+    w->bitmap[level] |= 1UL << slot;
+}
+
+// 从时间轮中摘下（需持有时间轮锁）
+static void
+dequeue(Wheel *w, Ktimer *t)
+{
+    *t->pprev = t->next;
+    if(t->next != 0) {
+        t->next->pprev = t->pprev;
+    }
+    if(w->slots[t->level][t->slot] == 0) {
+        w->bitmap[t->level] &= ~(1UL << t->slot);
+    }
+    t->next = 0;
+    t->pprev = 0;
+}
+
+// 松弛量为超时时长的 1/16，最多一个 tick 间隔
+usize
+timerSlack(usize timeout)
+{
+    usize slack = timeout >> 4;
+    return slack > TICK_INTERVAL ? TICK_INTERVAL : slack;
+}
+
+/*
+ * 在当前 hart 上设置定时器，在 time 计数达到 expires 之后执行回调，不会提前
+ * slack 为允许推迟的 time 计数，到期时间向后对齐到不超过松弛量的 2 的幂个 jiffy
+ * 定时器已在等待时先取消再重新设置
+ */
+void
+addKtimer(Ktimer *t, usize expires, usize slack)
+{
+    if(t->pprev != 0) {
+        cancelKtimer(t);
+    }
+    usize e = (expires + WHEEL_GRAN - 1) / WHEEL_GRAN;      // 向上取整，不会提前到期
+    usize s = slack / WHEEL_GRAN;
+    if(s >= 2) {
+        usize align = 1;
+        while(align * 2 <= s) {
+            align <<= 1;
+        }
+        e = (e + align - 1) & ~(align - 1);
+    }
+    t->expires = e;
+    usize flags = disable_and_store();
+    int hart = cpuid();
+    Wheel *w = &WHEELS[hart];
+    acquireLock(&w->lock);
+    if(w->count == 0) {
+        w->clk = nowJiffy();    // 空的时间轮不再处理，直接追上当前时间
+    }
+    t->hart = hart;
+    enqueue(w, t);
+    w->count += 1;
+    releaseLock(&w->lock);
+    extern void updateTimer(); updateTimer();   // 新定时器可能早于已设置的时钟中断
+    restore_sstatus(flags);
+}
+
+/*
+ * 取消定时器，返回 1 表示取消时定时器还在等待，0 表示已经到期（或从未设置）
+ * 回调正在其他 hart 上执行时等待它完成，返回后回调不会再访问定时器；不能在定时器自己的回调中调用
+ */
+int
+cancelKtimer(Ktimer *t)
+{
+    if(t->hart < 0) {
+        return 0;
+    }
+    Wheel *w = &WHEELS[t->hart];
+    usize flags = acquireLockIrqsave(&w->lock);
+    int pending = t->pprev != 0;
+    if(pending) {
+        dequeue(w, t);
+        w->count -= 1;
+    }
+    releaseLockIrqrestore(&w->lock, flags);
+    while(__atomic_load_n(&w->running, __ATOMIC_ACQUIRE) == t) {
+        asm volatile("nop");
+    }
+    return pending;
+}
+
+// clk 到达第 L 层槽的起点时，把该槽的定时器重新放入更低的层（需持有时间轮锁）
+static void
+cascade(Wheel *w)
+{
+    int level;
+    for(level = WHEEL_LEVELS - 1; level >= 1; level --) {
+        if((w->clk & ((1UL << (WHEEL_BITS * level)) - 1)) != 0) continue;
+        int slot = (w->clk >> (WHEEL_BITS * level)) & WHEEL_MASK;
+        Ktimer *t = w->slots[level][slot];
+        w->slots[level][slot] = 0;
+        w->bitmap[level] &= ~(1UL << slot);
+        while(t != 0) {
+            Ktimer *next = t->next;
+            enqueue(w, t);
+            w->cascaded += 1;
+            t = next;
+        }
+    }
+}
+
+// 时钟中断时调用，执行本 hart 时间轮中已到期的定时器
+void
+runKtimers()
+{
+    Wheel *w = &WHEELS[cpuid()];
+    usize now = nowJiffy();
+    acquireLock(&w->lock);
+    while(w->clk <= now) {
+        if(w->count == 0) {
+            w->clk = now + 1;
+            break;
+        }
+        cascade(w);
+        int slot = w->clk & WHEEL_MASK;
+        w->clk += 1;
+        while(w->slots[0][slot] != 0) {
+            Ktimer *t = w->slots[0][slot];
+            dequeue(w, t);
+            w->count -= 1;
+            w->fired += 1;
+            w->running = t;
+            releaseLock(&w->lock);
+            t->func(t);
+            acquireLock(&w->lock);
+            __atomic_store_n(&w->running, 0, __ATOMIC_RELEASE);
+        }
+        // 低层全空时直接跳到下一个需要级联的槽起点
+        int empty = 0;
+        while(empty < WHEEL_LEVELS && w->bitmap[empty] == 0) {
+            empty ++;
+        }
+        if(empty > 0 && empty < WHEEL_LEVELS) {
+            usize step = 1UL << (WHEEL_BITS * empty);
+            usize next = (w->clk + step - 1) & ~(step - 1);
+            w->clk = next < now + 1 ? next : now + 1;
+        }
+    }
+    releaseLock(&w->lock);
+}
+
+/*
+ * 本 hart 下一次需要处理时间轮的时刻（time 计数），没有定时器时返回 -1
+ * 第 0 层为最早的到期时刻，更高的层为下一次级联的时刻，到时处理后再重新计算
+ */
+usize
+nextKtimerEvent()
+{
+    Wheel *w = &WHEELS[cpuid()];
+    if(__atomic_load_n(&w->count, __ATOMIC_RELAXED) == 0) {
+        return -1;
+    }
+    acquireLock(&w->lock);
+    usize next = -1;
+    if(w->bitmap[0] != 0) {
+        next = w->clk + slotDistance(w->bitmap[0], w->clk & WHEEL_MASK);
+    }
+    int level;
+    for(level = 1; level < WHEEL_LEVELS; level ++) {
+        if(w->bitmap[level] == 0) continue;
+        usize block = w->clk >> (WHEEL_BITS * level);
+        int from = (block + 1) & WHEEL_MASK;
+        usize at = (block + 1 + slotDistance(w->bitmap[level], from)) << (WHEEL_BITS * level);
+        if(at < next) {
+            next = at;
+        }
+    }
+    releaseLock(&w->lock);
+    return next == (usize)-1 ? next : next * WHEEL_GRAN;
+}
+
+// 单调时钟的起点
+usize
+bootTime()
+{
+    return BOOT_TIME;
+}
+
+// 单调时钟：启动以来的纳秒数，与用户态通过共享数据页计算的值一致
+usize
+monotonicNs()
+{
+    return timeToNs(r_time() - BOOT_TIME);
+}
+
+usize
+nsToTime(usize ns)
+{
+    return ns / (1000000000 / TIMEBASE_FREQ);
+}
+
+usize
+timeToNs(usize time)
+{
+    return time * (1000000000 / TIMEBASE_FREQ);
+}
+
+// 定时器回调：唤醒设置定时器的线程
+static void
+wakeupTimer(Ktimer *t)
+{
+    wakeupCPU((int)t->data);
+}
+
+// 当前线程休眠至少 ns 纳秒，期间不占用 CPU
+void
+sleepNs(usize ns)
+{
+    usize deadline = r_time() + nsToTime(ns);
+    Ktimer t;
+    initKtimer(&t, wakeupTimer, getCurrentTid());
+    // 被其他原因提前唤醒时继续休眠
+    while(r_time() < deadline) {
+        prepareSleepCPU();      // 先标记休眠，定时器在 yieldCPU 之前到期也不会丢失唤醒
+        addKtimer(&t, deadline, timerSlack(deadline - r_time()));
+        yieldCPU();
+        cancelKtimer(&t);
+    }
+}
+
+// 打印各 hart 时间轮的统计
+void
+printKtimerStats()
+{
+    int hart;
+    for(hart = 0; hart < MAX_CPU; hart ++) {
+        Wheel *w = &WHEELS[hart];
+        if(w->fired == 0 && w->count == 0) continue;
+        printf("hart %d: timers pending %d, fired %d, cascaded %d\n",
+                hart, w->count, (int)w->fired, (int)w->cascaded);
+    }
+}
@@ -0,0 +1,46 @@
+/************************** 内核定时器 ********************************
+ * Author：Joker001014
+ * 2025.03.28
+ * 分层时间轮管理的一次性定时器，以及由 time 寄存器换算的单调时钟
+***********************************************************************/
+
+#ifndef _KTIMER_H
+#define _KTIMER_H
+
+#include "types.h"
+#include "consts.h"
+
+#define WHEEL_BITS      6                       // 每层时间轮的槽数为 2^WHEEL_BITS
+#define WHEEL_SIZE      (1 << WHEEL_BITS)
+#define WHEEL_MASK      (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS    4                       // 层数，最底层一个槽为一个 jiffy
+#define WHEEL_GRAN      (TIMEBASE_FREQ / 1000)  // 一个 jiffy 的 time 计数（1ms）
+
+// 定时器，由使用者提供存储空间（通常嵌入在等待者结构中或位于内核栈上）
+typedef struct ktimer {
+    struct ktimer *next;
+    struct ktimer **pprev;      // 指向前一个节点的 next（或槽位头），为 0 表示不在时间轮中
+    usize expires;              // 到期的 jiffy
+    int hart;                   // 所在时间轮的 hart，-1 表示从未加入
+    int level;                  // 所在的层和槽位
+    int slot;
+    void (*func)(struct ktimer *);  // 到期回调，在时钟中断中执行（关中断）
+    usize data;                 // 回调使用的参数
+} Ktimer;
+
+void  initKtimers();
+void  initKtimer(Ktimer *t, void (*func)(Ktimer *), usize data);
+void  addKtimer(Ktimer *t, usize expires, usize slack);
+int   cancelKtimer(Ktimer *t);
+void  runKtimers();
+usize nextKtimerEvent();
+usize timerSlack(usize timeout);
+
+usize bootTime();
+usize monotonicNs();
+usize nsToTime(usize ns);
+usize timeToNs(usize time);
+void  sleepNs(usize ns);
+void  printKtimerStats();
+
+#endif
@@ -0,0 +1,323 @@
+/************************** 内核日志缓冲区 *****************************
+ * Author：Joker001014
+ * 2025.03.30
+ * printf 不再直接输出到控制台，而是格式化后写入本 hart 的日志环形缓冲区，之后由 flushLog() 批量输出
+ *      每个 hart 只写自己的缓冲区（关中断），写入不需要加锁，热路径上的 printf 不再等待控制台
+ *      记录带有全局递增的序号，输出和读取时按序号合并各 hart 的记录
+ *      空闲循环和时钟中断时尝试输出，只输出串口发送缓冲区放得下的部分，不在关中断时等待串口
+ *      未输出的内容超过缓冲区一半时由写者自己输出，不会覆盖未输出的记录
+ *      已输出的记录保留在缓冲区中直到被覆盖，可以通过 syslog 系统调用读取（dmesg）
+***********************************************************************/
+
+#include "types.h"
+#include "def.h"
+#include "consts.h"
+#include "riscv.h"
+#include "log.h"
+#include "thread.h"
+#include "spinlock.h"
+#include "rcu.h"
+#include "tlb.h"
+#include "fpu.h"
+#include "edf.h"
+#include "ktimer.h"
+#include "uart.h"
+#include "fs.h"
+
+// 记录头，按 8 字节对齐存放，正文紧随其后（可能绕回缓冲区开头），长度补齐到 8 字节
+typedef struct {
+    uint32 seq;         // 全局序号
+    uint8 level;        // 日志级别
+    uint8 hart;         // 写入的 hart
+    uint16 len;         // 正文长度
+} LogHeader;
+
+#define RECORD_SIZE(len)    (sizeof(LogHeader) + (((len) + 7) & ~7))
+
+// 一个 hart 的日志缓冲区，[tail, head) 为保留的记录，[flushed, head) 为尚未输出的记录
+typedef struct {
+    char buf[LOG_RING_SIZE];
+    usize head;         // 下一条记录的写入位置，只由本 hart 修改
+    usize tail;         // 最早保留的记录，写入时覆盖旧记录向前推进，只由本 hart 修改
+    usize flushed;      // 下一条待输出的记录，只由持有 FLUSHING 的 hart 修改
+} LogRing;
+
+static LogRing RINGS[MAX_CPU];
+static uint32 SEQ;                  // 下一条记录的序号
+static int FLUSHING;                // 是否有 hart 正在输出（同一时刻只有一个）
+static int ASYNC;                   // 是否已开始异步输出，之前每次 printf 立即输出
+static int CONSOLE_LEVEL = LOG_INFO;    // 级别不高于它的记录才输出到控制台
+static char FLUSH_BUF[LOG_FLUSH_BUF];   // 输出时拼接记录正文，由 FLUSHING 保护
+
+// 调度开始前每条日志立即输出；之后调用，printf 只写入缓冲区
+void
+startAsyncLog()
+{
+    __atomic_store_n(&ASYNC, 1, __ATOMIC_RELEASE);
+}
+
+// 从环形缓冲区的 pos 处拷贝 len 字节
+static void
+ringCopy(LogRing *r, usize pos, char *dst, int len)
+{
+    int i;
+    for(i = 0; i < len; i ++) {
+        dst[i] = r->buf[(pos + i) & (LOG_RING_SIZE - 1)];
+    }
+}
+
+static inline LogHeader *
+headerAt(LogRing *r, usize pos)
+{
+    return (LogHeader *)&r->buf[pos & (LOG_RING_SIZE - 1)];
+}
+
+static void flushRecords(int force);
+
+/*
+ * 将一条记录写入本 hart 的日志缓冲区
+ * 关中断期间完成，同一 hart 上的中断处理程序不会与之交错，不需要加锁
+ */
+void
+appendLog(int level, char *text, int len)
+{
+    if(len > LOG_LINE_MAX) {
+        len = LOG_LINE_MAX;
+    }
+    usize flags = disable_and_store();
+    LogRing *r = &RINGS[cpuid()];
+    usize size = RECORD_SIZE(len);
+    // 未输出的内容超过一半时先输出，保证写入不会覆盖未输出的记录
+    while(r->head + size - __atomic_load_n(&r->flushed, __ATOMIC_ACQUIRE) > LOG_RING_SIZE / 2) {
+        flushRecords(1);
+    }
+    // 覆盖最旧的记录
+    while(r->head + size - r->tail > LOG_RING_SIZE) {
+        __atomic_store_n(&r->tail, r->tail + RECORD_SIZE(headerAt(r, r->tail)->len), __ATOMIC_RELEASE);
+    }
+    LogHeader *h = headerAt(r, r->head);
+    h->seq = __atomic_fetch_add(&SEQ, 1, __ATOMIC_RELAXED);
+    h->level = level;
+    h->hart = cpuid();
+    h->len = len;
+    int i;
+    for(i = 0; i < len; i ++) {
+        r->buf[(r->head + sizeof(LogHeader) + i) & (LOG_RING_SIZE - 1)] = text[i];
+    }
+    __atomic_store_n(&r->head, r->head + size, __ATOMIC_RELEASE);
+    if(!__atomic_load_n(&ASYNC, __ATOMIC_ACQUIRE)) {
+        flushRecords(1);    // 启动阶段立即输出，便于定位启动时的问题
+    }
+    restore_sstatus(flags);
+}
+
+// 各 hart 中序号最小的待输出记录所在的 hart，没有时返回 -1
+static int
+nextPending()
+{
+    int hart, best = -1;
+    uint32 bestSeq = 0;
+    for(hart = 0; hart < MAX_CPU; hart ++) {
+        LogRing *r = &RINGS[hart];
+        if(r->flushed == __atomic_load_n(&r->head, __ATOMIC_ACQUIRE)) continue;
+        uint32 seq = headerAt(r, r->flushed)->seq;
+        if(best == -1 || (int)(seq - bestSeq) < 0) {
+            best = hart;
+            bestSeq = seq;
+        }
+    }
+    return best;
+}
+
+// 按序号输出各 hart 未输出的记录，最多输出 room 字节，其余留到下次输出，需持有 FLUSHING
+static void
+drainRecords(usize room)
+{
+    int hart, n = 0;
+    while((hart = nextPending()) != -1) {
+        LogRing *r = &RINGS[hart];
+        LogHeader *h = headerAt(r, r->flushed);
+        int len = h->len;
+        if(h->level <= CONSOLE_LEVEL) {
+            if(len > room) {
+                break;
+            }
+            room -= len;
+            if(n + len > LOG_FLUSH_BUF) {
+                consoleWrite(FLUSH_BUF, n);
+                n = 0;
+            }
+            ringCopy(r, r->flushed + sizeof(LogHeader), FLUSH_BUF + n, len);
+            n += len;
+        }
+        __atomic_store_n(&r->flushed, r->flushed + RECORD_SIZE(len), __ATOMIC_RELEASE);
+    }
+    if(n > 0) {
+        consoleWrite(FLUSH_BUF, n);     // 多条记录合并为一次输出
+    }
+}
+
+/*
+ * 输出各 hart 未输出的记录，需关闭异步中断
+ * force 为 0 时若其他 hart 正在输出则直接返回，只输出串口发送缓冲区放得下的记录
+ * force 为 1 时等待其他 hart 输出完成，并输出所有记录，串口发送缓冲区满时原地等待
+ */
+static void
+flushRecords(int force)
+{
+    while(__atomic_exchange_n(&FLUSHING, 1, __ATOMIC_ACQUIRE) != 0) {
+        if(!force) {
+            return;
+        }
+    }
+    drainRecords(force ? -1UL : uartTxRoom());
+    __atomic_store_n(&FLUSHING, 0, __ATOMIC_RELEASE);
+}
+
+// 尝试输出日志，其他 hart 正在输出时直接返回；在空闲循环和时钟中断中调用
+void
+flushLog()
+{
+    if(!logPending()) {
+        return;
+    }
+    usize flags = disable_and_store();
+    flushRecords(0);
+    restore_sstatus(flags);
+}
+
+/*
+ * panic 时同步输出所有未输出的记录
+ * 其他 hart 已经停下，可能停在输出过程中，因此不等待 FLUSHING
+ */
+void
+flushLogSync()
+{
+    drainRecords(-1UL);
+}
+
+// 是否有未输出的记录，有时时钟中断不停止，保证日志最终被输出
+int
+logPending()
+{
+    int hart;
+    for(hart = 0; hart < MAX_CPU; hart ++) {
+        LogRing *r = &RINGS[hart];
+        if(__atomic_load_n(&r->flushed, __ATOMIC_RELAXED) != __atomic_load_n(&r->head, __ATOMIC_RELAXED)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * 按序号合并各 hart 保留的记录，以 "<级别>正文" 的格式拷贝到 dst，最多 len 字节，返回拷贝的字节数
+ * 读取期间记录可能被写者覆盖：拷贝后检查 tail 是否越过了该记录，越过则丢弃
+ */
+static usize
+readLog(char *dst, usize len)
+{
+    usize pos[MAX_CPU], head[MAX_CPU];
+    int lineStart[MAX_CPU];
+    int hart;
+    for(hart = 0; hart < MAX_CPU; hart ++) {
+        head[hart] = __atomic_load_n(&RINGS[hart].head, __ATOMIC_ACQUIRE);
+        pos[hart] = __atomic_load_n(&RINGS[hart].tail, __ATOMIC_ACQUIRE);
+        lineStart[hart] = 1;
+    }
+    usize n = 0;
+    char line[LOG_LINE_MAX + 4];
+    while(1) {
+        int best = -1;
+        uint32 bestSeq = 0;
+        for(hart = 0; hart < MAX_CPU; hart ++) {
+            LogRing *r = &RINGS[hart];
+            // 读取位置已被覆盖时跳到当前最早的记录
+            usize tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+            if((long)(pos[hart] - tail) < 0) {
+                pos[hart] = tail;
+            }
+            if(pos[hart] == head[hart]) continue;
+            uint32 seq = headerAt(r, pos[hart])->seq;
+            if(best == -1 || (int)(seq - bestSeq) < 0) {
+                best = hart;
+                bestSeq = seq;
+            }
+        }
+        if(best == -1) {
+            break;
+        }
+        LogRing *r = &RINGS[best];
+        LogHeader h = *headerAt(r, pos[best]);
+        int l = 0;
+        if(h.len > LOG_LINE_MAX) {
+            h.len = 0;      // 记录头已被覆盖
+        }
+        if(lineStart[best]) {
+            line[l ++] = '<';
+            line[l ++] = '0' + h.level;
+            line[l ++] = '>';
+        }
+        ringCopy(r, pos[best] + sizeof(LogHeader), line + l, h.len);
+        l += h.len;
+        usize start = pos[best];
+        pos[best] += RECORD_SIZE(h.len);
+        if((long)(start - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE)) < 0) {
+            continue;       // 拷贝期间被覆盖
+        }
+        if(n + l > len) {
+            break;
+        }
+        int i;
+        for(i = 0; i < l; i ++) {
+            dst[n + i] = line[i];
+        }
+        n += l;
+        lineStart[best] = h.len > 0 && line[l - 1] == '\n';
+    }
+    return n;
+}
+
+// 依次输出各子系统收集的统计信息，与普通日志一样写入日志缓冲区并输出到控制台
+static void
+printKernelStats()
+{
+    printThreads();
+    printKernelStackStats();
+    printLoadStats();
+    printLockStats();
+    printRcuStats();
+    printTlbStats();
+    printFpStats();
+    printEdfStats();
+    printTimerStats();
+    printKtimerStats();
+    printUartStats();
+    printPathCacheStats();
+}
+
+/*
+ * syslog 系统调用
+ *      SYSLOG_READ_ALL：将保留的日志按时间顺序拷贝到内核缓冲区 buf，返回拷贝的字节数
+ *      SYSLOG_CONSOLE_LEVEL：设置输出到控制台的最低级别（len 为级别）
+ *      SYSLOG_KERNEL_STATS：输出线程表和各子系统的统计信息
+ */
+long
+syslog(int type, char *buf, usize len)
+{
+    switch(type) {
+    case SYSLOG_READ_ALL:
+        return readLog(buf, len);
+    case SYSLOG_KERNEL_STATS:
+        printKernelStats();
+        return 0;
+    case SYSLOG_CONSOLE_LEVEL:
+        if(len > LOG_DEBUG) {
+            return -EINVAL;
+        }
+        __atomic_store_n(&CONSOLE_LEVEL, (int)len, __ATOMIC_RELAXED);
+        return 0;
+    default:
+        return -EINVAL;
+    }
+}
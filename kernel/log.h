@@ -0,0 +1,35 @@
+/************************** 内核日志缓冲区 *****************************
+ * Author：Joker001014
+ * 2025.03.30
+***********************************************************************/
+
+#ifndef _LOG_H
+#define _LOG_H
+
+#include "types.h"
+
+/* 日志级别，数值越小越重要 */
+#define LOG_EMERG       0       // 系统不可用（panic）
+#define LOG_ERR         3       // 错误
+#define LOG_WARN        4       // 警告
+#define LOG_INFO        6       // 普通信息（printf 的默认级别）
+#define LOG_DEBUG       7       // 调试信息，默认只记录不输出到控制台
+
+#define LOG_RING_SIZE   0x4000  // 每个 hart 的日志环形缓冲区大小，需为 2 的幂
+#define LOG_LINE_MAX    512     // 一次 printf 格式化后的最大长度
+#define LOG_FLUSH_BUF   1024    // 输出到控制台时一批的最大长度
+#define LOG_READ_MAX    (MAX_CPU * LOG_RING_SIZE)   // 一次读取日志的最大长度，每条记录输出的字节数不超过它占用的空间
+
+/* syslog 系统调用的操作，与 Linux 的编号一致 */
+#define SYSLOG_READ_ALL         3   // 读取缓冲区中保留的全部日志
+#define SYSLOG_CONSOLE_LEVEL    8   // 设置输出到控制台的最低级别
+#define SYSLOG_KERNEL_STATS     100 // 本系统扩展：把各子系统的统计信息写入日志
+
+void startAsyncLog();
+void appendLog(int level, char *text, int len);
+void flushLog();
+void flushLogSync();
+int  logPending();
+long syslog(int type, char *buf, usize len);
+
+#endif
@@ -33,12 +33,32 @@ void main()
     // extern void initThread();       initThread();       // 初始化线程管理
     // extern void runCPU();           runCPU();           // 切换到 idle 调度线程，表示正式由 CPU 进行线程管理和调度
     
+    extern void initPrintf();       initPrintf();       // 初始化输出锁
     extern void initMemory();       initMemory();       // 初始化 页分配 和 动态内存分配
     extern void initInterrupt();    initInterrupt();    // 设置中断处理程序入口 和 模式
+    extern void initStdin();        initStdin();        // 初始化标准输入缓冲区
     extern void initFs();           initFs();           // 初始化文件系统
+    extern void initKtimers();      initKtimers();      // 初始化各 hart 的定时器时间轮
+    extern void initVdso();         initVdso();         // 初始化映射到每个进程的共享数据页
+    extern void initShm();          initShm();          // 初始化共享内存段表
+    extern void initIpc();          initIpc();          // 初始化同步消息传递的端口
     extern void initThread();       initThread();       // 初始化线程管理
+    extern void startHarts();       startHarts();       // 启动其他 hart
     extern void initTimer();        initTimer();        // 时钟中断初始化
+    extern void startAsyncLog();    startAsyncLog();    // 此后日志由空闲循环和时钟中断批量输出
     extern void runCPU();           runCPU();           // 切换到 idle 调度线程，表示正式由 CPU 进行线程管理和调度
  
+    while(1) {}
+}
+
+// 其他 hart 的入口，由 entry.S 中的 _secondary_start 跳转而来
+void secondaryMain()
+{
+    extern void initHartMemory();       initHartMemory();       // 切换到启动 hart 重映射好的内核页表
+    extern void initHartInterrupt();    initHartInterrupt();    // 设置中断处理程序入口，开启软件中断
+    extern void initHartThread();       initHartThread();       // 构建本 hart 的 idle 调度线程
+    extern void initTimer();            initTimer();            // 时钟中断初始化
+    extern void runCPU();               runCPU();               // 切换到本 hart 的 idle 调度线程
+
     while(1) {}
 }
\ No newline at end of file
@@ -132,6 +132,236 @@ mapFramedAndCopy(Mapping m, Segment segment, char *data, usize length)
     }
 }
 
+/*
+ * 根据给定的虚拟页号寻找三级页表项，与 findEntry 不同，某一级页表不存在时返回 0 而不创建
+ */
+PageTableEntry
+*lookupEntry(Mapping self, usize vpn)
+{
+    PageTable *rootTable = (PageTable *)accessVaViaPa(self.rootPpn << 12);
+    usize levels[3];
+    getVpnLevels(vpn, levels);
+    PageTableEntry *entry = &(rootTable->entries[levels[0]]);
+    int i;
+    for(i = 1; i <= 2; i ++) {
+        if(*entry == 0) {
+            return 0;
+        }
+        usize nextPageAddr = (*entry & PDE_MASK) << 2;
+        entry = &(((PageTable *)accessVaViaPa(nextPageAddr))->entries[levels[i]]);
+    }
+    return entry;
+}
+
+// Sv39 地址的 63..39 位必须与第 38 位相同，否则页表查找只用到 38..12 位，会与合法地址重名
+static inline int
+isCanonical(usize va)
+{
+    return (usize)(((long)va << 25) >> 25) == va;
+}
+
+/*
+ * 将用户虚拟地址转换为物理地址，地址未映射或不允许用户访问时返回 0
+ */
+usize
+translateVa(Mapping self, usize va)
+{
+    if(!isCanonical(va)) {
+        return 0;
+    }
+    PageTableEntry *entry = lookupEntry(self, va / PAGE_SIZE);
+    if(entry == 0 || !(*entry & VALID) || !(*entry & USER)) {
+        return 0;
+    }
+    return ((*entry & PDE_MASK) << 2) | (va & (PAGE_SIZE - 1));
+}
+
+/*
+ * 检查用户缓冲区 [va, va + len) 的每一页都已映射，且允许用户以 perm（READABLE / WRITABLE）访问
+ * 返回：1-可以访问，0-地址无效
+ */
+int
+checkUserRange(Mapping self, usize va, usize len, usize perm)
+{
+    if(len == 0) {
+        return 1;
+    }
+    if(va + len < va) {
+        return 0;       // 地址回绕
+    }
+    // 首尾都是规范地址且位于同一半，范围内不会跨过中间的空洞
+    usize last = va + len - 1;
+    if(!isCanonical(va) || !isCanonical(last) || (long)(va ^ last) < 0) {
+        return 0;
+    }
+    usize vpn, endVpn = (va + len - 1) / PAGE_SIZE;
+    for(vpn = va / PAGE_SIZE; vpn <= endVpn; vpn ++) {
+        PageTableEntry *entry = lookupEntry(self, vpn);
+        if(entry == 0 || (*entry & (VALID | USER | perm)) != (VALID | USER | perm)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// va 所在页允许用户以 perm 访问时返回 va 对应的内核虚拟地址，否则返回 0
+static char *
+userPageAddr(Mapping self, usize va, usize perm)
+{
+    if(!isCanonical(va)) {
+        return 0;
+    }
+    PageTableEntry *entry = lookupEntry(self, va / PAGE_SIZE);
+    if(entry == 0 || (*entry & (VALID | USER | perm)) != (VALID | USER | perm)) {
+        return 0;
+    }
+    return (char *)accessVaViaPa(((*entry & PDE_MASK) << 2) | (va & (PAGE_SIZE - 1)));
+}
+
+/*
+ * 将内核缓冲区 src 的 len 个字节拷贝到用户地址 va
+ * 拷贝时逐页查页表，不依赖之前 checkUserRange 的结果；调用者需持有进程锁，拷贝期间映射不会被其他线程修改
+ * 返回：1-成功，0-某页未映射或不可写（之前的页已写入）
+ */
+int
+copyToUser(Mapping self, usize va, char *src, usize len)
+{
+    while(len > 0) {
+        char *dst = userPageAddr(self, va, WRITABLE);
+        if(dst == 0) {
+            return 0;
+        }
+        usize k = PAGE_SIZE - (va & (PAGE_SIZE - 1));
+        if(k > len) k = len;
+        usize i;
+        for(i = 0; i < k; i ++) {
+            dst[i] = src[i];
+        }
+        va += k;
+        src += k;
+        len -= k;
+    }
+    return 1;
+}
+
+// 将用户地址 va 的 len 个字节拷贝到内核缓冲区 dst，要求同 copyToUser，某页未映射或不可读时返回 0
+int
+copyFromUser(Mapping self, char *dst, usize va, usize len)
+{
+    while(len > 0) {
+        char *src = userPageAddr(self, va, READABLE);
+        if(src == 0) {
+            return 0;
+        }
+        usize k = PAGE_SIZE - (va & (PAGE_SIZE - 1));
+        if(k > len) k = len;
+        usize i;
+        for(i = 0; i < k; i ++) {
+            dst[i] = src[i];
+        }
+        va += k;
+        dst += k;
+        len -= k;
+    }
+    return 1;
+}
+
+// 将用户地址 va 处以 0 结尾的字符串拷贝到 dst（最多 max 字节，含结尾的 0），要求同 copyToUser
+// 返回字符串长度，地址无效或超过 max 时返回 -1
+long
+copyStringFromUser(Mapping self, char *dst, usize va, usize max)
+{
+    usize n = 0;
+    while(n < max) {
+        char *src = userPageAddr(self, va + n, READABLE);
+        if(src == 0) {
+            return -1;
+        }
+        usize k = PAGE_SIZE - ((va + n) & (PAGE_SIZE - 1));
+        usize i;
+        for(i = 0; i < k && n < max; i ++, n ++) {
+            dst[n] = src[i];
+            if(src[i] == 0) {
+                return n;
+            }
+        }
+    }
+    return -1;
+}
+
+/*
+ * 将 va 所在页映射到物理页 frame 上，保留原有权限，返回原来的物理页
+ * 原来的页必须是进程私有的可读写用户页，否则不修改并返回 0
+ * 调用者需持有进程锁，并在原来的物理页被他人使用或释放之前刷新 TLB
+ */
+usize
+exchangeUserPage(Mapping self, usize va, usize frame)
+{
+    PageTableEntry *entry = lookupEntry(self, va / PAGE_SIZE);
+    usize need = VALID | USER | READABLE | WRITABLE;
+    if(entry == 0 || (*entry & need) != need || (*entry & SHARED)) {
+        return 0;
+    }
+    usize old = (*entry & PDE_MASK) << 2;
+    *entry = (frame >> 2) | (*entry & ~PDE_MASK);
+    return old;
+}
+
+/*
+ * 解除一个段的映射并释放其物理页
+ * 被解除映射的页记录到 batch 中，由调用者在全部修改完成后调用 flushTlbBatch 统一刷新 TLB 并释放物理页
+ */
+void
+unmapFramedSegment(Mapping m, Segment segment, TlbBatch *batch)
+{
+    usize startVpn = segment.startVaddr / PAGE_SIZE;
+    usize endVpn = (segment.endVaddr - 1) / PAGE_SIZE + 1;
+    usize vpn;
+    for(vpn = startVpn; vpn < endVpn; vpn ++) {
+        PageTableEntry *entry = lookupEntry(m, vpn);
+        if(entry == 0 || *entry == 0) {
+            continue;
+        }
+        usize pAddr = (*entry & PDE_MASK) << 2;
+        *entry = 0;
+        addTlbBatch(batch, vpn * PAGE_SIZE, pAddr);   // 刷新 TLB 后才释放物理页
+    }
+}
+
+// 递归释放一级页表及其下的所有页表，叶子页表项中只释放用户页，内核的线性映射不属于该地址空间
+static void
+freePageTable(usize tablePaddr)
+{
+    PageTable *table = (PageTable *)accessVaViaPa(tablePaddr);
+    int i;
+    for(i = 0; i < (PAGE_SIZE >> 3); i ++) {
+        PageTableEntry entry = table->entries[i];
+        if(!(entry & VALID)) {
+            continue;
+        }
+        usize pAddr = (entry & PDE_MASK) << 2;
+        if(entry & (READABLE | WRITABLE | EXECUTABLE)) {
+            // 叶子页表项
+            if((entry & USER) && !(entry & SHARED)) {
+                deallocFrame(pAddr);
+            }
+        } else {
+            freePageTable(pAddr);
+        }
+    }
+    deallocFrame(tablePaddr);
+}
+
+/*
+ * 销毁一个地址空间，释放所有用户页和页表
+ * 调用时不能有 hart 正在使用该地址空间
+ */
+void
+freeMapping(Mapping m)
+{
+    freePageTable(m.rootPpn << 12);
+}
+
 /*
  * 将页表地址写入 satp 中
  * 设置 satp 为 SV39，并刷新 TLB
@@ -215,9 +445,10 @@ mapExtInterruptArea(Mapping m)
     };
     mapLinearSegment(m, s2);
 
+    // 各 hart S 态上下文（2n+1）的阈值和 claim 寄存器，启动 hart 不一定是 hart 0
     Segment s3 = {
         (usize)0x0C201000 + KERNEL_MAP_OFFSET,
-        (usize)0x0C202000 + KERNEL_MAP_OFFSET,
+        (usize)0x0C200000 + (2 * MAX_CPU) * 0x1000 + KERNEL_MAP_OFFSET,
         1L | READABLE | WRITABLE
     };
     mapLinearSegment(m, s3);
@@ -231,6 +462,9 @@ mapExtInterruptArea(Mapping m)
     mapLinearSegment(m, s4);
 }
 
+/* 内核重映射后的地址空间，其他 hart 启动时也使用它 */
+static Mapping KERNEL_MAPPING;
+
 /* 重映射内核,写入satp */
 void
 mapKernel()
@@ -238,9 +472,17 @@ mapKernel()
     Mapping m = newKernelMapping();     // 创建一个映射了内核(0x80200000后地址）的虚拟地址空间
     mapExtInterruptArea(m);             // 创建一个映射了PLIC和UART地址
     activateMapping(m);                 // 将根页表地址写入 satp
+    KERNEL_MAPPING = m;
     printf("***** Remap Kernel *****\n");
 }
 
+/* 其他 hart 启动时切换到启动 hart 已经重映射好的内核页表 */
+void
+mapKernelHart()
+{
+    activateMapping(KERNEL_MAPPING);
+}
+
 /* 获得线性映射后的虚拟地址 */
 usize
 accessVaViaPa(usize pa)
@@ -8,6 +8,7 @@
 
 #include "types.h"
 #include "consts.h"
+#include "tlb.h"
 
 typedef usize PageTableEntry;   /* 页表项长度 64 位 */
 
@@ -29,6 +30,7 @@ typedef struct
 #define GLOBAL      1 << 5
 #define ACCESSED    1 << 6
 #define DIRTY       1 << 7
+#define SHARED      1 << 8      /* 软件保留位：多个地址空间共享的页，销毁地址空间时不释放 */
 
 // 映射片段，描述映射到虚拟内存的一个段
 typedef struct
@@ -46,13 +48,30 @@ typedef struct
     usize rootPpn;      /* 根页表的物理页号 */
 } Mapping;
 
+// satp 寄存器值中的根页表物理页号，即该地址空间的 Mapping
+static inline Mapping
+satpMapping(usize satp)
+{
+    Mapping m = {satp & ((1L << 44) - 1)};
+    return m;
+}
+
 usize accessVaViaPa(usize pa);
 
 Mapping newKernelMapping();
 void mapLinearSegment(Mapping self, Segment segment);
-// void mapFramedSegment(Mapping m, Segment segment);
+void mapFramedSegment(Mapping m, Segment segment);
 void mapFramedAndCopy(Mapping m, Segment segment, char *data, usize length);
 
 PageTableEntry *findEntry(Mapping self, usize vpn);
+PageTableEntry *lookupEntry(Mapping self, usize vpn);
+usize translateVa(Mapping self, usize va);
+int checkUserRange(Mapping self, usize va, usize len, usize perm);
+int copyToUser(Mapping self, usize va, char *src, usize len);
+int copyFromUser(Mapping self, char *dst, usize va, usize len);
+long copyStringFromUser(Mapping self, char *dst, usize va, usize max);
+usize exchangeUserPage(Mapping self, usize va, usize frame);
+void unmapFramedSegment(Mapping m, Segment segment, TlbBatch *batch);
+void freeMapping(Mapping m);
 
 #endif
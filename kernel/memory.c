@@ -9,10 +9,14 @@
 #include "memory.h"
 #include "consts.h"
 #include "riscv.h"
+#include "spinlock.h"
 
 /* 全局唯一的页帧分配器 */
 FrameAllocator frameAllocator;
 
+/* 保护页帧分配器的线段树 */
+static Spinlock FRAME_LOCK;
+
 /* 分配算法需要实现的三个函数 */
 Allocator newAllocator(usize startPpn, usize endPpn);
 usize alloc();                                           
@@ -22,6 +26,7 @@ void dealloc(usize ppn);
 void
 initFrameAllocator(usize startPpn, usize endPpn)
 {
+    initLock(&FRAME_LOCK, "frame");
     frameAllocator.startPpn = startPpn;     // 设置分配器的起始页帧号
     frameAllocator.allocator = newAllocator(startPpn, endPpn);  // 初始化页帧分配器
 }
@@ -33,7 +38,9 @@ initFrameAllocator(usize startPpn, usize endPpn)
 usize
 allocFrame()
 {
+    usize flags = acquireLockIrqsave(&FRAME_LOCK);
     usize start = alloc() << 12;
+    releaseLockIrqrestore(&FRAME_LOCK, flags);
     int i;
     /*
      * 清空被分配的区域
@@ -66,7 +73,9 @@ allocFrame()
 void
 deallocFrame(usize startAddr)
 {
+    usize flags = acquireLockIrqsave(&FRAME_LOCK);
     dealloc(startAddr >> 12);
+    releaseLockIrqrestore(&FRAME_LOCK, flags);
 }
 
 
@@ -99,6 +108,17 @@ initMemory()
     printf("***** Init Memory *****\n");
 }
 
+/*
+ * 其他 hart 的内存初始化
+ * 页帧分配器和堆已由启动 hart 初始化，只需开启 SUM 位并切换到内核页表
+ */
+void
+initHartMemory()
+{
+    w_sstatus(r_sstatus() | SSTATUS_SUM);
+    extern void mapKernelHart();    mapKernelHart();
+}
+
 
 /* 最大可用的内存长度，从 0x80000000 ~ 0x88000000 */
 #define MAX_PHYSICAL_PAGES 0x8000   // 页带小为4K
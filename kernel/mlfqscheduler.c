@@ -0,0 +1,273 @@
+/************************ 多级反馈队列调度算法 ***************************
+ * Author：Joker001014
+ * 2025.03.25
+ * 实现 thread.h 中定义的 Scheduler 结构体中的五个调度器算法
+ * 每个 hart 有 MLFQ_LEVELS 级就绪队列，总是先运行高优先级队列中的线程
+ *      用完时间片的线程降一级，低优先级队列的时间片更长，计算密集的线程切换次数更少
+ *      休眠后被唤醒的线程回到最高优先级，交互式线程（如等待输入的 shell）能很快得到响应
+ *      每隔 MLFQ_BOOST_INTERVAL 个 tick 把所有线程提升到最高优先级，防止低优先级线程饿死
+ * 与 RR 相同，本 hart 没有就绪线程时从最忙的 hart 窃取
+***********************************************************************/
+
+#include "types.h"
+#include "def.h"
+#include "thread.h"
+#include "riscv.h"
+#include "spinlock.h"
+
+#define MLFQ_LEVELS             4       // 优先级级数，0 最高
+#define MLFQ_BOOST_INTERVAL     100     // 全局提升的间隔（tick）
+
+// 各级的时间片（tick）
+static const usize QUANTUM[MLFQ_LEVELS] = {1, 2, 4, 8};
+
+// 双向环形链表来实现队列，队列元素如下
+typedef struct
+{
+    int valid;      // 标记线程是否在就绪队列中
+    int level;      // 线程所在的优先级
+    usize time;     // 线程剩余时间片
+    int expired;    // 上次运行是否用完了时间片，重新入队时降级
+    int woken;      // 本次入队是否由休眠后的唤醒引起（见 mlfqWake）
+    int prev;       // 前一个节点下标
+    int next;       // 后一个节点下标
+} MLFQInfo;
+
+// 下标 0 ~ HEADS-1 处为各个 hart 各级队列的 Dummy Head，线程的节点按照 tid + HEADS 存放
+#define HEADS               (MAX_CPU * MLFQ_LEVELS)
+#define HEAD(hart, level)   ((hart) * MLFQ_LEVELS + (level))
+#define NODE(tid)           ((tid) + HEADS)
+#define TID(node)           ((node) - HEADS)
+
+// 调度器信息结构体
+struct
+{
+    MLFQInfo threads[MAX_LIVE_THREADS + HEADS];   // 调度队列节点
+    int length[MAX_CPU];                    // 各 hart 就绪线程总数，用于选择窃取对象
+    Spinlock lock[MAX_CPU];                 // 各 hart 就绪队列的锁
+    int current[MAX_CPU];                   // 各 hart 当前正在运行的节点下标，0 表示没有
+    usize ticks[MAX_CPU];                   // 各 hart 距上次全局提升经过的 tick
+} mlfqScheduler;
+
+// 将节点加入 hart 第 level 级队列尾部（需持有队列锁）
+static void
+appendNode(int hart, int level, int node)
+{
+    int head = HEAD(hart, level);
+    int prev = mlfqScheduler.threads[head].prev;
+    mlfqScheduler.threads[node].valid = 1;
+    mlfqScheduler.threads[node].level = level;
+    mlfqScheduler.threads[prev].next = node;
+    mlfqScheduler.threads[node].prev = prev;
+    mlfqScheduler.threads[head].prev = node;
+    mlfqScheduler.threads[node].next = head;
+    mlfqScheduler.length[hart] += 1;
+}
+
+// 将节点从所在队列中摘下（需持有队列锁）
+static void
+unlinkNode(int hart, int node)
+{
+    int next = mlfqScheduler.threads[node].next;
+    int prev = mlfqScheduler.threads[node].prev;
+    mlfqScheduler.threads[next].prev = prev;
+    mlfqScheduler.threads[prev].next = next;
+    mlfqScheduler.threads[node].prev = 0;
+    mlfqScheduler.threads[node].next = 0;
+    mlfqScheduler.threads[node].valid = 0;
+    mlfqScheduler.length[hart] -= 1;
+}
+
+// 初始化调度器
+void
+mlfqInit()
+{
+    int hart, level;
+    for(hart = 0; hart < MAX_CPU; hart ++) {
+        mlfqScheduler.current[hart] = 0;
+        mlfqScheduler.length[hart] = 0;
+        mlfqScheduler.ticks[hart] = 0;
+        initLock(&mlfqScheduler.lock[hart], "runqueue");
+        for(level = 0; level < MLFQ_LEVELS; level ++) {
+            int head = HEAD(hart, level);
+            MLFQInfo mi = {0, level, 0L, 0, 0, head, head};
+            mlfqScheduler.threads[head] = mi;
+        }
+    }
+}
+
+// 将一个线程加入当前 hart 的线程调度
+// 根据上次运行的情况调整优先级：用完时间片降一级，休眠后被唤醒回到最高级
+// 让出 CPU、准备休眠时已被唤醒等情况没有经过 mlfqWake，保持原优先级和剩余时间片
+void
+mlfqPush(int tid)
+{
+    if(tid < 0 || tid >= MAX_LIVE_THREADS) {
+        panic("Cannot push to scheduler!\n");
+    }
+    int hart = cpuid();
+    int node = NODE(tid);
+    MLFQInfo *mi = &mlfqScheduler.threads[node];
+    acquireLock(&mlfqScheduler.lock[hart]);
+    int level = mi->level;
+    if(mi->expired) {
+        if(level < MLFQ_LEVELS - 1) {
+            level += 1;
+        }
+        mi->time = QUANTUM[level];
+    } else if(mi->woken) {
+        level = 0;
+        mi->time = QUANTUM[level];
+    } else if(mi->time == 0) {
+        mi->time = QUANTUM[level];  // 新线程
+    }
+    mi->expired = 0;
+    mi->woken = 0;
+    appendNode(hart, level, node);
+    releaseLock(&mlfqScheduler.lock[hart]);
+    getLoadStats(hart)->enqueued += 1;
+}
+
+// 将一个休眠后被唤醒的线程加入当前 hart 的线程调度，由 wakeupCPU 和 drainInbox 调用
+void
+mlfqWake(int tid)
+{
+    if(tid < 0 || tid >= MAX_LIVE_THREADS) {
+        panic("Cannot push to scheduler!\n");
+    }
+    mlfqScheduler.threads[NODE(tid)].woken = 1; // 线程已离开就绪队列且不在运行，只有唤醒方会访问
+    mlfqPush(tid);
+}
+
+// 从就绪线程最多的 hart 窃取一个线程，取其最低优先级队列的队尾，对原 hart 影响最小
+// 返回窃取到的节点下标，没有可窃取的线程返回 0
+static int
+stealNode(int self)
+{
+    int victim = -1, most = 0, hart;
+    for(hart = 0; hart < MAX_CPU; hart ++) {
+        if(hart == self || !isHartOnline(hart)) continue;
+        int len = __atomic_load_n(&mlfqScheduler.length[hart], __ATOMIC_RELAXED);
+        if(len > most) {
+            most = len;
+            victim = hart;
+        }
+    }
+    if(victim == -1) {
+        return 0;
+    }
+    int node = 0, level;
+    acquireLock(&mlfqScheduler.lock[victim]);
+    for(level = MLFQ_LEVELS - 1; level >= 0; level --) {
+        int head = HEAD(victim, level);
+        if(mlfqScheduler.threads[head].prev != head) {
+            node = mlfqScheduler.threads[head].prev;
+            unlinkNode(victim, node);
+            break;
+        }
+    }
+    releaseLock(&mlfqScheduler.lock[victim]);
+    if(node != 0) {
+        getLoadStats(self)->stolen += 1;
+        getLoadStats(victim)->donated += 1;
+    }
+    return node;
+}
+
+// 从最高优先级的非空队列中选择一个线程运行，如果没有可运行的线程则返回 -1
+int
+mlfqPop()
+{
+    int hart = cpuid();
+    int ret = 0, level;
+    acquireLock(&mlfqScheduler.lock[hart]);
+    for(level = 0; level < MLFQ_LEVELS; level ++) {
+        int head = HEAD(hart, level);
+        if(mlfqScheduler.threads[head].next != head) {
+            ret = mlfqScheduler.threads[head].next;
+            unlinkNode(hart, ret);
+            break;
+        }
+    }
+    releaseLock(&mlfqScheduler.lock[hart]);
+    if(ret == 0) {
+        ret = stealNode(hart);
+    }
+    if(ret == 0) {
+        return -1;
+    }
+    mlfqScheduler.current[hart] = ret;
+    getLoadStats(hart)->dispatched += 1;
+    return TID(ret);
+}
+
+// 将本 hart 所有就绪线程和当前线程提升到最高优先级
+static void
+boostAll(int hart)
+{
+    int level;
+    acquireLock(&mlfqScheduler.lock[hart]);
+    for(level = 1; level < MLFQ_LEVELS; level ++) {
+        int head = HEAD(hart, level);
+        while(mlfqScheduler.threads[head].next != head) {
+            int node = mlfqScheduler.threads[head].next;
+            unlinkNode(hart, node);
+            mlfqScheduler.threads[node].time = QUANTUM[0];
+            appendNode(hart, 0, node);
+        }
+    }
+    releaseLock(&mlfqScheduler.lock[hart]);
+    int current = mlfqScheduler.current[hart];
+    if(current != 0) {
+        mlfqScheduler.threads[current].level = 0;
+    }
+}
+
+// 提醒调度算法当前线程又运行了一个 tick
+// 输出：1-表示调度算法认为当前线程需要被切换出去，0-不需要切换出去
+int
+mlfqTick()
+{
+    int hart = cpuid();
+    mlfqScheduler.ticks[hart] += 1;
+    if(mlfqScheduler.ticks[hart] >= MLFQ_BOOST_INTERVAL) {
+        mlfqScheduler.ticks[hart] = 0;
+        boostAll(hart);
+    }
+    int node = mlfqScheduler.current[hart];
+    if(node == 0) {
+        return 1;
+    }
+    MLFQInfo *mi = &mlfqScheduler.threads[node];
+    // 上一次需要切换时可能没有切换出去（如处于 RCU 读临界区），时间片不会减到负数
+    if(mi->time > 0) {
+        mi->time -= 1;
+    }
+    if(mi->time == 0) {
+        mi->expired = 1;
+        return 1;
+    }
+    return 0;
+}
+
+// 告诉调度算法某个线程已经结束，重置其调度信息，槽位被复用时作为新线程从最高优先级开始
+void
+mlfqExit(int tid)
+{
+    int hart = cpuid();
+    int node = NODE(tid);
+    if(mlfqScheduler.current[hart] == node) {
+        mlfqScheduler.current[hart] = 0;
+    }
+    mlfqScheduler.threads[node].level = 0;
+    mlfqScheduler.threads[node].time = 0;
+    mlfqScheduler.threads[node].expired = 0;
+    mlfqScheduler.threads[node].woken = 0;
+}
+
+// hart 的就绪队列中是否还有线程等待，没有时当前线程不需要时间片轮转（也不需要全局提升）
+int
+mlfqNeedTick(int hart)
+{
+    return __atomic_load_n(&mlfqScheduler.length[hart], __ATOMIC_RELAXED) > 0;
+}
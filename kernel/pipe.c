@@ -0,0 +1,276 @@
+/****************************** 管道 **********************************
+ * Author：Joker001014
+ * 2025.03.30
+ * 管道的数据存放在一组物理页中，这些页组成 2 的幂大小的环形队列
+ *      write 将数据拷贝到队尾的页中，写满后再取一个新页；read 从队首的页拷贝，读完的页立即释放
+ *      没有数据时读者在 readWait 上休眠，所有页都已使用时写者在 writeWait 上休眠
+ * 大块数据可以用 vmsplice 按页传递而不拷贝（见 pipeGift、pipeMap）
+ *      写端交出用户页的物理页，写者的这段地址换上新的清零页
+ *      读端直接把队首的整页映射到读者的地址上，读者原来的物理页被释放
+***********************************************************************/
+
+#include "types.h"
+#include "def.h"
+#include "consts.h"
+#include "thread.h"
+#include "mapping.h"
+#include "tlb.h"
+#include "file.h"
+#include "pipe.h"
+
+#define PIPE_MASK   (PIPE_BUFFERS - 1)
+
+// 创建一个管道，返回其读端和写端，各持有一个引用
+int
+newPipe(File **readEnd, File **writeEnd)
+{
+    Pipe *pipe = kalloc(sizeof(Pipe));
+    initLock(&pipe->lock, 0);      // 管道随最后一端关闭而释放，不登记到锁统计链表
+    pipe->head = 0;
+    pipe->tail = 0;
+    pipe->readers = 1;
+    pipe->writers = 1;
+    initCondition(&pipe->readWait);
+    initCondition(&pipe->writeWait);
+    *readEnd = newFile(FILE_PIPE, 1, 0, pipe);
+    *writeEnd = newFile(FILE_PIPE, 0, 1, pipe);
+    return 0;
+}
+
+// 管道的一端被关闭，唤醒对端的等待者；两端都关闭后释放管道和其中剩余的页
+void
+closePipe(Pipe *pipe, int writeEnd)
+{
+    usize flags = acquireLockIrqsave(&pipe->lock);
+    if(writeEnd) {
+        pipe->writers -= 1;
+    } else {
+        pipe->readers -= 1;
+    }
+    notifyAllCondition(&pipe->readWait);
+    notifyAllCondition(&pipe->writeWait);
+    int closed = pipe->readers == 0 && pipe->writers == 0;
+    releaseLockIrqrestore(&pipe->lock, flags);
+    if(!closed) {
+        return;
+    }
+    while(pipe->head != pipe->tail) {
+        deallocFrame(pipe->bufs[pipe->head & PIPE_MASK].frame);
+        pipe->head += 1;
+    }
+    kfree(pipe);
+}
+
+// 从队首的页中拷贝最多 len 个字节到 buf，读完的页被释放，返回拷贝的字节数（需持有管道锁）
+static usize
+copyFromPipe(Pipe *pipe, char *buf, usize len)
+{
+    usize n = 0;
+    while(n < len && pipe->head != pipe->tail) {
+        PipeBuffer *b = &pipe->bufs[pipe->head & PIPE_MASK];
+        char *src = (char *)accessVaViaPa(b->frame) + b->offset;
+        usize k = len - n < b->len ? len - n : b->len;
+        usize i;
+        for(i = 0; i < k; i ++) {
+            buf[n + i] = src[i];
+        }
+        n += k;
+        b->offset += k;
+        b->len -= k;
+        if(b->len == 0) {
+            deallocFrame(b->frame);
+            pipe->head += 1;
+        }
+    }
+    return n;
+}
+
+// 没有数据且写端仍打开时等待（需持有管道锁）
+static void
+waitForData(Pipe *pipe)
+{
+    while(pipe->head == pipe->tail && pipe->writers > 0) {
+        waitCondition(&pipe->readWait, &pipe->lock);
+    }
+}
+
+// 从管道读取最多 len 个字节，没有数据时等待，之后只返回已有的数据
+// 返回读取的字节数，写端全部关闭且没有数据时返回 0
+long
+pipeRead(Pipe *pipe, char *buf, usize len)
+{
+    usize flags = acquireLockIrqsave(&pipe->lock);
+    waitForData(pipe);
+    usize n = copyFromPipe(pipe, buf, len);
+    if(n > 0) {
+        notifyAllCondition(&pipe->writeWait);
+    }
+    releaseLockIrqrestore(&pipe->lock, flags);
+    return n;
+}
+
+// 向管道写入 len 个字节，空间不足时等待读者取走数据，全部写入后才返回
+// 返回写入的字节数，读端已全部关闭时返回 -EPIPE（已写入部分数据时返回已写入的字节数）
+long
+pipeWrite(Pipe *pipe, char *buf, usize len)
+{
+    usize n = 0;
+    usize flags = acquireLockIrqsave(&pipe->lock);
+    while(n < len) {
+        if(pipe->readers == 0) {
+            break;
+        }
+        // 先填满队尾页的剩余空间，交出的整页没有剩余空间
+        if(pipe->tail != pipe->head) {
+            PipeBuffer *b = &pipe->bufs[(pipe->tail - 1) & PIPE_MASK];
+            usize room = PAGE_SIZE - b->offset - b->len;
+            if(room > 0) {
+                char *dst = (char *)accessVaViaPa(b->frame) + b->offset + b->len;
+                usize k = len - n < room ? len - n : room;
+                usize i;
+                for(i = 0; i < k; i ++) {
+                    dst[i] = buf[n + i];
+                }
+                b->len += k;
+                n += k;
+                continue;
+            }
+        }
+        if(pipe->tail - pipe->head == PIPE_BUFFERS) {
+            // 已写入的数据先交给读者，再等待空闲缓冲区
+            notifyAllCondition(&pipe->readWait);
+            waitCondition(&pipe->writeWait, &pipe->lock);
+            continue;
+        }
+        PipeBuffer *b = &pipe->bufs[pipe->tail & PIPE_MASK];
+        b->frame = allocFrame();
+        b->offset = 0;
+        b->len = 0;
+        pipe->tail += 1;
+    }
+    notifyAllCondition(&pipe->readWait);
+    releaseLockIrqrestore(&pipe->lock, flags);
+    if(n == 0 && len > 0) {
+        return -EPIPE;
+    }
+    return n;
+}
+
+/*
+ * vmsplice 写端：把用户缓冲区 [addr, addr + len) 的整页交给管道，不拷贝数据
+ * addr 和 len 需按页对齐，这些页必须是进程私有的可读写页
+ * 交出后写者的这段地址换上新的清零页，管道中的页在所有 hart 刷新 TLB 后才对读者可见
+ * 返回交出的字节数，读端已全部关闭时返回 -EPIPE
+ */
+long
+pipeGift(Pipe *pipe, usize addr, usize len)
+{
+    Process *p = getCurrentThread()->process;
+    usize done = 0;
+    while(done < len) {
+        // 一次换出最多 PIPE_BUFFERS 页，合并为一次 TLB 刷新
+        usize frames[PIPE_BUFFERS];
+        int i, n = 0;
+        TlbBatch batch;
+        initTlbBatch(&batch, p);
+        while(n < PIPE_BUFFERS && done + n * PAGE_SIZE < len) {
+            usize va = addr + done + n * PAGE_SIZE;
+            usize fresh = allocFrame();
+            usize flags = acquireLockIrqsave(&p->lock);
+            usize old = exchangeUserPage(satpMapping(p->satp), va, fresh);
+            releaseLockIrqrestore(&p->lock, flags);
+            if(old == 0) {
+                deallocFrame(fresh);
+                break;
+            }
+            addTlbBatch(&batch, va, 0);
+            frames[n ++] = old;
+        }
+        flushTlbBatch(&batch);
+        if(n == 0) {
+            return done > 0 ? done : -EFAULT;
+        }
+        usize flags = acquireLockIrqsave(&pipe->lock);
+        for(i = 0; i < n; i ++) {
+            while(pipe->tail - pipe->head == PIPE_BUFFERS && pipe->readers > 0) {
+                notifyAllCondition(&pipe->readWait);
+                waitCondition(&pipe->writeWait, &pipe->lock);
+            }
+            if(pipe->readers == 0) {
+                break;
+            }
+            PipeBuffer *b = &pipe->bufs[pipe->tail & PIPE_MASK];
+            b->frame = frames[i];
+            b->offset = 0;
+            b->len = PAGE_SIZE;
+            pipe->tail += 1;
+        }
+        notifyAllCondition(&pipe->readWait);
+        releaseLockIrqrestore(&pipe->lock, flags);
+        done += i * PAGE_SIZE;
+        if(i < n) {
+            // 读端已关闭，剩余的页不再需要
+            for(; i < n; i ++) {
+                deallocFrame(frames[i]);
+            }
+            return done > 0 ? done : -EPIPE;
+        }
+    }
+    return done;
+}
+
+/*
+ * vmsplice 读端：队首是完整的一页时，直接映射到读者的 [addr, addr + len) 上，不拷贝数据
+ * addr 和 len 需按页对齐；遇到不完整的页时将它从管道取下，释放管道锁后在进程锁下拷贝其中的数据，然后结束
+ * 没有数据时等待，返回读取的字节数，写端全部关闭且没有数据时返回 0，目标页不是私有的可写页时返回 -EFAULT
+ */
+long
+pipeMap(Pipe *pipe, usize addr, usize len)
+{
+    Process *p = getCurrentThread()->process;
+    TlbBatch batch;
+    initTlbBatch(&batch, p);
+    usize done = 0;
+    int fault = 0;
+    PipeBuffer partial = {0, 0, 0};
+    usize flags = acquireLockIrqsave(&pipe->lock);
+    waitForData(pipe);
+    while(done < len && pipe->head != pipe->tail) {
+        PipeBuffer *b = &pipe->bufs[pipe->head & PIPE_MASK];
+        usize va = addr + done;
+        if(b->offset != 0 || b->len != PAGE_SIZE) {
+            partial = *b;       // 剩余空间至少一页，整个取下
+            pipe->head += 1;
+            break;
+        }
+        acquireLock(&p->lock);
+        usize old = exchangeUserPage(satpMapping(p->satp), va, b->frame);
+        releaseLock(&p->lock);
+        if(old == 0) {
+            fault = 1;
+            break;
+        }
+        addTlbBatch(&batch, va, old);   // 读者原来的物理页在刷新 TLB 后释放
+        pipe->head += 1;
+        done += PAGE_SIZE;
+    }
+    if(done > 0 || partial.frame != 0) {
+        notifyAllCondition(&pipe->writeWait);
+    }
+    releaseLockIrqrestore(&pipe->lock, flags);
+    flushTlbBatch(&batch);
+    if(partial.frame != 0) {
+        // 等待数据期间映射可能已被其他线程修改，拷贝时重新查页表
+        flags = acquireLockIrqsave(&p->lock);
+        int ok = copyToUser(satpMapping(p->satp), addr + done,
+                            (char *)accessVaViaPa(partial.frame) + partial.offset, partial.len);
+        releaseLockIrqrestore(&p->lock, flags);
+        deallocFrame(partial.frame);
+        if(ok) {
+            done += partial.len;
+        } else {
+            fault = 1;
+        }
+    }
+    return done == 0 && fault ? -EFAULT : done;
+}
@@ -0,0 +1,43 @@
+/****************************** 管道 **********************************
+ * Author：Joker001014
+ * 2025.03.30
+***********************************************************************/
+
+#ifndef _PIPE_H
+#define _PIPE_H
+
+#include "types.h"
+#include "spinlock.h"
+#include "condition.h"
+#include "file.h"
+
+#define PIPE_BUFFERS    16      // 管道的页缓冲区个数，必须是 2 的幂，管道最多容纳 16 页数据
+
+// 管道中的一页数据，页中 [offset, offset + len) 为尚未读取的部分
+typedef struct {
+    usize frame;        // 物理页地址
+    uint32 offset;
+    uint32 len;
+} PipeBuffer;
+
+// 管道：页缓冲区组成的环形队列
+// head、tail 只增不减，取模 PIPE_BUFFERS 得到下标，tail - head 为已使用的缓冲区个数
+typedef struct Pipe {
+    Spinlock lock;
+    PipeBuffer bufs[PIPE_BUFFERS];
+    usize head;         // 下一个读取的缓冲区
+    usize tail;         // 下一个写入的缓冲区
+    int readers;        // 打开的读端个数，为 0 时写入失败
+    int writers;        // 打开的写端个数，为 0 时读取到结束
+    Condvar readWait;   // 等待数据的读者
+    Condvar writeWait;  // 等待空闲缓冲区的写者
+} Pipe;
+
+int  newPipe(File **readEnd, File **writeEnd);
+void closePipe(Pipe *pipe, int writeEnd);
+long pipeRead(Pipe *pipe, char *buf, usize len);
+long pipeWrite(Pipe *pipe, char *buf, usize len);
+long pipeGift(Pipe *pipe, usize addr, usize len);
+long pipeMap(Pipe *pipe, usize addr, usize len);
+
+#endif
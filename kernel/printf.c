@@ -7,17 +7,43 @@
 #include <stdarg.h>     // 对于参数不定场景，使用 va_list 迭代遍历采参数
 #include "types.h"
 #include "def.h"
+#include "spinlock.h"
+#include "uart.h"
+#include "log.h"
+
+// 输出锁，保证通过 SBI 逐字符输出时每次的内容不会交错
+// panic 时关闭加锁，防止持有锁时 panic 造成死锁
+static struct {
+  Spinlock lock;
+  int locking;
+} pr = {.locking = 1};
+
+// printf 格式化的目标：正常时为日志记录的缓冲区，panic 时直接同步输出到串口
+typedef struct {
+  char *buf;
+  int n;
+  int cap;
+} Out;
+
+// 输出一个字符
+static void outc(Out *o, int c)
+{
+  if(o->buf == 0)
+    uartPutcSync(c);
+  else if(o->n < o->cap)
+    o->buf[o->n++] = c;
+}
 
 // 提供 16 进制数字字符的映射，供 printint 和 printptr 使用
 static char digits[] = "0123456789abcdef";
 
 /*
-    功能：将一个整数格式化为字符串，并输出到控制台
+    功能：将一个整数格式化为字符串，并输出到 o
     输入：xx：要打印的整数；
         base：数字的进制，支持 10（十进制）和 16（十六进制）；
         sign：是否为有符号整数（1 表示有符号，0 表示无符号）
 */
-static void printint(int xx, int base, int sign)
+static void printint(Out *o, int xx, int base, int sign)
 {
   char buf[16];
   int i;
@@ -40,50 +66,43 @@ static void printint(int xx, int base, int sign)
 
   // 从高位到低位输出
   while(--i >= 0)
-    consolePutchar(buf[i]); // 调用 SBI 接口向终端输出字符
+    outc(o, buf[i]);
 }
 
 /*
-    功能：将指针（64 位地址）格式化为十六进制字符串并输出
+    功能：将指针（64 位地址）格式化为十六进制字符串并输出到 o
     输入：x-要打印的指针地址
 */
-static void printptr(uint64 x)
+static void printptr(Out *o, uint64 x)
 {
   int i;
   // 添加 "0x" 前缀
-  consolePutchar('0');
-  consolePutchar('x');
+  outc(o, '0');
+  outc(o, 'x');
   for (i = 0; i < (sizeof(uint64) * 2); i++, x <<= 4)       // 每次处理 4 位
-    consolePutchar(digits[x >> (sizeof(uint64) * 8 - 4)]);  // 输出最高 4 位
+    outc(o, digits[x >> (sizeof(uint64) * 8 - 4)]);  // 输出最高 4 位
 }
 
 /*
-    功能：格式化输出到控制台，支持以下格式：
+    功能：按格式输出到 o，支持以下格式：
           %d：十进制整数。
           %x：十六进制整数。
           %p：指针。
           %s：字符串。
           %%：输出 % 本
-    输入：fmt-格式化字符串；可变参数列表（...）-对应的值
+    输入：fmt-格式化字符串；ap-对应的值
 */
-void printf(char *fmt, ...)
+static void vprintf(Out *o, char *fmt, va_list ap)
 {
-  va_list ap;
   int i, c;
   char *s;
 
-//   // 加锁保护
-//   locking = pr.locking;
-//   if(locking)
-//     acquire(&pr.lock);
-
   if (fmt == 0)
     panic("null fmt");
 
-  va_start(ap, fmt);
   for(i = 0; (c = fmt[i] & 0xff) != 0; i++){
     if(c != '%'){   // 非格式化符号，直接输出
-      consolePutchar(c);
+      outc(o, c);
       continue;
     }
     c = fmt[++i] & 0xff;  // 获取格式化符号
@@ -91,35 +110,113 @@ void printf(char *fmt, ...)
       break;
     switch(c){
     case 'd':   // 十进制整数
-      printint(va_arg(ap, int), 10, 1);
+      printint(o, va_arg(ap, int), 10, 1);
       break;
     case 'x':   // 十六进制整数
-      printint(va_arg(ap, int), 16, 1);
+      printint(o, va_arg(ap, int), 16, 1);
       break;
     case 'p':   // 指针
-      printptr(va_arg(ap, uint64));
+      printptr(o, va_arg(ap, uint64));
       break;
     case 's':   // 字符串
       if((s = va_arg(ap, char*)) == 0)
         s = "(null)";   // 空字符串处理
       for(; *s; s++)
-        consolePutchar(*s);
+        outc(o, *s);
       break;
     case '%':
-      consolePutchar('%');    // 输出 %
+      outc(o, '%');    // 输出 %
       break;
     default:
       // 未知格式化符号
-      consolePutchar('%');
-      consolePutchar(c);
+      outc(o, '%');
+      outc(o, c);
       break;
     }
   }
+}
+
+/*
+    功能：按 level 级别记录一条内核日志
+          正常时格式化到栈上的缓冲区后写入本 hart 的日志缓冲区，之后批量输出到控制台
+          panic 时先输出尚未输出的日志，再直接同步输出到串口
+    输入：level-日志级别（见 log.h）；fmt-格式化字符串；ap-对应的值
+*/
+static void vklog(int level, char *fmt, va_list ap)
+{
+  char buf[LOG_LINE_MAX];
+  Out o = {buf, 0, LOG_LINE_MAX};
+
+  if(!pr.locking){
+    flushLogSync();
+    o.buf = 0;
+    vprintf(&o, fmt, ap);
+    return;
+  }
+  vprintf(&o, fmt, ap);
+  appendLog(level, buf, o.n);
+}
+
+// 以 LOG_INFO 级别格式化输出，格式见 vprintf
+void printf(char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  vklog(LOG_INFO, fmt, ap);
   va_end(ap);
+}
 
-//   // 解锁
-//   if(locking)
-//     release(&pr.lock);
+// 以指定级别格式化输出，级别低于控制台级别的只记录在日志缓冲区中，可通过 dmesg 查看
+void klog(int level, char *fmt, ...)
+{
+  va_list ap;
+  va_start(ap, fmt);
+  vklog(level, fmt, ap);
+  va_end(ap);
+}
+
+/*
+    功能：向控制台输出一段字符，一次输出的内容不会与其他输出交错
+          串口驱动就绪后一次放入其发送缓冲区；之前若 SBI 支持调试控制台扩展，一次 ecall 输出整段
+          都不可用时通过 SBI 逐字符输出
+*/
+void consoleWrite(char *buf, usize len)
+{
+  usize i, flags;
+  long n;
+
+  if(!pr.locking){
+    for(i = 0; i < len; i++)
+      uartPutcSync(buf[i]);
+    return;
+  }
+  if(uartWrite(buf, len) == 0)
+    return;
+  flags = acquireLockIrqsave(&pr.lock);
+  while(len > 0 && (n = sbiDebugWrite(buf, len)) > 0){
+    buf += n;
+    len -= n;
+  }
+  for(i = 0; i < len; i++)
+    consolePutchar(buf[i]);
+  releaseLockIrqrestore(&pr.lock, flags);
+}
+
+/*
+    功能：在可以休眠的线程上下文（系统调用）中向控制台输出一段字符
+          串口发送缓冲区满时休眠等待发送中断，而不是关中断原地等待；驱动未就绪或 panic 后同 consoleWrite
+*/
+void consoleWriteSleep(char *buf, usize len)
+{
+  if(pr.locking && uartWriteSleep(buf, len) == 0)
+    return;
+  consoleWrite(buf, len);
+}
+
+// 初始化输出锁，登记其竞争统计
+void initPrintf()
+{
+  initLock(&pr.lock, "console");
 }
 
 /*
@@ -128,7 +225,8 @@ void printf(char *fmt, ...)
 */
 void panic(char *s)
 {
-//   pr.locking = 0;     // 禁用 `printf` 锁，防止死锁
+  pr.locking = 0;     // 禁用 `printf` 锁，防止死锁
+  extern void haltOtherHarts(); haltOtherHarts();   // 让其他 hart 停下，避免输出交错
   printf("panic: ");
   printf(s);          // 打印错误信息
   printf("\n");
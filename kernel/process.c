@@ -0,0 +1,198 @@
+/****************************** 进程管理 ********************************
+ * Author：Joker001014
+ * 2025.03.24
+ * 进程由其中的所有线程共享，线程持有进程的引用
+ * 每个用户线程占用进程中的一个槽位，槽位决定该线程用户栈的位置，并记录线程的退出码供 join 读取
+ * 最后一个线程退出并被回收后，销毁整个地址空间
+***********************************************************************/
+
+#include "types.h"
+#include "def.h"
+#include "consts.h"
+#include "thread.h"
+#include "mapping.h"
+#include "tlb.h"
+#include "uring.h"
+#include "file.h"
+#include "shm.h"
+
+// 创建一个进程，satp 为已经建立好的地址空间，0 号槽位留给主线程
+Process *
+newProcess(usize satp)
+{
+    Process *p = kalloc(sizeof(Process));
+    p->satp = satp;
+    p->cpumask = 0;
+    initLock(&p->lock, 0);
+    p->refs = 1;
+    int i;
+    for(i = 0; i < MAX_PROCESS_THREADS; i ++) {
+        p->slots[i].state = SLOT_FREE;
+        p->slots[i].tid = -1;
+        p->slots[i].exitCode = 0;
+    }
+    p->slots[0].state = SLOT_RUNNING;
+    initCondition(&p->joinWait);
+    p->ring = 0;
+    initStdio(p);
+    p->shm = 0;
+    return p;
+}
+
+// 增加进程的引用
+void
+getProcess(Process *process)
+{
+    __atomic_fetch_add(&process->refs, 1, __ATOMIC_RELAXED);
+}
+
+// 释放进程的引用，最后一个引用释放时销毁地址空间
+// 此时进程中的线程都已切换出去，不会有 hart 正在使用该页表
+void
+putProcess(Process *process)
+{
+    if(__atomic_sub_fetch(&process->refs, 1, __ATOMIC_ACQ_REL) != 0) {
+        return;
+    }
+    freeMapping(satpMapping(process->satp));
+    closeFiles(process);
+    detachAllShm(process);
+    if(process->ring != 0) {
+        putRing(process->ring);
+    }
+    kfree(process);
+}
+
+// 槽位 slot 对应的用户栈范围 [bottom, top)
+// 0 号槽位为主线程栈，其后每个槽位之间留一个不映射的保护页，栈溢出时触发缺页异常而不是破坏相邻的栈
+void
+userStackRange(int slot, usize *bottom, usize *top)
+{
+    if(slot == 0) {
+        *bottom = USER_STACK_OFFSET;
+        *top = USER_STACK_OFFSET + USER_STACK_SIZE;
+        return;
+    }
+    *bottom = USER_STACK_OFFSET + USER_STACK_SIZE + PAGE_SIZE
+            + (slot - 1) * (USER_THREAD_STACK_SIZE + PAGE_SIZE);
+    *top = *bottom + USER_THREAD_STACK_SIZE;
+}
+
+// 为新线程分配一个槽位并映射其用户栈，槽位已满返回 -1
+int
+allocStackSlot(Process *process)
+{
+    usize flags = acquireLockIrqsave(&process->lock);
+    int slot;
+    for(slot = 1; slot < MAX_PROCESS_THREADS; slot ++) {
+        if(process->slots[slot].state == SLOT_FREE) {
+            break;
+        }
+    }
+    if(slot == MAX_PROCESS_THREADS) {
+        releaseLockIrqrestore(&process->lock, flags);
+        return -1;
+    }
+    process->slots[slot].state = SLOT_RUNNING;
+    process->slots[slot].tid = -1;
+    // 同一进程的多个线程可能同时创建线程，页表的修改在进程锁下进行
+    Segment s;
+    userStackRange(slot, &s.startVaddr, &s.endVaddr);
+    s.flags = 1L | USER | READABLE | WRITABLE;
+    mapFramedSegment(satpMapping(process->satp), s);
+    releaseLockIrqrestore(&process->lock, flags);
+    return slot;
+}
+
+// 回收槽位 slot 的用户栈并释放槽位（需持有进程锁），调用者释放锁后刷新 TLB 之后才释放物理页
+static void
+freeStackSlot(Process *process, int slot, TlbBatch *batch)
+{
+    initTlbBatch(batch, process);
+    if(slot != 0) {
+        Segment s;
+        userStackRange(slot, &s.startVaddr, &s.endVaddr);
+        s.flags = 0;
+        unmapFramedSegment(satpMapping(process->satp), s, batch);
+    }
+    process->slots[slot].state = SLOT_FREE;
+    process->slots[slot].tid = -1;
+}
+
+// 释放 allocStackSlot 分配的、线程未能创建的槽位
+void
+releaseStackSlot(Process *process, int slot)
+{
+    TlbBatch batch;
+    usize flags = acquireLockIrqsave(&process->lock);
+    freeStackSlot(process, slot, &batch);
+    releaseLockIrqrestore(&process->lock, flags);
+    flushTlbBatch(&batch);
+}
+
+// 用户线程退出，记录退出码并唤醒等待它的 join 调用者
+// 进程引用在线程切换出去并被回收后才释放（见 reclaimThreadSlot）
+// 最后一个用户线程退出时通知轮询线程退出，否则它持有的进程引用使进程无法被销毁
+void
+exitUserThread(Thread *thread, usize code)
+{
+    Process *p = thread->process;
+    if(p == 0 || thread->ustackSlot < 0) {
+        return;
+    }
+    usize flags = acquireLockIrqsave(&p->lock);
+    UserThreadSlot *slot = &p->slots[thread->ustackSlot];
+    slot->state = SLOT_EXITED;
+    slot->exitCode = code;
+    notifyAllCondition(&p->joinWait);
+    int i, running = 0;
+    for(i = 0; i < MAX_PROCESS_THREADS; i ++) {
+        running |= p->slots[i].state == SLOT_RUNNING;
+    }
+    IoRing *ring = running ? 0 : p->ring;
+    releaseLockIrqrestore(&p->lock, flags);
+    if(ring != 0) {
+        stopRing(ring);
+    }
+}
+
+/*
+ * 等待同一进程中线程号为 id 的线程退出，回收其用户栈，返回其退出码
+ * id 不是本进程的其他线程，或已被其他线程 join 时返回 -EINVAL
+ */
+long
+joinThread(int id)
+{
+    Thread *self = getCurrentThread();
+    Process *p = self->process;
+    if(p == 0) {
+        return -EINVAL;
+    }
+    usize flags = acquireLockIrqsave(&p->lock);
+    int i;
+    for(i = 0; i < MAX_PROCESS_THREADS; i ++) {
+        if(p->slots[i].tid == id && p->slots[i].state != SLOT_FREE) {
+            break;
+        }
+    }
+    if(i == MAX_PROCESS_THREADS || i == self->ustackSlot) {
+        releaseLockIrqrestore(&p->lock, flags);
+        return -EINVAL;
+    }
+    UserThreadSlot *slot = &p->slots[i];
+    while(slot->state == SLOT_RUNNING) {
+        waitCondition(&p->joinWait, &p->lock);
+    }
+    if(slot->state != SLOT_EXITED || slot->tid != id) {
+        // 等待期间已被其他线程 join
+        releaseLockIrqrestore(&p->lock, flags);
+        return -EINVAL;
+    }
+    usize code = slot->exitCode;
+    slot->state = SLOT_JOINING;
+    TlbBatch batch;
+    freeStackSlot(p, i, &batch);
+    releaseLockIrqrestore(&p->lock, flags);
+    flushTlbBatch(&batch);
+    return (long)code;
+}
@@ -9,26 +9,105 @@
 #include "thread.h"
 #include "riscv.h"
 #include "fs.h"
+#include "sbi.h"
+#include "ipi.h"
+#include "tlb.h"
+#include "rcu.h"
+#include "edf.h"
+#include "vdso.h"
+#include "log.h"
+#include "fpu.h"
+#include "file.h"
+#include "ipc.h"
 
-// 全局唯一的 Processor 调度线程实例
-static Processor CPU;
+// 所有 hart 共享的线程池
+static ThreadPool POOL;
 
-// 对CPU（调度线程）初始化
+// 每个 hart 一个 Processor 调度线程实例，下标为 hartid
+static Processor CPUS[MAX_CPU];
+
+// 获取当前 hart 的 Processor
+static inline Processor *
+mycpu()
+{
+    return &CPUS[cpuid()];
+}
+
+// 当前线程停止运行时是否直接切换到下一个线程，为 0 时总是经过调度线程（用于对比测试）
+static int DIRECT_SWITCH = 1;
+
+static void switchFromCurrent(Processor *cpu);
+static void notifyRunnable(Processor *cpu);
+
+// 在 wfi 中空闲的 hart 位图，空闲 hart 没有周期 tick，不会自己去窃取其他 hart 的就绪线程
+static usize IDLE_HARTS;
+
+extern void updateTimer();
+extern int tickStopped(int hart);
+
+// 使用 idle 线程初始化当前 hart 的 Processor，并标记该 hart 参与调度
+static void
+initHartCPU(Thread idle)
+{
+    Processor *cpu = mycpu();
+    cpu->hartid = cpuid();
+    cpu->idle = idle;       // 调度线程
+    cpu->occupied = 0;      // 当前没有线程在运行
+    cpu->inbox = -1;        // 没有跨 hart 投递的线程
+    cpu->previous.tid = -1; // 没有等待收尾的线程
+    cpu->online = 1;
+}
+
+// 对CPU（调度线程）初始化，由启动 hart 调用
 // 使用 idle 线程和 pool 线程池来对 CPU 进行初始化
 // 参数 pool 主要就是为了指定这个 Processor 所使用的调度算法
 void
 initCPU(Thread idle, ThreadPool pool)
 {
-    CPU.idle = idle;    // 调度线程
-    CPU.pool = pool;    // 线程池
-    CPU.occupied = 0;   // 当前没有线程在运行
+    POOL = pool;        // 线程池
+    initLock(&POOL.lock, "pool");
+    initHartCPU(idle);
 }
 
-// 将线程添加到CPU管理的线程池中（对 addToPool() 进行包装）
+// 其他 hart 启动后初始化自己的 Processor，线程池沿用启动 hart 创建的
 void
+initSecondaryCPU(Thread idle)
+{
+    initHartCPU(idle);
+}
+
+// 通过 SBI HSM 扩展启动其他处于停止状态的 hart，它们从 entry.S 的 _secondary_start 开始执行
+void
+startHarts()
+{
+    if(!sbiProbeExtension(SBI_EXT_HSM)) {
+        return;
+    }
+    extern void _secondary_start();
+    int hart;
+    for(hart = 0; hart < MAX_CPU; hart ++) {
+        if(hart == cpuid()) continue;
+        if(hartGetStatus(hart) == SBI_HSM_STATE_STOPPED) {
+            // HSM 要求传入物理地址，此时目标 hart 尚未开启分页
+            hartStart(hart, (usize)_secondary_start - KERNEL_MAP_OFFSET, 0);
+        }
+    }
+}
+
+// 将线程添加到CPU管理的线程池中（对 addToPool() 进行包装），返回对外的线程号
+// 内核栈分配失败（kstack 为 0）或线程池已满时返回 -EAGAIN，线程的资源由调用者回收
+int
 addToCPU(Thread thread)
 {
-    addToPool(&CPU.pool, thread);
+    if(thread.kstack == 0) {
+        return -EAGAIN;
+    }
+    int id = addToPool(&POOL, thread);
+    if(id < 0) {
+        return id;
+    }
+    notifyRunnable(mycpu());
+    return id;
 }
 
 // 线程主动退出，通知 CPU 这个线程运行结束
@@ -38,16 +117,19 @@ void
 exitFromCPU(usize code)
 {
     disable_and_store();            // 关闭异步中断
-    int tid = CPU.current.tid;      // 当前运行线程tid
-    exitFromPool(&CPU.pool, tid);   // 清除线程池中占用标记，告诉调度算法线程已经结束
+    Processor *cpu = mycpu();
+    int tid = cpu->current.tid;     // 当前运行线程tid
+    exitUserThread(cpu->current.thread, code);  // 记录退出码，唤醒 join 该线程的线程
+    ipcThreadExit(tid);             // 注销作为 IPC 服务端的端口，必要时让等待的客户端返回
+    exitFromPool(&POOL, tid);       // 清除线程池中占用标记，告诉调度算法线程已经结束
 
     // 如果有线程在等待其退出，则将其唤醒
-    if(CPU.current.thread.wait != -1) {
-        wakeupCPU(CPU.current.thread.wait);
+    if(cpu->current.thread->wait != -1) {
+        wakeupCPU(cpu->current.thread->wait);
     }
 
     printf("Thread %d exited, exit code = %d\n", tid, code);
-    switchThread(&CPU.current.thread, &CPU.idle);   // 切换到调度器线程
+    switchFromCurrent(cpu);         // 切换到下一个线程，不会再回来
 }
 
 // 切换到 idle 线程，表示正式由 CPU 进行线程管理和调度，这个函数通常在启动线程中调用
@@ -63,33 +145,323 @@ runCPU()
     Thread boot;
     boot.contextAddr = 0;
     boot.kstack = 0;
+    boot.process = 0;
     boot.wait = -1;
-    switchThread(&boot, &CPU.idle); // 从启动线程切换进 idle，boot 线程信息丢失，不会再回来
+    boot.ustackSlot = -1;
+    boot.fp = 0;
+    switchThread(&boot, &mycpu()->idle);    // 从启动线程切换进 idle，boot 线程信息丢失，不会再回来
 }
 
-// 当前线程主动放弃 CPU，并进入休眠状态
+// 将当前线程标记为休眠，但仍继续运行，之后调用 yieldCPU() 才真正放弃 CPU
+// 两者之间到达的 wakeupCPU() 会撤销这次休眠，因此检查条件后、休眠前的唤醒不会丢失
+void
+prepareSleepCPU()
+{
+    Processor *cpu = mycpu();
+    if(cpu->occupied) {
+        usize flags = acquireLockIrqsave(&POOL.lock);
+        threadHot(&POOL, cpu->current.tid)->status = Sleeping;  // 睡眠
+        releaseLockIrqrestore(&POOL.lock, flags);
+    }
+}
+
+// 当前线程主动放弃 CPU，若仍处于休眠状态（期间没有被唤醒）则切换到调度线程
 void
 yieldCPU()
 {
-    if(CPU.occupied) {
+    Processor *cpu = mycpu();
+    if(rcuReading()) {
+        panic("Sleep inside rcu read section!\n");
+    }
+    if(cpu->occupied) {
         usize flags = disable_and_store();          // 关闭异步中断
 
-        int tid = CPU.current.tid;                      // 当前线程PID
-        ThreadInfo *ti = &CPU.pool.threads[tid];        // 从线程池获取该线程
-        ti->status = Sleeping;                          // 睡眠
-        switchThread(&CPU.current.thread, &CPU.idle);   // 切换到idle调度线程
+        int tid = cpu->current.tid;                     // 当前线程PID
+        ThreadHot *th = threadHot(&POOL, tid);          // 从线程池获取该线程
+        acquireLock(&POOL.lock);
+        int sleeping = th->status == Sleeping;
+        releaseLock(&POOL.lock);
+        if(sleeping) {
+            switchFromCurrent(cpu);                 // 切换到下一个线程
+        }
 
+        // 被唤醒后可能运行在另一个 hart 上，不能再使用 cpu
         restore_sstatus(flags);                     // 恢复中断
     }
 }
 
+// 当前线程主动让出 CPU 但保持可运行（sched_yield），实时线程同时表示本周期的作业已完成
+void
+schedYieldCPU()
+{
+    Processor *cpu = mycpu();
+    if(rcuReading()) {
+        panic("Yield inside rcu read section!\n");
+    }
+    if(cpu->occupied) {
+        usize flags = disable_and_store();
+        edfYield();
+        // 状态仍为 Running，切换出去后由 retrieveToPool 重新加入调度
+        switchFromCurrent(cpu);
+        restore_sstatus(flags);
+    }
+}
+
+/*
+ * 本 hart 的就绪队列中有线程在等待时，唤醒一个空闲 hart 来窃取
+ * 先清除其空闲位再发 IPI，多个 hart 同时发现时只有一个会唤醒它
+ */
+static void
+kickIdleHart(Processor *cpu)
+{
+    usize idle = __atomic_load_n(&IDLE_HARTS, __ATOMIC_ACQUIRE) & ~(1UL << cpu->hartid);
+    if(idle == 0 || !POOL.scheduler.needTick(cpu->hartid)) {
+        return;
+    }
+    int hart;
+    for(hart = 0; hart < MAX_CPU; hart ++) {
+        usize bit = 1UL << hart;
+        if((idle & bit) && (__atomic_fetch_and(&IDLE_HARTS, ~bit, __ATOMIC_ACQ_REL) & bit)) {
+            sendIPIMessage(hart, IPI_WAKEUP);
+            return;
+        }
+    }
+}
+
+// 本 hart 有线程加入就绪队列后调用：需要时重新开启周期 tick，并让空闲 hart 来分担
+static void
+notifyRunnable(Processor *cpu)
+{
+    usize flags = disable_and_store();
+    updateTimer();
+    kickIdleHart(cpu);
+    restore_sstatus(flags);
+}
+
+/*
+ * 本 hart 是否需要周期 tick，由 timer.c 在设置时钟中断时调用
+ * 有线程在运行且还有其他线程在本 hart 等待时需要 tick 来轮转时间片，RCU 也可能需要本 hart 经过静止状态
+ * 空闲或只有一个可运行线程时不需要
+ */
+int
+needTickCPU()
+{
+    Processor *cpu = mycpu();
+    if(rcuNeedsTick()) {
+        return 1;
+    }
+    if(logPending()) {
+        return 1;       // 其他 hart 正在输出时本次没能输出，稍后再试
+    }
+    if(!cpu->occupied) {
+        return 0;
+    }
+    return __atomic_load_n(&cpu->inbox, __ATOMIC_RELAXED) != -1 || POOL.scheduler.needTick(cpu->hartid);
+}
+
+// 将被唤醒的线程加入本 hart 的线程调度，调度算法据此区分唤醒和时间片用完后的重新入队
+static void
+wakeToScheduler(int tid)
+{
+    if(POOL.scheduler.wake != 0) {
+        POOL.scheduler.wake(tid);
+    } else {
+        POOL.scheduler.push(tid);
+    }
+}
+
+/*
+ * 将线程压入目标 hart 的 inbox
+ * inbox 是以 ThreadHot.wakeNext 串起来的无锁栈，多个 hart 可以同时压入，只有目标 hart 自己取出
+ */
+static void
+pushInbox(Processor *target, int tid)
+{
+    int old = __atomic_load_n(&target->inbox, __ATOMIC_RELAXED);
+    do {
+        threadHot(&POOL, tid)->wakeNext = old;
+    } while(!__atomic_compare_exchange_n(&target->inbox, &old, tid, 0,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/*
+ * 取出当前 hart inbox 中的全部线程并加入本 hart 的就绪队列
+ * 调用时需关闭异步中断
+ */
+static void
+drainInbox(Processor *cpu)
+{
+    int head = __atomic_exchange_n(&cpu->inbox, -1, __ATOMIC_ACQUIRE);
+    // 栈中线程顺序与唤醒顺序相反，先反转链表以保持先唤醒先运行
+    int prev = -1;
+    while(head != -1) {
+        int next = threadHot(&POOL, head)->wakeNext;
+        threadHot(&POOL, head)->wakeNext = prev;
+        prev = head;
+        head = next;
+    }
+    if(prev == -1) {
+        return;
+    }
+    while(prev != -1) {
+        int next = threadHot(&POOL, prev)->wakeNext;
+        wakeToScheduler(prev);
+        cpu->stats.remoteWakeups += 1;
+        prev = next;
+    }
+    notifyRunnable(cpu);
+}
+
 // 将某个线程唤醒，将其参与调度
+// 线程优先回到上次运行的 hart：本 hart 直接入队，其他 hart 则投递到其 inbox，若目标空闲再用 IPI 唤醒
 void
 wakeupCPU(int tid)
 {
-    ThreadInfo *ti = &CPU.pool.threads[tid];    // 获取线程
-    ti->status = Ready;                         // 唤醒
-    schedulerPush(tid);                         // 加入线程调度
+    usize flags = disable_and_store();
+    acquireLock(&POOL.lock);
+    ThreadHot *th = threadHot(&POOL, tid);  // 获取线程
+    if(th->status != Sleeping) {
+        // 已经被唤醒或已经退出
+        releaseLock(&POOL.lock);
+        restore_sstatus(flags);
+        return;
+    }
+    if(th->running) {
+        // 线程已标记休眠但还没切换出去：撤销休眠，yieldCPU 不再切换，
+        // 或者切换回 idle 后由 retrieveToPool 重新加入调度
+        th->status = Running;
+        releaseLock(&POOL.lock);
+        restore_sstatus(flags);
+        return;
+    }
+    th->status = Ready;                     // 唤醒，由 Sleeping 改为 Ready 的一方负责入队
+    int target = th->hart;
+    releaseLock(&POOL.lock);
+    if(target == cpuid() || !CPUS[target].online) {
+        wakeToScheduler(tid);               // 加入本 hart 的线程调度，只持有本 hart 的队列锁
+        restore_sstatus(flags);
+        notifyRunnable(mycpu());
+        return;
+    }
+    pushInbox(&CPUS[target], tid);
+    restore_sstatus(flags);
+    // 目标 hart 正在运行线程且有周期 tick 时，会在下一次时钟中断时取出 inbox，无需打扰
+    if(!__atomic_load_n(&CPUS[target].occupied, __ATOMIC_ACQUIRE) || tickStopped(target)) {
+        sendIPIMessage(target, IPI_WAKEUP);
+    }
+}
+
+/*
+ * 线程切换完成后的收尾，在切换到的线程中执行（关中断）
+ * 上一个线程的上下文此时已经保存，可以重新加入调度或回收，同一进程的线程之间不必清除地址空间登记
+ * 新线程第一次运行时也会经过这里（见 interrupt.S 中的 __threadStart）
+ * 用户线程每次恢复运行都经过这里，需要时重新加载它的浮点寄存器
+ */
+void
+finishSwitchCPU()
+{
+    Processor *cpu = mycpu();
+    fpSwitchIn(cpu->current.thread);
+    if(cpu->previous.tid == -1) {
+        return;     // 从调度线程切换过来，由调度线程负责收尾
+    }
+    RunningThread prev = cpu->previous;
+    cpu->previous.tid = -1;
+    if(prev.thread->process != cpu->current.thread->process) {
+        deactivateAddressSpace(prev.thread->process);
+    }
+    retrieveToPool(&POOL, prev);
+    notifyRunnable(cpu);
+}
+
+// 从当前线程直接切换到 next，上一个线程记入 previous，由 finishSwitchCPU 收尾（关中断）
+static void
+switchToThread(Processor *cpu, RunningThread next)
+{
+    cpu->previous = cpu->current;
+    cpu->current = next;
+    vdsoSwitch(cpu->hartid, THREAD_ID(threadHot(&POOL, next.tid)->generation, next.tid));
+    activateAddressSpace(next.thread->process);
+    switchThread(cpu->previous.thread, cpu->current.thread);
+}
+
+/*
+ * 当前线程停止运行（时间片用完、休眠、让出或退出）时调用，需关闭异步中断
+ * 由当前线程直接选出下一个线程并切换过去，只需一次上下文切换；没有其他可运行线程时才切换到调度线程
+ * 当前线程不在读临界区中，切换点也是 RCU 静止状态
+ * 返回时当前线程已被重新调度，可能运行在另一个 hart 上
+ */
+static void
+switchFromCurrent(Processor *cpu)
+{
+    RunningThread next;
+    next.tid = -1;
+    fpSwitchOut(cpu->current.thread);   // 用户态改写过浮点寄存器时才保存
+    if(DIRECT_SWITCH) {
+        rcuQuiescent();
+        drainInbox(cpu);
+        next = acquireFromPool(&POOL);
+    }
+    if(next.tid == -1) {
+        switchThread(cpu->current.thread, &cpu->idle);
+    } else {
+        cpu->stats.directSwitches += 1;
+        switchToThread(cpu, next);
+    }
+    finishSwitchCPU();
+}
+
+/*
+ * 当前线程进入休眠，并把 CPU 直接交给休眠中的线程 tid，不经过就绪队列和调度器
+ * 调用前当前线程需已 prepareSleepCPU()，用于同步 IPC 中发送者直接切换到等待中的接收者
+ * 调度器仍把当前线程视为正在运行，tid 使用当前线程剩余的时间片（实时线程为剩余预算）
+ * 当前线程在此期间已被唤醒，或 tid 不是已切换出去的休眠线程时，退化为普通的唤醒和让出
+ */
+void
+handoffCPU(int tid)
+{
+    Processor *cpu = mycpu();
+    if(rcuReading()) {
+        panic("Sleep inside rcu read section!\n");
+    }
+    if(!cpu->occupied) {
+        wakeupCPU(tid);
+        return;
+    }
+    usize flags = disable_and_store();
+    acquireLock(&POOL.lock);
+    ThreadHot *self = threadHot(&POOL, cpu->current.tid);
+    ThreadHot *th = threadHot(&POOL, tid);
+    if(self->status != Sleeping || th->status != Sleeping || th->running) {
+        releaseLock(&POOL.lock);
+        restore_sstatus(flags);
+        wakeupCPU(tid);
+        yieldCPU();
+        return;
+    }
+    th->status = Running;
+    th->hart = cpuid();
+    th->running = 1;
+    releaseLock(&POOL.lock);
+    RunningThread next;
+    next.tid = tid;
+    next.thread = &threadInfo(&POOL, tid)->thread;
+    fpSwitchOut(cpu->current.thread);
+    rcuQuiescent();
+    cpu->stats.handoffs += 1;
+    switchToThread(cpu, next);
+    finishSwitchCPU();
+    // 被重新唤醒后可能运行在另一个 hart 上，不能再使用 cpu
+    restore_sstatus(flags);
+}
+
+// 收到其他 hart 发来的唤醒消息，取出 inbox 中被唤醒的线程
+// 实时线程被直接放入本 hart 的就绪队列、或 RCU 需要本 hart 经过静止状态时也会收到，需要时重新开启周期 tick
+void
+ipiCPU()
+{
+    drainInbox(mycpu());
+    updateTimer();
 }
 
 // 线程调度的入口点函数，是调度线程最核心的函数
@@ -98,26 +470,49 @@ idleMain()
 {
     // 进入 idle 时禁用异步中断
     disable_and_store();
+    // 每个 hart 有自己的 idle 线程，idle 不会迁移，cpu 始终有效
+    Processor *cpu = mycpu();
     while(1) {
-        // 向线程池获取一个可以运行的线程
-        RunningThread rt = acquireFromPool(&CPU.pool);
+        // 回到 idle 说明本 hart 上的读临界区都已结束，报告 RCU 静止状态
+        rcuQuiescent();
+        // 先接收其他 hart 投递过来的线程
+        drainInbox(cpu);
+        // 向线程池获取一个可以运行的线程（本 hart 队列为空时调度器会从其他 hart 窃取）
+        RunningThread rt = acquireFromPool(&POOL);
         if(rt.tid != -1) {
             // 有线程可以运行
-            CPU.current = rt;       // 设置调度器当前线程
-            CPU.occupied = 1;       // 标志线程正在运行
-            // printf("\n>>>> will switch_to thread %d in idle_main!\n", CPU.current.tid);
+            cpu->current = rt;      // 设置调度器当前线程
+            __atomic_store_n(&cpu->occupied, 1, __ATOMIC_RELEASE);  // 标志线程正在运行
+            // printf("\n>>>> will switch_to thread %d in idle_main!\n", cpu->current.tid);
+            // 登记本 hart 正在使用该线程的地址空间，修改其页表时需要刷新本 hart 的 TLB
+            activateAddressSpace(cpu->current.thread->process);
+            vdsoSwitch(cpu->hartid, THREAD_ID(threadHot(&POOL, rt.tid)->generation, rt.tid));
+            // 还有其他线程等待时开启周期 tick
+            notifyRunnable(cpu);
             // 从调度器线程 切换到 当前线程
-            switchThread(&CPU.idle, &CPU.current.thread);  
+            switchThread(&cpu->idle, cpu->current.thread);
+            deactivateAddressSpace(cpu->current.thread->process);
+            VDSO->hart[cpu->hartid].tid = -1;
 
             // 切换回 idle 线程处
             // printf("<<<< switch_back to idle in idle_main!\n");
-            CPU.occupied = 0;       // 标记当前没有线程正在运行
+            __atomic_store_n(&cpu->occupied, 0, __ATOMIC_RELEASE);  // 标记当前没有线程正在运行
             // 修改线程池内的线程信息：在一个线程停止运行，切换回调度线程后调用
-            retrieveToPool(&CPU.pool, CPU.current);
+            retrieveToPool(&POOL, cpu->current);
         } else {
-            // 无可运行线程，短暂开启异步中断并处理
+            // 无可运行线程，停止周期 tick，短暂开启异步中断并处理
+            // 只为最早的定时事件设置时钟中断，有线程到来时其他 hart 用 IPI 唤醒本 hart
+            usize bit = 1UL << cpu->hartid;
+            cpu->stats.idleWaits += 1;
+            VDSO->hart[cpu->hartid].idleWaits += 1;
+            flushLog();     // 空闲时输出积累的内核日志
+            rcuEnterIdle();
+            __atomic_fetch_or(&IDLE_HARTS, bit, __ATOMIC_RELEASE);
+            updateTimer();
             enable_and_wfi();
             disable_and_store();
+            __atomic_fetch_and(&IDLE_HARTS, ~bit, __ATOMIC_RELEASE);
+            rcuExitIdle();
         }
     }
 }
@@ -127,14 +522,23 @@ idleMain()
 void
 tickCPU()
 {
+    Processor *cpu = mycpu();
     // 判断当前是否有正在运行线程（不是 idle）
-    if(CPU.occupied) {
-        // 当前线程运行时间片是否耗尽
-        if(tickPool(&CPU.pool)) {
+    if(cpu->occupied) {
+        // 没有处于读临界区，本 hart 此刻就是静止状态，运行单个线程、不发生切换时宽限期也能结束
+        // 时钟中断只在开中断时到达，被打断的代码没有持有自旋锁，可以在这里执行已到期的回调
+        if(!rcuReading()) {
+            rcuNoteQuiescent();
+            rcuProcessCallbacks();
+        }
+        // 接收其他 hart 在本 hart 忙碌时投递的线程
+        drainInbox(cpu);
+        // 当前线程运行时间片是否耗尽，处于 RCU 读临界区时不能切换
+        if(tickPool(&POOL) && !rcuReading()) {
             // 关闭中断
             usize flags = disable_and_store();
-            // 切换到 idle 调度器线程
-            switchThread(&CPU.current.thread, &CPU.idle);
+            // 切换到下一个线程
+            switchFromCurrent(cpu);
 
             // 某个时刻再切回此线程时从这里开始
             restore_sstatus(flags);
@@ -145,11 +549,12 @@ tickCPU()
 /*
  * 执行一个用户进程
  * path 为可执行文件在文件系统的路径, hostTid 为需要暂停的线程的 tid
+ * in、out 不为 0 时作为新进程的标准输入、标准输出，执行成功时由新进程接管其引用
  */
 int
-executeCPU(char *path, int hostTid)
+executeCPU(char *path, int hostTid, File *in, File *out)
 {
-    Inode *res = lookup(0, path);   // 查找文件inode
+    Inode *res = lookupPath(path);  // 查找文件inode（经过路径缓存）
     if(res == 0) {
         printf("Command not found!\n");
         return 0;
@@ -157,24 +562,210 @@ executeCPU(char *path, int hostTid)
     char *buf = kalloc(res->size);  // 分配内存
     readall(res, buf);              // 读取文件所有数据到buf
     Thread t = newUserThread(buf);  // 创建新的用户线程
-    t.wait = hostTid;               // 记录等待其退出的进程tid
     kfree(buf);                     // 释放内存
-    addToCPU(t);                    // 添加到线程池中
+    if(t.kstack == 0) {
+        printf("Too many threads!\n");
+        return 0;
+    }
+    t.wait = hostTid;               // 记录等待其退出的进程tid
+    redirectStdio(t.process, in, out);
+    if(addToCPU(t) < 0) {           // 添加到线程池中
+        // 线程池已满：in、out 的引用交还调用者，再销毁新进程
+        if(in != 0) t.process->files[0] = 0;
+        if(out != 0) t.process->files[1] = 0;
+        freeKernelStack(t.kstack);
+        putProcess(t.process);
+        printf("Too many threads!\n");
+        return 0;
+    }
     return 1;
 }
 
+/*
+ * 在当前进程中创建一个新线程，共享当前线程的地址空间
+ * 新线程从 entry 开始执行，a0 为 arg，tp 为 tls，返回新线程的线程号
+ */
+long
+cloneCPU(usize entry, usize arg, usize tls)
+{
+    Process *p = getCurrentThread()->process;
+    if(p == 0) {
+        return -EINVAL;
+    }
+    int slot = allocStackSlot(p);
+    if(slot == -1) {
+        return -EAGAIN;     // 进程的线程数已达上限
+    }
+    getProcess(p);          // 新线程持有进程引用
+    Thread t = newCloneThread(p, slot, entry, arg, tls);
+    int id = addToCPU(t);
+    if(id < 0) {
+        // 内核栈或线程池耗尽，撤销已分配的资源
+        freeKernelStack(t.kstack);
+        releaseStackSlot(p, slot);
+        putProcess(p);
+    }
+    return id;
+}
+
+// 将对外的线程号转换为线程表下标（需持有线程池锁），线程已退出或线程号已过期时返回 -1
+static int
+lookupThreadId(int id)
+{
+    int tid = THREAD_INDEX(id);
+    if(id < 0 || tid >= POOL.chunks * THREAD_CHUNK) {
+        return -1;
+    }
+    ThreadHot *th = threadHot(&POOL, tid);
+    if(!th->occupied || th->status == Exited || THREAD_ID(th->generation, tid) != id) {
+        return -1;
+    }
+    return tid;
+}
+
+// 将对外的线程号转换为线程表下标，无效时返回 -1
+int
+resolveThreadId(int id)
+{
+    usize flags = acquireLockIrqsave(&POOL.lock);
+    int tid = lookupThreadId(id);
+    releaseLockIrqrestore(&POOL.lock, flags);
+    return tid;
+}
+
+// 设置线程号为 id 的线程的 nice 值，id 为 -1 时设置当前线程
+// 线程号无效或当前调度算法不支持优先级时返回 -EINVAL
+long
+setPriorityCPU(int id, int nice)
+{
+    if(POOL.scheduler.setPriority == 0) {
+        return -EINVAL;
+    }
+    usize flags = acquireLockIrqsave(&POOL.lock);
+    int tid = id == -1 ? getCurrentTid() : lookupThreadId(id);
+    long ret = -EINVAL;
+    if(tid != -1) {
+        ret = POOL.scheduler.setPriority(tid, nice);
+    }
+    releaseLockIrqrestore(&POOL.lock, flags);
+    return ret;
+}
+
 // 获取当前正在运行的线程TID
 int
 getCurrentTid()
 {
-    return CPU.current.tid;
+    return mycpu()->current.tid;
+}
+
+// 获取当前正在运行的线程对外的线程号
+int
+getCurrentThreadId()
+{
+    int tid = getCurrentTid();
+    return THREAD_ID(threadHot(&POOL, tid)->generation, tid);
 }
 
 // 获取当前正在运行的线程
 Thread
 *getCurrentThread()
 {
-    return &CPU.current.thread;
+    return mycpu()->current.thread;
 }
 
+// 获取某个 hart 的负载均衡统计
+LoadStats *
+getLoadStats(int hart)
+{
+    return &CPUS[hart].stats;
+}
 
+// 某个 hart 是否已经启动并参与调度
+int
+isHartOnline(int hart)
+{
+    return CPUS[hart].online;
+}
+
+#define BENCH_ROUNDS    10000
+static volatile int BENCH_PARTNER_DONE;
+
+// 基准的伙伴线程，与主线程轮流让出 CPU
+static void
+benchPartner()
+{
+    int i;
+    for(i = 0; i < BENCH_ROUNDS; i ++) {
+        schedYieldCPU();
+    }
+    __atomic_store_n(&BENCH_PARTNER_DONE, 1, __ATOMIC_RELEASE);
+    exitFromCPU(0);
+}
+
+/*
+ * 上下文切换微基准，作为内核线程运行，启动时由 make qemu BENCH=ctxswitch 选择
+ * 两个线程轮流让出 CPU，测量一次往返（A->B->A）的平均时间
+ * 分别测量经过调度线程和直接切换两种方式，前者每次往返切换四次，后者两次
+ * 需在单个 hart 上运行（CPUS=1），否则两个线程可能被分到不同 hart
+ */
+void
+benchContextSwitch()
+{
+    usize cost[2];
+    int direct, i;
+    for(direct = 0; direct < 2; direct ++) {
+        DIRECT_SWITCH = direct;
+        BENCH_PARTNER_DONE = 0;
+        addToCPU(newKernelThread((usize)benchPartner));
+        schedYieldCPU();        // 让伙伴线程先运行起来
+        usize start = r_time();
+        for(i = 0; i < BENCH_ROUNDS; i ++) {
+            schedYieldCPU();
+        }
+        cost[direct] = r_time() - start;
+        while(!__atomic_load_n(&BENCH_PARTNER_DONE, __ATOMIC_ACQUIRE)) {
+            schedYieldCPU();
+        }
+    }
+    DIRECT_SWITCH = 1;
+    // time 计数换算为纳秒
+    printf("context switch round trip: via idle %d ns, direct %d ns\n",
+            (int)(cost[0] * (1000000000 / TIMEBASE_FREQ) / BENCH_ROUNDS),
+            (int)(cost[1] * (1000000000 / TIMEBASE_FREQ) / BENCH_ROUNDS));
+    exitFromCPU(0);
+}
+
+// 输出每个 hart 的负载均衡统计
+void
+printLoadStats()
+{
+    int hart;
+    for(hart = 0; hart < MAX_CPU; hart ++) {
+        if(!CPUS[hart].online) continue;
+        LoadStats *st = &CPUS[hart].stats;
+        printf("hart %d: enqueued %d, dispatched %d, stolen %d, donated %d, remote wakeups %d, ipi sent %d / received %d, idle waits %d, direct switches %d, handoffs %d\n",
+                hart, (int)st->enqueued, (int)st->dispatched, (int)st->stolen, (int)st->donated,
+                (int)st->remoteWakeups, (int)st->ipiSent, (int)st->ipiReceived, (int)st->idleWaits,
+                (int)st->directSwitches, (int)st->handoffs);
+    }
+}
+
+// 打印线程表，不获取线程池锁
+// 在 RCU 读临界区内，已退出线程的槽位不会被释放和复用，读到的线程信息不会与新线程混淆
+void
+printThreads()
+{
+    static char *STATUS_NAME[] = {"Ready", "Running", "Sleeping", "Exited"};
+    rcuReadLock();
+    // 线程表只增长不收缩，按读到的块数遍历即可
+    int chunks = __atomic_load_n(&POOL.chunks, __ATOMIC_ACQUIRE);
+    int tid;
+    for(tid = 0; tid < chunks * THREAD_CHUNK; tid ++) {
+        ThreadHot *th = threadHot(&POOL, tid);
+        if(!__atomic_load_n(&th->occupied, __ATOMIC_ACQUIRE)) continue;
+        printf("tid %d (id %d): %s, hart %d, wait %d\n",
+                tid, THREAD_ID(th->generation, tid), STATUS_NAME[th->status], th->hart,
+                threadInfo(&POOL, tid)->thread.wait);
+    }
+    rcuReadUnlock();
+}
@@ -43,6 +43,35 @@ popFront(Queue *q)
     return ret;
 }
 
+// 删除队列中第一个值为 data 的节点
+// 返回：1-找到并删除，0-队列中没有该值
+int
+removeItem(Queue *q, usize data)
+{
+    Node *prev = 0, *n = q->head;
+    while(n != 0) {
+        if(n->item == data) {
+            if(prev == 0) {
+                q->head = n->next;
+            } else {
+                prev->next = n->next;
+            }
+            if(q->tail == n) {
+                q->tail = prev;
+            }
+            if(q->head == 0) {
+                q->tail = 0;
+            }
+            kfree(n);
+            return 1;
+        }
+        if(n == q->tail) break;
+        prev = n;
+        n = n->next;
+    }
+    return 0;
+}
+
 // 判断队列是否为空
 // 返回：1-空，0-不为空
 int
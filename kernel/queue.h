@@ -23,5 +23,6 @@ typedef struct {
 void pushBack(Queue *q, usize data);
 usize popFront(Queue *q);
 int isEmpty(Queue *q);
+int removeItem(Queue *q, usize data);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,203 @@
+/****************************** RCU ************************************
+ * Author：Joker001014
+ * 2025.03.22
+ * 读临界区内不允许切换线程：时钟中断不会抢占处于读临界区的线程，读者也不能休眠
+ * 因此一个 hart 回到 idleMain 时，它之前开始的读临界区必然都已结束，这就是一次静止状态
+ * 宽限期用递增的编号表示，hart 在静止状态时记录看到的最新编号，
+ * 所有在线 hart 记录的编号都不小于 n 时，第 n 个宽限期结束，之前推迟的回调可以执行
+ * 空闲 hart 停止了周期 tick，在 wfi 期间处于扩展静止状态，宽限期不等待它们
+***********************************************************************/
+
+#include "types.h"
+#include "def.h"
+#include "consts.h"
+#include "riscv.h"
+#include "thread.h"
+#include "rcu.h"
+#include "ipi.h"
+
+// 每个 hart 的 RCU 状态
+typedef struct {
+    int nesting;            // 读临界区嵌套深度，大于 0 时不能切换线程
+    usize seen;             // 最近一次静止状态时看到的宽限期编号
+    RcuHead *pending;       // 新提交、还没有分配宽限期的回调
+    RcuHead *waiting;       // 等待宽限期 waitSeq 结束的回调
+    usize waitSeq;
+    int idle;               // 是否处于空闲（扩展静止状态）
+} RcuHart;
+
+static RcuHart HARTS[MAX_CPU];
+static usize GP_STARTED;        // 已开始的最新宽限期编号
+static usize GP_COUNT;          // 等到宽限期结束后执行的回调批次数（统计）
+static usize CALLBACKS;         // 已执行的回调数（统计）
+
+// 进入读临界区，可以嵌套
+// 关中断保证读到的 hartid 与增加的计数器属于同一个 hart
+void
+rcuReadLock()
+{
+    usize flags = disable_and_store();
+    HARTS[cpuid()].nesting += 1;
+    restore_sstatus(flags);
+}
+
+// 离开读临界区
+void
+rcuReadUnlock()
+{
+    usize flags = disable_and_store();
+    HARTS[cpuid()].nesting -= 1;
+    restore_sstatus(flags);
+}
+
+// 当前 hart 是否处于读临界区
+int
+rcuReading()
+{
+    return HARTS[cpuid()].nesting > 0;
+}
+
+// 第 seq 个宽限期是否已经结束
+static int
+gpCompleted(usize seq)
+{
+    int hart;
+    for(hart = 0; hart < MAX_CPU; hart ++) {
+        if(!isHartOnline(hart) || __atomic_load_n(&HARTS[hart].idle, __ATOMIC_ACQUIRE)) continue;
+        if(__atomic_load_n(&HARTS[hart].seen, __ATOMIC_ACQUIRE) < seq) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// 开始一个新的宽限期，返回其编号，调用者所在 hart 此时处于静止状态
+// 停止了周期 tick 的忙碌 hart 不会自己经过静止状态，用 IPI 让它们重新开启 tick
+static usize
+startGracePeriod()
+{
+    usize seq = __atomic_add_fetch(&GP_STARTED, 1, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&HARTS[cpuid()].seen, seq, __ATOMIC_RELEASE);
+    extern int tickStopped(int hart);
+    int hart;
+    for(hart = 0; hart < MAX_CPU; hart ++) {
+        if(hart == cpuid() || !isHartOnline(hart) || HARTS[hart].idle) continue;
+        if(tickStopped(hart)) {
+            sendIPIMessage(hart, IPI_WAKEUP);
+        }
+    }
+    return seq;
+}
+
+// 提交一个回调，在当前所有读者都离开读临界区后由本 hart 执行
+void
+callRcu(RcuHead *head, void (*func)(RcuHead *))
+{
+    head->func = func;
+    usize flags = disable_and_store();
+    RcuHart *r = &HARTS[cpuid()];
+    head->next = r->pending;
+    r->pending = head;
+    restore_sstatus(flags);
+}
+
+/*
+ * 执行本 hart 宽限期已结束的回调，并为新提交的回调开始一个宽限期（关中断，不在读临界区）
+ * 由 rcuQuiescent 和时钟中断调用，只运行一个长线程、很少切换的 hart 上的回调也能及时执行
+ */
+void
+rcuProcessCallbacks()
+{
+    RcuHart *r = &HARTS[cpuid()];
+    if(r->waiting != 0 && gpCompleted(r->waitSeq)) {
+        RcuHead *head = r->waiting;
+        r->waiting = 0;
+        __atomic_fetch_add(&GP_COUNT, 1, __ATOMIC_RELAXED);
+        while(head != 0) {
+            RcuHead *next = head->next;
+            head->func(head);
+            CALLBACKS += 1;
+            head = next;
+        }
+    }
+    if(r->waiting == 0 && r->pending != 0) {
+        r->waiting = r->pending;
+        r->pending = 0;
+        r->waitSeq = startGracePeriod();
+    }
+}
+
+/*
+ * 报告当前 hart 处于静止状态，由 idleMain 在每次调度前调用（关中断）
+ * 执行宽限期已结束的回调，并为新提交的回调开始一个宽限期
+ */
+void
+rcuQuiescent()
+{
+    RcuHart *r = &HARTS[cpuid()];
+    if(r->nesting != 0) {
+        panic("Quiescent state inside rcu read section!\n");
+    }
+    // 之前的读操作必须先于 seen 的更新完成
+    __sync_synchronize();
+    __atomic_store_n(&r->seen, __atomic_load_n(&GP_STARTED, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    rcuProcessCallbacks();
+}
+
+// 只报告静止状态，不执行回调，由时钟中断在不处于读临界区时调用
+void
+rcuNoteQuiescent()
+{
+    __sync_synchronize();
+    __atomic_store_n(&HARTS[cpuid()].seen, __atomic_load_n(&GP_STARTED, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+}
+
+// 空闲 hart 进入 wfi 前调用，之后的宽限期不再等待它
+void
+rcuEnterIdle()
+{
+    __atomic_store_n(&HARTS[cpuid()].idle, 1, __ATOMIC_RELEASE);
+}
+
+// 离开 wfi 后调用，空闲期间本 hart 没有读者，直接记录最新的宽限期编号
+void
+rcuExitIdle()
+{
+    RcuHart *r = &HARTS[cpuid()];
+    __atomic_store_n(&r->idle, 0, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&r->seen, __atomic_load_n(&GP_STARTED, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+}
+
+// 本 hart 是否需要周期 tick：有回调等待执行，或有宽限期在等待本 hart 的静止状态
+int
+rcuNeedsTick()
+{
+    RcuHart *r = &HARTS[cpuid()];
+    if(r->pending != 0 || r->waiting != 0) {
+        return 1;
+    }
+    return !r->idle && __atomic_load_n(&r->seen, __ATOMIC_ACQUIRE) < __atomic_load_n(&GP_STARTED, __ATOMIC_ACQUIRE);
+}
+
+// 等待当前所有读者离开读临界区，只能在线程中且不在读临界区时调用
+void
+synchronizeRcu()
+{
+    if(rcuReading()) {
+        panic("synchronizeRcu inside rcu read section!\n");
+    }
+    usize flags = disable_and_store();
+    usize seq = startGracePeriod();
+    restore_sstatus(flags);
+    // 其他 hart 会在时钟中断切换线程或空闲时经过静止状态
+    while(!gpCompleted(seq)) {
+        asm volatile("nop");
+    }
+}
+
+// 打印 RCU 统计
+void
+printRcuStats()
+{
+    printf("rcu: grace periods %d, callbacks %d\n", GP_COUNT, CALLBACKS);
+}
@@ -0,0 +1,40 @@
+/****************************** RCU ************************************
+ * Author：Joker001014
+ * 2025.03.22
+ * 基于静止状态（quiescent state）的 RCU，用于读多写少的内核表
+ * 读者只需标记读临界区，写者发布新版本后把旧版本的释放推迟到所有 hart 都经过一次静止状态之后
+***********************************************************************/
+
+#ifndef _RCU_H
+#define _RCU_H
+
+#include "types.h"
+
+// 推迟执行的回调，嵌入在需要推迟释放的结构体中
+typedef struct rcuhead {
+    struct rcuhead *next;
+    void (*func)(struct rcuhead *);
+} RcuHead;
+
+// 由嵌入的成员地址得到外层结构体地址
+#define CONTAINER_OF(ptr, type, member) \
+    ((type *)((char *)(ptr) - __builtin_offsetof(type, member)))
+
+// 读取/发布一个受 RCU 保护的指针
+#define RCU_DEREFERENCE(p)      __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+#define RCU_ASSIGN_POINTER(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+void rcuReadLock();
+void rcuReadUnlock();
+int  rcuReading();
+void callRcu(RcuHead *head, void (*func)(RcuHead *));
+void synchronizeRcu();
+void rcuQuiescent();
+void rcuNoteQuiescent();
+void rcuProcessCallbacks();
+void rcuEnterIdle();
+void rcuExitIdle();
+int  rcuNeedsTick();
+void printRcuStats();
+
+#endif
@@ -41,6 +41,15 @@ w_stvec(usize x)
     asm volatile("csrw stvec, %0" : : "r"(x));
 }
 
+// 读 stvec
+static inline usize
+r_stvec()
+{
+    usize x;
+    asm volatile("csrr %0, stvec" : "=r"(x));
+    return x;
+}
+
 // 读 sepc，中断返回地址
 static inline usize
 r_sepc()
@@ -53,6 +62,7 @@ r_sepc()
 #define SIE_SEIE (1L << 9)  /* 外部中断 */
 #define SIE_STIE (1L << 5)  /* 时钟中断 */
 #define SIE_SSIE (1L << 1)  /* 软件中断 */
+#define SIP_SSIP (1L << 1)  /* 软件中断等待位 */
 // 读 sie，具体中断使能状态
 static inline usize
 r_sie()
@@ -70,6 +80,10 @@ w_sie(usize x)
 }
 
 #define SSTATUS_SUM (1L << 18)  /* 允许内核访问用户态 */
+#define SSTATUS_FS  (3L << 13)  /* 浮点单元状态：0-Off（访问浮点寄存器触发非法指令异常）、1-Initial、2-Clean、3-Dirty */
+#define SSTATUS_FS_CLEAN    (2L << 13)
+#define SSTATUS_FS_DIRTY    (3L << 13)
+#define SSTATUS_VS  (3L << 9)   /* 向量单元状态，含义与 FS 相同 */
 #define SSTATUS_SPP (1L << 8)   /* 上一个特权模式 */
 #define SSTATUS_SPIE (1L << 5)  /* 中断处理发生前的SIE值 */
 #define SSTATUS_SIE (1L << 1)   /* 监管者模式中断使能 */
@@ -99,6 +113,64 @@ r_time()
     return x;
 }
 
+// 写 stimecmp（Sstc 扩展，CSR 0x14d），time 达到该值时产生时钟中断，写入更大的值清除挂起的时钟中断
+static inline void
+w_stimecmp(usize x)
+{
+    asm volatile("csrw 0x14d, %0" : : "r" (x));
+}
+
+// scounteren：允许 U 态读取的计数器
+#define SCOUNTEREN_CY   (1L << 0)   /* cycle */
+#define SCOUNTEREN_TM   (1L << 1)   /* time */
+#define SCOUNTEREN_IR   (1L << 2)   /* instret */
+
+// 写 scounteren
+static inline void
+w_scounteren(usize x)
+{
+    asm volatile("csrw scounteren, %0" : : "r" (x));
+}
+
+// 读 sip，待处理的中断
+static inline usize
+r_sip()
+{
+    usize x;
+    asm volatile("csrr %0, sip" : "=r" (x) );
+    return x;
+}
+
+// 写 sip，S-Mode 下只有 SSIP 位可写，用于清除软件中断
+static inline void
+w_sip(usize x)
+{
+    asm volatile("csrw sip, %0" : : "r" (x));
+}
+
+// 读 tp，内核态下 tp 保存当前 hart 的编号
+static inline usize
+r_tp()
+{
+    usize x;
+    asm volatile("mv %0, tp" : "=r" (x) );
+    return x;
+}
+
+// 写 tp
+static inline void
+w_tp(usize x)
+{
+    asm volatile("mv tp, %0" : : "r" (x));
+}
+
+/* 当前 hart 编号，内核中 tp 固定保存 hartid（见 entry.S 与 interrupt.S） */
+static inline int
+cpuid()
+{
+    return (int)r_tp();
+}
+
 static inline uint64
 r_satp()
 {
@@ -107,6 +179,20 @@ r_satp()
     return x;
 }
 
+/* 刷新本 hart 的全部 TLB */
+static inline void
+sfence_vma()
+{
+    asm volatile("sfence.vma zero, zero" ::: "memory");
+}
+
+/* 刷新本 hart TLB 中虚拟地址 va 所在页的映射 */
+static inline void
+sfence_vma_addr(usize va)
+{
+    asm volatile("sfence.vma %0, zero" :: "r"(va) : "memory");
+}
+
 /* 打开异步中断，并等待中断 */
 static inline void
 enable_and_wfi()
@@ -2,81 +2,167 @@
  * Author：Joker001014
  * 2025.03.06
  * 实现 thread.h 中定义的 Scheduler 结构体中的五个调度器算法
+ * 每个 hart 有自己的就绪队列，本 hart 队列为空时从最忙的 hart 窃取线程
 ***********************************************************************/
 
 #include "types.h"
 #include "def.h"
 #include "thread.h"
+#include "riscv.h"
+#include "spinlock.h"
 
 // 双向环形链表来实现队列,队列元素如下
-// 链表的节点按照 tid + 1 都存放在数组中，其中下标 0 处为 Dummy Head，用于快速找到队列头
+// 下标 0 ~ MAX_CPU-1 处为各个 hart 就绪队列的 Dummy Head，用于快速找到队列头
+// 线程的节点按照 tid + MAX_CPU 存放在数组中
 typedef struct
 {
     int valid;      // 标记线程是否有效
     usize time;     // 线程剩余时间片
-    int prev;       // 前一个线程tid
-    int next;       // 后一个线程tid
+    int prev;       // 前一个节点下标
+    int next;       // 后一个节点下标
 } RRInfo;
 
+#define NODE(tid)   ((tid) + MAX_CPU)   // 线程 tid 对应的节点下标
+#define TID(node)   ((node) - MAX_CPU)  // 节点下标对应的线程 tid
+
 // 调度器信息结构体
 struct
 {
-    RRInfo threads[MAX_THREAD + 1]; // 优先级调度队列（由于 0 号位有个 Dummy Head，所以 threads 数组的长度为 MAX_THREAD + 1）
-    usize maxTime;                  // 最大时间片
-    int current;                    // 当前正在运行的tid
+    RRInfo threads[MAX_LIVE_THREADS + MAX_CPU];   // 调度队列节点（前 MAX_CPU 个为各 hart 队列的 Dummy Head）
+    int length[MAX_CPU];                    // 各 hart 就绪队列长度，用于选择窃取对象
+    Spinlock lock[MAX_CPU];                 // 各 hart 就绪队列的锁，窃取时其他 hart 也会访问该队列
+    usize maxTime;                          // 最大时间片
+    int current[MAX_CPU];                   // 各 hart 当前正在运行的节点下标，0 表示没有
 } rrScheduler;
 
+// 获取/释放 hart 就绪队列的锁，调度器总是在关中断时被调用
+static inline void
+lockQueue(int hart)
+{
+    acquireLock(&rrScheduler.lock[hart]);
+}
+
+static inline void
+unlockQueue(int hart)
+{
+    releaseLock(&rrScheduler.lock[hart]);
+}
+
+// 将节点从所在队列中摘下（需持有队列锁）
+static void
+unlinkNode(int hart, int node)
+{
+    int next = rrScheduler.threads[node].next;  // 获取该线程的下一个线程
+    int prev = rrScheduler.threads[node].prev;  // 获取该线程的上一个线程
+    rrScheduler.threads[next].prev = prev;      // 更新下一个线程的prev
+    rrScheduler.threads[prev].next = next;      // 更新上一个线程的next
+    rrScheduler.threads[node].prev = 0;         // 清空当前线程的prev
+    rrScheduler.threads[node].next = 0;         // 清空当前线程的next
+    rrScheduler.threads[node].valid = 0;        // 标记当前线程为无效
+    rrScheduler.length[hart] -= 1;
+}
+
 // 初始化调度器
 void
 schedulerInit()
 {
     rrScheduler.maxTime = 1;        // 设置最大时间片为1
-    rrScheduler.current = 0;        // 当前没有线程运行，设置当前线程为0
-    /* 第 0 个位置为 Dummy head，用于快速找到链表头和尾 */
-    RRInfo ri = {0, 0L, 0, 0};      // 初始化一个无效的线程信息结构
-    rrScheduler.threads[0] = ri;
+    int hart;
+    for(hart = 0; hart < MAX_CPU; hart ++) {
+        rrScheduler.current[hart] = 0;  // 当前没有线程运行
+        rrScheduler.length[hart] = 0;
+        initLock(&rrScheduler.lock[hart], "runqueue");
+        /* 每个 hart 的 Dummy head 初始时指向自己，用于快速找到链表头和尾 */
+        RRInfo ri = {0, 0L, hart, hart};
+        rrScheduler.threads[hart] = ri;
+    }
 }
 
-// 将一个线程加入线程调度，即加入调度队列尾部
+// 将一个线程加入当前 hart 的线程调度，即加入调度队列尾部
 void
 schedulerPush(int tid)
 {
-    tid += 1;       // 调整索引
-    if(tid + 1 > MAX_THREAD + 1) {
+    if(tid < 0 || tid >= MAX_LIVE_THREADS) {
         panic("Cannot push to scheduler!\n");
     }
+    int hart = cpuid();
+    int node = NODE(tid);     // 调整索引
+    lockQueue(hart);
     // 若线程没有时间片，初始化为最大时间片
-    if(rrScheduler.threads[tid].time == 0) {
-        rrScheduler.threads[tid].time = rrScheduler.maxTime;
+    if(rrScheduler.threads[node].time == 0) {
+        rrScheduler.threads[node].time = rrScheduler.maxTime;
     }
-    // 获取但前队列尾部
-    int prev = rrScheduler.threads[0].prev;
+    // 获取当前队列尾部
+    int prev = rrScheduler.threads[hart].prev;
     // 将线程加入队列尾部
-    rrScheduler.threads[tid].valid = 1;     // 标记线程有效
-    rrScheduler.threads[prev].next = tid;   // 尾部next指向当前线程
-    rrScheduler.threads[tid].prev = prev;   // 当前线程prev指向尾部线程
-    rrScheduler.threads[0].prev = tid;      // 头部prev指向当前线程
-    rrScheduler.threads[tid].next = 0;      // 当前线程next指向头部
+    rrScheduler.threads[node].valid = 1;    // 标记线程有效
+    rrScheduler.threads[prev].next = node;  // 尾部next指向当前线程
+    rrScheduler.threads[node].prev = prev;  // 当前线程prev指向尾部线程
+    rrScheduler.threads[hart].prev = node;  // 头部prev指向当前线程
+    rrScheduler.threads[node].next = hart;  // 当前线程next指向头部
+    rrScheduler.length[hart] += 1;
+    unlockQueue(hart);
+    getLoadStats(hart)->enqueued += 1;
+}
+
+/*
+ * 本 hart 队列为空时，从就绪线程最多的 hart 的队尾窃取一个线程
+ * 队尾的线程最晚入队，在原 hart 上最晚才会被运行，窃取它对原 hart 影响最小
+ * 返回窃取到的节点下标，没有可窃取的线程返回 0
+ */
+static int
+stealNode(int self)
+{
+    int victim = -1, most = 0, hart;
+    for(hart = 0; hart < MAX_CPU; hart ++) {
+        if(hart == self || !isHartOnline(hart)) continue;
+        int len = __atomic_load_n(&rrScheduler.length[hart], __ATOMIC_RELAXED);
+        if(len > most) {
+            most = len;
+            victim = hart;
+        }
+    }
+    if(victim == -1) {
+        return 0;
+    }
+    lockQueue(victim);
+    int node = rrScheduler.threads[victim].prev;    // 队尾
+    if(node != victim) {
+        unlinkNode(victim, node);
+    } else {
+        node = 0;   // 加锁前已被取走
+    }
+    unlockQueue(victim);
+    if(node != 0) {
+        getLoadStats(self)->stolen += 1;
+        getLoadStats(victim)->donated += 1;
+    }
+    return node;
 }
 
 // 从就绪线程中选择一个运行，如果没有可运行的线程则返回 -1
 int
 schedulerPop()
 {
+    int hart = cpuid();
+    lockQueue(hart);
     // 获取队列一个有效线程
-    int ret = rrScheduler.threads[0].next;  
-    if(ret != 0) {
-        // 若有可用线程，则从队列头部弹出
-        int next = rrScheduler.threads[ret].next;   // 获取该线程的下一个线程
-        int prev = rrScheduler.threads[ret].prev;   // 获取该线程的上一个线程
-        rrScheduler.threads[next].prev = prev;      // 更新下一个线程的prev
-        rrScheduler.threads[prev].next = next;      // 更新上一个线程的next
-        rrScheduler.threads[ret].prev = 0;          // 清空当前线程的prev
-        rrScheduler.threads[ret].next = 0;          // 清空当前线程的next
-        rrScheduler.threads[ret].valid = 0;         // 标记当前线程为无效
-        rrScheduler.current = ret;                  // 设置调度器当前线程为弹出线程
+    int ret = rrScheduler.threads[hart].next;
+    if(ret != hart) {
+        unlinkNode(hart, ret);  // 若有可用线程，则从队列头部弹出
+    } else {
+        ret = 0;
+    }
+    unlockQueue(hart);
+    if(ret == 0) {
+        ret = stealNode(hart);  // 本 hart 没有就绪线程，尝试窃取
+    }
+    if(ret == 0) {
+        return -1;
     }
-    return ret-1;   // 调整索引
+    rrScheduler.current[hart] = ret;    // 设置调度器当前线程为弹出线程
+    getLoadStats(hart)->dispatched += 1;
+    return TID(ret);    // 调整索引
 }
 
 // 提醒调度算法当前线程又运行了一个 tick
@@ -84,11 +170,14 @@ schedulerPop()
 int
 schedulerTick()
 {
-    int tid = rrScheduler.current;  // 获取当前线程tid
-    if(tid != 0) {
+    int node = rrScheduler.current[cpuid()];    // 获取当前线程
+    if(node != 0) {
         // 当前线程有效
-        rrScheduler.threads[tid].time -= 1;     // 当前线程时间片-1
-        if(rrScheduler.threads[tid].time == 0) {    
+        // 上一次需要切换时可能没有切换出去（如处于 RCU 读临界区），时间片不会减到负数
+        if(rrScheduler.threads[node].time > 0) {
+            rrScheduler.threads[node].time -= 1;    // 当前线程时间片-1
+        }
+        if(rrScheduler.threads[node].time == 0) {
             return 1;       // 时间片用尽则切换出去
         } else {
             return 0;       // 否则不切换
@@ -101,9 +190,16 @@ schedulerTick()
 void
 schedulerExit(int tid)
 {
-    tid += 1;   // 调整索引
+    int hart = cpuid();
     // 判断结束的线程是否为当前正在运行的线程
-    if(rrScheduler.current == tid) {
-        rrScheduler.current = 0;    // 将当前线程设置为0，表示没有线程在运行
+    if(rrScheduler.current[hart] == NODE(tid)) {
+        rrScheduler.current[hart] = 0;  // 将当前线程设置为0，表示没有线程在运行
     }
-}
\ No newline at end of file
+}
+
+// hart 的就绪队列中是否还有线程等待，没有时当前线程不需要时间片轮转
+int
+schedulerNeedTick(int hart)
+{
+    return __atomic_load_n(&rrScheduler.length[hart], __ATOMIC_RELAXED) > 0;
+}
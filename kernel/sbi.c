@@ -6,6 +6,7 @@
 
 #include "types.h"
 #include "def.h"
+#include "consts.h"
 #include "sbi.h"
 
 // 向终端输出一个字符
@@ -22,6 +23,24 @@ consoleGetchar()
     return SBI_ECALL_0(SBI_CONSOLE_GETCHAR);
 }
 
+/*
+ * 通过调试控制台扩展一次输出一段字符，SBI 不支持该扩展时返回 -1
+ * 扩展要求传入物理地址，buf 需位于内核线性映射中
+ * 可能只输出了一部分，返回实际输出的字节数
+ */
+long
+sbiDebugWrite(char *buf, usize len)
+{
+    static int hasExt = -1;
+    if(hasExt == -1) hasExt = sbiProbeExtension(SBI_EXT_DBCN);
+    if(!hasExt) {
+        return -1;
+    }
+    usize pa = (usize)buf - KERNEL_MAP_OFFSET;
+    SbiRet ret = SBI_ECALL_EXT(SBI_EXT_DBCN, SBI_DBCN_CONSOLE_WRITE, len, pa, 0);
+    return ret.error == 0 ? ret.value : -1;
+}
+
 // 关闭系统
 void
 shutdown()
@@ -30,9 +49,69 @@ shutdown()
     while(1) {}
 }
 
-// 设置定时器
+// 通过 SBI 设置定时器，优先使用 TIME 扩展，不支持时回退到旧版调用
+// 支持 Sstc 扩展的 hart 直接写 stimecmp，不经过这里（见 timer.c）
 void
 setTimer(usize time)
 {
-    SBI_ECALL_1(SBI_SET_TIMER, time);
-}
\ No newline at end of file
+    static int hasExt = -1;
+    if(hasExt == -1) hasExt = sbiProbeExtension(SBI_EXT_TIME);
+    if(hasExt) {
+        SBI_ECALL_EXT(SBI_EXT_TIME, SBI_TIME_SET_TIMER, time, 0, 0);
+    } else {
+        SBI_ECALL_1(SBI_SET_TIMER, time);
+    }
+}
+
+// 探测 SBI 是否实现了某个扩展，实现时返回非零值
+int
+sbiProbeExtension(usize ext)
+{
+    SbiRet ret = SBI_ECALL_EXT(SBI_EXT_BASE, SBI_BASE_PROBE_EXTENSION, ext, 0, 0);
+    return ret.error == 0 && ret.value != 0;
+}
+
+// 向编号为 hart 的核发送一个软件中断（IPI）
+// 优先使用 IPI 扩展，不支持时回退到传入 hart 位图地址的旧版调用
+void
+sendIPI(usize hart)
+{
+    static int hasExt = -1;
+    if(hasExt == -1) hasExt = sbiProbeExtension(SBI_EXT_IPI);
+    if(hasExt) {
+        SBI_ECALL_EXT(SBI_EXT_IPI, SBI_IPI_SEND_IPI, 1UL << hart, 0, 0);
+    } else {
+        usize mask = 1UL << hart;
+        SBI_ECALL_1(SBI_SEND_IPI, &mask);
+    }
+}
+
+// 让 hartMask 中的 hart 刷新 [start, start + size) 范围的 TLB，size 为 -1 时刷新全部
+// SBI 在所有目标 hart 完成刷新后才返回
+void
+remoteSfenceVma(usize hartMask, usize start, usize size)
+{
+    static int hasExt = -1;
+    if(hasExt == -1) hasExt = sbiProbeExtension(SBI_EXT_RFENCE);
+    if(hasExt) {
+        SBI_ECALL_EXT4(SBI_EXT_RFENCE, SBI_RFENCE_SFENCE_VMA, hartMask, 0, start, size);
+    } else {
+        SBI_ECALL(SBI_REMOTE_SFENCE_VMA, &hartMask, start, size);
+    }
+}
+
+// 查询 hart 的状态，hart 不存在时返回 -1
+long
+hartGetStatus(usize hart)
+{
+    SbiRet ret = SBI_ECALL_EXT(SBI_EXT_HSM, SBI_HSM_HART_GET_STATUS, hart, 0, 0);
+    return ret.error ? -1 : ret.value;
+}
+
+// 启动一个处于停止状态的 hart，从物理地址 startAddr 开始执行，a0 = hartid，a1 = opaque
+int
+hartStart(usize hart, usize startAddr, usize opaque)
+{
+    SbiRet ret = SBI_ECALL_EXT(SBI_EXT_HSM, SBI_HSM_HART_START, hart, startAddr, opaque);
+    return ret.error == 0;
+}
@@ -17,6 +17,24 @@
 #define SBI_REMOTE_SFENCE_VMA_ASID  0x7
 #define SBI_SHUTDOWN                0x8
 
+// SBI v0.2 之后的扩展号（EID），具体功能由 a6 中的功能号（FID）区分
+#define SBI_EXT_BASE                0x10        /* 基础扩展，用于探测其他扩展是否存在 */
+#define SBI_EXT_IPI                 0x735049    /* "sPI" 核间中断扩展 */
+#define SBI_EXT_HSM                 0x48534D    /* "HSM" Hart 状态管理扩展 */
+#define SBI_EXT_RFENCE              0x52464E43  /* "RFNC" 远程栅栏扩展，用于刷新其他 hart 的 TLB */
+#define SBI_EXT_TIME                0x54494D45  /* "TIME" 定时器扩展 */
+#define SBI_EXT_DBCN                0x4442434E  /* "DBCN" 调试控制台扩展，一次调用输出一段字符 */
+
+#define SBI_BASE_PROBE_EXTENSION    3           /* BASE：探测扩展 */
+#define SBI_IPI_SEND_IPI            0           /* IPI：向 hart_mask 中的 hart 发送软件中断 */
+#define SBI_TIME_SET_TIMER          0           /* TIME：设置下一次时钟中断 */
+#define SBI_HSM_HART_START          0           /* HSM：启动一个 hart */
+#define SBI_HSM_HART_GET_STATUS     2           /* HSM：查询 hart 状态 */
+#define SBI_RFENCE_SFENCE_VMA       1           /* RFENCE：在 hart_mask 中的 hart 上执行 sfence.vma */
+#define SBI_DBCN_CONSOLE_WRITE      0           /* DBCN：输出物理地址处的一段字符 */
+
+#define SBI_HSM_STATE_STOPPED       1           /* hart 处于停止状态，可以被启动 */
+
 // SBI系统调用（内核态调用ECALL）
 // register声明四个寄存器变量，并通过asm与对应的寄存器绑定，然后赋值
 // +表示a0是一个输入输出寄存器
@@ -35,6 +53,29 @@
         : "memory");    \
 a0;} )
 
+// SBI 扩展调用，a7 保存扩展号，a6 保存功能号
+// 返回值 a0 为错误码（0 表示成功），a1 为返回值，二者合并为一个 SbiRet 结构
+typedef struct {
+    long error;
+    long value;
+} SbiRet;
+
+#define SBI_ECALL_EXT4(__ext, __fid, __a0, __a1, __a2, __a3)  \
+( { \
+    register unsigned long a0 asm("a0") = (unsigned long)(__a0);    \
+    register unsigned long a1 asm("a1") = (unsigned long)(__a1);    \
+    register unsigned long a2 asm("a2") = (unsigned long)(__a2);    \
+    register unsigned long a3 asm("a3") = (unsigned long)(__a3);    \
+    register unsigned long a6 asm("a6") = (unsigned long)(__fid);   \
+    register unsigned long a7 asm("a7") = (unsigned long)(__ext);   \
+    asm volatile("ecall"    \
+        : "+r"(a0), "+r"(a1)  \
+        : "r"(a2), "r"(a3), "r"(a6), "r"(a7) \
+        : "memory");    \
+(SbiRet){(long)a0, (long)a1};} )
+
+#define SBI_ECALL_EXT(__ext, __fid, __a0, __a1, __a2) SBI_ECALL_EXT4(__ext, __fid, __a0, __a1, __a2, 0)
+
 // 不同参数个数宏拓展，没有参数时传递0
 #define SBI_ECALL_0(__num) SBI_ECALL(__num, 0, 0, 0)
 #define SBI_ECALL_1(__num, __a0) SBI_ECALL(__num, __a0, 0, 0)
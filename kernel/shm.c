@@ -0,0 +1,338 @@
+/************************** 共享内存段 *********************************
+ * Author：Joker001014
+ * 2025.03.30
+ * 按名字创建共享内存段，同一段的物理页可以被映射到多个进程中，进程之间直接读写交换数据
+ *      映射只能放在 [USER_SHM_BASE, USER_SHM_END) 中，由调用者指定地址或由内核从高往低选择
+ *      该区域与用户栈槽位、共享数据页和环形队列共享区都不重叠，之后建立的这些映射不会与段冲突
+ *      页表项带有 SHARED 标志，销毁地址空间时不会释放这些页；进程退出时自动解除它的所有映射
+ *      打开（创建）过段的进程和段的每个映射各持有一个引用，进程退出时释放它持有的全部引用
+ *      打开过它的进程都已退出、所有映射都已解除时释放物理页和名字，创建后从未映射的段也不会一直占用段表
+ * 共享页上的 futex 按物理地址散列，不同进程可以在段中的 futex 字上互相等待和唤醒
+***********************************************************************/
+
+#include "types.h"
+#include "def.h"
+#include "consts.h"
+#include "thread.h"
+#include "mapping.h"
+#include "tlb.h"
+#include "spinlock.h"
+#include "shm.h"
+
+// 段号：高位为槽位的代数，低位为槽位下标，段被释放后旧段号不再有效
+#define SHM_GEN_MASK        ((1 << (31 - SHM_INDEX_BITS)) - 1)  // 代数只占用符号位以下的剩余位，段号总是非负
+#define SHM_ID(gen, idx)    ((int)((((gen) & SHM_GEN_MASK) << SHM_INDEX_BITS) | (idx)))
+#define SHM_INDEX(id)       ((id) & (MAX_SHM - 1))
+
+static struct {
+    Spinlock lock;      // 保护段表和各段的引用数
+    ShmSegment segs[MAX_SHM];
+} SHM;
+
+// 初始化共享内存段表
+void
+initShm()
+{
+    initLock(&SHM.lock, "shm");
+    int i;
+    for(i = 0; i < MAX_SHM; i ++) {
+        SHM.segs[i].used = 0;
+        SHM.segs[i].generation = 0;
+    }
+}
+
+// 释放段的物理页
+static void
+freeFrames(usize *frames, usize pages)
+{
+    usize i;
+    for(i = 0; i < pages; i ++) {
+        deallocFrame(frames[i]);
+    }
+    kfree(frames);
+}
+
+// 按名字查找段（需持有 SHM.lock），没有返回 0
+static ShmSegment *
+findByName(char *name)
+{
+    int i;
+    for(i = 0; i < MAX_SHM; i ++) {
+        if(SHM.segs[i].used && strcmp(SHM.segs[i].name, name) == 0) {
+            return &SHM.segs[i];
+        }
+    }
+    return 0;
+}
+
+// 释放段的一个引用，最后一个引用释放时释放段
+static void
+putShm(ShmSegment *seg)
+{
+    usize flags = acquireLockIrqsave(&SHM.lock);
+    seg->refs -= 1;
+    if(seg->refs > 0) {
+        releaseLockIrqrestore(&SHM.lock, flags);
+        return;
+    }
+    usize *frames = seg->frames;
+    usize pages = seg->pages;
+    seg->used = 0;
+    seg->frames = 0;
+    releaseLockIrqrestore(&SHM.lock, flags);
+    freeFrames(frames, pages);
+}
+
+// 当前进程打开段 seg，调用者已为它增加一个引用；进程已打开过该段时释放这个多余的引用
+static void
+openShm(ShmSegment *seg)
+{
+    Process *p = getCurrentThread()->process;
+    ShmAttach *at = kalloc(sizeof(ShmAttach));
+    usize flags = acquireLockIrqsave(&p->lock);
+    ShmAttach *it;
+    for(it = p->shm; it != 0; it = it->next) {
+        if(it->seg == seg && it->addr == 0) {
+            break;
+        }
+    }
+    if(it == 0) {
+        at->seg = seg;
+        at->addr = 0;
+        at->next = p->shm;
+        p->shm = at;
+    }
+    releaseLockIrqrestore(&p->lock, flags);
+    if(it != 0) {
+        kfree(at);
+        putShm(seg);
+    }
+}
+
+/*
+ * 创建名为 name（内核缓冲区，长度为 len，不含结尾的 0）、大小为 size 字节的段，返回段号
+ * 同名的段已存在时直接返回它的段号，此时 size 不能超过它的大小
+ * 当前进程因此持有段的一个引用，直到它退出
+ */
+long
+shmCreate(char *name, usize len, usize size)
+{
+    if(getCurrentThread()->process == 0) {
+        return -EINVAL;
+    }
+    if(len == 0 || len >= SHM_NAME_MAX || size == 0 || size > SHM_MAX_PAGES * PAGE_SIZE) {
+        return -EINVAL;
+    }
+    char key[SHM_NAME_MAX];
+    usize i;
+    for(i = 0; i < len; i ++) {
+        key[i] = name[i];
+    }
+    key[len] = 0;
+    usize pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    usize flags = acquireLockIrqsave(&SHM.lock);
+    ShmSegment *seg = findByName(key);
+    if(seg != 0) {
+        if(seg->pages < pages) {
+            releaseLockIrqrestore(&SHM.lock, flags);
+            return -EINVAL;
+        }
+        seg->refs += 1;
+        long id = SHM_ID(seg->generation, seg - SHM.segs);
+        releaseLockIrqrestore(&SHM.lock, flags);
+        openShm(seg);
+        return id;
+    }
+    releaseLockIrqrestore(&SHM.lock, flags);
+
+    // 清零物理页耗时较长，在锁外分配
+    usize *frames = kalloc(pages * sizeof(usize));
+    for(i = 0; i < pages; i ++) {
+        frames[i] = allocFrame();
+    }
+
+    flags = acquireLockIrqsave(&SHM.lock);
+    seg = findByName(key);
+    if(seg != 0) {
+        // 分配期间被其他进程创建
+        long ret = -EINVAL;
+        if(seg->pages >= pages) {
+            seg->refs += 1;
+            ret = SHM_ID(seg->generation, seg - SHM.segs);
+        }
+        releaseLockIrqrestore(&SHM.lock, flags);
+        freeFrames(frames, pages);
+        if(ret >= 0) {
+            openShm(seg);
+        }
+        return ret;
+    }
+    int idx;
+    for(idx = 0; idx < MAX_SHM && SHM.segs[idx].used; idx ++);
+    if(idx == MAX_SHM) {
+        releaseLockIrqrestore(&SHM.lock, flags);
+        freeFrames(frames, pages);
+        return -ENOSPC;
+    }
+    seg = &SHM.segs[idx];
+    seg->used = 1;
+    seg->generation += 1;
+    for(i = 0; i <= len; i ++) {
+        seg->name[i] = key[i];
+    }
+    seg->pages = pages;
+    seg->frames = frames;
+    seg->refs = 1;
+    long id = SHM_ID(seg->generation, idx);
+    releaseLockIrqrestore(&SHM.lock, flags);
+    openShm(seg);
+    return id;
+}
+
+// [addr, addr + size) 是否在共享内存段区域内且尚未映射（需持有进程锁）
+static int
+rangeFree(Mapping m, usize addr, usize size)
+{
+    usize end = addr + size;
+    if(end < addr || addr < USER_SHM_BASE || end > USER_SHM_END) {
+        return 0;
+    }
+    usize va;
+    for(va = addr; va < end; va += PAGE_SIZE) {
+        PageTableEntry *entry = lookupEntry(m, va / PAGE_SIZE);
+        if(entry != 0 && *entry != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// 在共享内存段区域中从高往低找一段空闲范围（需持有进程锁），找不到返回 0
+static usize
+chooseAddress(Mapping m, usize size)
+{
+    usize addr = USER_SHM_END - size;
+    while(addr >= USER_SHM_BASE) {
+        // 从高往低找到第一个已映射的页，下一次尝试放在它下面
+        usize va = addr + size;
+        while(va > addr) {
+            PageTableEntry *entry = lookupEntry(m, va / PAGE_SIZE - 1);
+            if(entry != 0 && *entry != 0) {
+                break;
+            }
+            va -= PAGE_SIZE;
+        }
+        if(va == addr) {
+            return addr;
+        }
+        if(va - PAGE_SIZE < USER_SHM_BASE + size) {
+            break;
+        }
+        addr = va - PAGE_SIZE - size;
+    }
+    return 0;
+}
+
+/*
+ * 将段 id 映射到当前进程的 addr 处，addr 为 0 时由内核选择地址
+ * 返回映射的起始地址，地址范围超出 [USER_SHM_BASE, USER_SHM_END) 或已被占用时返回 -EINVAL，没有足够的空闲地址时返回 -ENOMEM
+ * 高半部分的地址转换为 long 后也是负数，但不会落在错误码的范围 [-4095, -1] 内
+ */
+long
+shmAttach(int id, usize addr)
+{
+    Process *p = getCurrentThread()->process;
+    if(p == 0 || id < 0 || (addr & (PAGE_SIZE - 1))) {
+        return -EINVAL;
+    }
+    // 先为映射增加引用，之后段不会被释放
+    usize flags = acquireLockIrqsave(&SHM.lock);
+    ShmSegment *seg = &SHM.segs[SHM_INDEX(id)];
+    if(!seg->used || SHM_ID(seg->generation, SHM_INDEX(id)) != id) {
+        releaseLockIrqrestore(&SHM.lock, flags);
+        return -EINVAL;
+    }
+    seg->refs += 1;
+    releaseLockIrqrestore(&SHM.lock, flags);
+
+    usize size = seg->pages * PAGE_SIZE;
+    ShmAttach *at = kalloc(sizeof(ShmAttach));
+    Mapping m = satpMapping(p->satp);
+    flags = acquireLockIrqsave(&p->lock);
+    int ok;
+    if(addr == 0) {
+        addr = chooseAddress(m, size);
+        ok = addr != 0;
+    } else {
+        ok = rangeFree(m, addr, size);
+    }
+    if(ok) {
+        usize i;
+        for(i = 0; i < seg->pages; i ++) {
+            PageTableEntry *entry = findEntry(m, addr / PAGE_SIZE + i);
+            *entry = (seg->frames[i] >> 2) | USER | READABLE | WRITABLE | SHARED | VALID;
+        }
+        at->seg = seg;
+        at->addr = addr;
+        at->next = p->shm;
+        p->shm = at;
+    }
+    releaseLockIrqrestore(&p->lock, flags);
+    if(!ok) {
+        kfree(at);
+        putShm(seg);    // 当前进程打开过该段时，段仍由打开的引用保留
+        return addr == 0 ? -ENOMEM : -EINVAL;
+    }
+    return addr;
+}
+
+/*
+ * 解除当前进程在 addr 处的映射，所有 hart 刷新 TLB 后才释放映射持有的引用
+ * addr 不是某次映射的起始地址时返回 -EINVAL
+ */
+long
+shmDetach(usize addr)
+{
+    Process *p = getCurrentThread()->process;
+    if(p == 0 || addr == 0) {
+        return -EINVAL;
+    }
+    Mapping m = satpMapping(p->satp);
+    TlbBatch batch;
+    initTlbBatch(&batch, p);
+    usize flags = acquireLockIrqsave(&p->lock);
+    ShmAttach **pp = &p->shm;
+    while(*pp != 0 && (*pp)->addr != addr) {
+        pp = &(*pp)->next;
+    }
+    ShmAttach *at = *pp;
+    if(at == 0) {
+        releaseLockIrqrestore(&p->lock, flags);
+        return -EINVAL;
+    }
+    *pp = at->next;
+    usize i;
+    for(i = 0; i < at->seg->pages; i ++) {
+        usize va = addr + i * PAGE_SIZE;
+        PageTableEntry *entry = lookupEntry(m, va / PAGE_SIZE);
+        *entry = 0;
+        addTlbBatch(&batch, va, 0);     // 物理页属于段，不随页表项释放
+    }
+    releaseLockIrqrestore(&p->lock, flags);
+    flushTlbBatch(&batch);
+    putShm(at->seg);
+    kfree(at);
+    return 0;
+}
+
+// 进程销毁时解除它的所有映射并释放它打开段的引用，此时页表已不再被任何 hart 使用
+void
+detachAllShm(Process *process)
+{
+    while(process->shm != 0) {
+        ShmAttach *at = process->shm;
+        process->shm = at->next;
+        putShm(at->seg);
+        kfree(at);
+    }
+}
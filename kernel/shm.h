@@ -0,0 +1,40 @@
+/************************** 共享内存段 *********************************
+ * Author：Joker001014
+ * 2025.03.30
+***********************************************************************/
+
+#ifndef _SHM_H
+#define _SHM_H
+
+#include "types.h"
+#include "thread.h"
+
+#define SHM_INDEX_BITS  4       // 段号的低位为段表下标
+#define MAX_SHM         (1 << SHM_INDEX_BITS)   // 系统中最多同时存在的共享内存段数
+#define SHM_NAME_MAX    32      // 段名的最大长度（含结尾的 0）
+#define SHM_MAX_PAGES   1024    // 单个段最大 4 MiB
+
+// 共享内存段，按名字查找，被映射到多个地址空间中
+typedef struct ShmSegment {
+    int used;               // 槽位是否被占用
+    uint32 generation;      // 槽位每次被占用时加一，与下标一起组成段号
+    char name[SHM_NAME_MAX];
+    usize pages;            // 页数
+    usize *frames;          // 各页的物理地址
+    int refs;               // 映射数加上打开过该段、尚未退出的进程数，减为 0 时释放物理页
+} ShmSegment;
+
+// 进程中的一次映射或对段的一次打开，链表由进程锁保护
+typedef struct ShmAttach {
+    ShmSegment *seg;
+    usize addr;             // 映射的起始用户地址，为 0 表示进程打开过该段（每个进程每段至多一项）
+    struct ShmAttach *next;
+} ShmAttach;
+
+void initShm();
+long shmCreate(char *name, usize len, usize size);
+long shmAttach(int id, usize addr);
+long shmDetach(usize addr);
+void detachAllShm(Process *process);
+
+#endif
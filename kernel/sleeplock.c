@@ -0,0 +1,167 @@
+/***************************** 睡眠锁 **********************************
+ * Author：Joker001014
+ * 2025.03.20
+ * 互斥锁、信号量和读写锁，获取不到时线程进入等待队列休眠而不是自旋
+ * 内部字段由一个自旋锁保护，等待借助条件变量完成
+ * 名称不为 0 时统计信息登记到只压入的锁统计链表，会被释放的锁（如 kalloc 分配的）名称必须为 0
+***********************************************************************/
+
+#include "types.h"
+#include "def.h"
+#include "sleeplock.h"
+#include "thread.h"
+
+/* 互斥锁 */
+
+void
+initMutex(Mutex *m, char *name)
+{
+    initLock(&m->guard, 0);
+    initCondition(&m->waiters);
+    m->locked = 0;
+    m->owner = -1;
+    registerLockStats(&m->stats, name);
+}
+
+// 获取互斥锁，已被持有时休眠等待
+void
+acquireMutex(Mutex *m)
+{
+    usize flags = acquireLockIrqsave(&m->guard);
+    int contended = m->locked;
+    while(m->locked) {
+        waitCondition(&m->waiters, &m->guard);
+    }
+    m->locked = 1;
+    m->owner = getCurrentTid();
+    lockStatsAcquired(&m->stats, contended);
+    releaseLockIrqrestore(&m->guard, flags);
+}
+
+// 释放互斥锁，唤醒一个等待者
+void
+releaseMutex(Mutex *m)
+{
+    usize flags = acquireLockIrqsave(&m->guard);
+    if(!m->locked || m->owner != getCurrentTid()) {
+        panic("Release a mutex not held!\n");
+    }
+    lockStatsReleased(&m->stats);
+    m->locked = 0;
+    m->owner = -1;
+    notifyCondition(&m->waiters);
+    releaseLockIrqrestore(&m->guard, flags);
+}
+
+/* 信号量 */
+
+void
+initSemaphore(Semaphore *sem, int count, char *name)
+{
+    initLock(&sem->guard, 0);
+    initCondition(&sem->waiters);
+    sem->count = count;
+    registerLockStats(&sem->stats, name);
+}
+
+// P 操作：资源数为 0 时休眠等待
+void
+downSemaphore(Semaphore *sem)
+{
+    usize flags = acquireLockIrqsave(&sem->guard);
+    int contended = sem->count == 0;
+    while(sem->count == 0) {
+        waitCondition(&sem->waiters, &sem->guard);
+    }
+    sem->count -= 1;
+    lockStatsAcquired(&sem->stats, contended);
+    releaseLockIrqrestore(&sem->guard, flags);
+}
+
+// V 操作：归还一个资源并唤醒一个等待者
+// 信号量不区分持有者，因此不统计持有时间
+void
+upSemaphore(Semaphore *sem)
+{
+    usize flags = acquireLockIrqsave(&sem->guard);
+    sem->count += 1;
+    notifyCondition(&sem->waiters);
+    releaseLockIrqrestore(&sem->guard, flags);
+}
+
+/* 读写锁 */
+
+void
+initRWLock(RWLock *rw, char *name)
+{
+    initLock(&rw->guard, 0);
+    initCondition(&rw->readers);
+    initCondition(&rw->writers);
+    rw->activeReaders = 0;
+    rw->writing = 0;
+    rw->waitingWriters = 0;
+    registerLockStats(&rw->stats, name);
+}
+
+// 获取读锁：没有写者正在写或等待时即可进入
+void
+acquireRead(RWLock *rw)
+{
+    usize flags = acquireLockIrqsave(&rw->guard);
+    int contended = rw->writing || rw->waitingWriters;
+    while(rw->writing || rw->waitingWriters) {
+        waitCondition(&rw->readers, &rw->guard);
+    }
+    if(rw->activeReaders == 0) {
+        lockStatsAcquired(&rw->stats, contended);   // 第一个读者开始持有
+    } else {
+        rw->stats.acquired += 1;
+        if(contended) rw->stats.contended += 1;
+    }
+    rw->activeReaders += 1;
+    releaseLockIrqrestore(&rw->guard, flags);
+}
+
+// 释放读锁：最后一个读者离开时唤醒一个写者
+void
+releaseRead(RWLock *rw)
+{
+    usize flags = acquireLockIrqsave(&rw->guard);
+    rw->activeReaders -= 1;
+    if(rw->activeReaders == 0) {
+        lockStatsReleased(&rw->stats);
+        notifyCondition(&rw->writers);
+    }
+    releaseLockIrqrestore(&rw->guard, flags);
+}
+
+// 获取写锁：需等待所有读者和写者离开
+void
+acquireWrite(RWLock *rw)
+{
+    usize flags = acquireLockIrqsave(&rw->guard);
+    int contended = rw->writing || rw->activeReaders;
+    rw->waitingWriters += 1;
+    while(rw->writing || rw->activeReaders) {
+        waitCondition(&rw->writers, &rw->guard);
+    }
+    rw->waitingWriters -= 1;
+    rw->writing = 1;
+    lockStatsAcquired(&rw->stats, contended);
+    releaseLockIrqrestore(&rw->guard, flags);
+}
+
+// 释放写锁：优先唤醒等待的写者，没有写者时唤醒所有读者
+void
+releaseWrite(RWLock *rw)
+{
+    usize flags = acquireLockIrqsave(&rw->guard);
+    lockStatsReleased(&rw->stats);
+    rw->writing = 0;
+    if(rw->waitingWriters) {
+        notifyCondition(&rw->writers);
+    } else {
+        notifyAllCondition(&rw->readers);
+    }
+    releaseLockIrqrestore(&rw->guard, flags);
+}
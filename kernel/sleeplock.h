@@ -0,0 +1,57 @@
+/***************************** 睡眠锁 **********************************
+ * Author：Joker001014
+ * 2025.03.20
+ * 互斥锁、信号量和读写锁，获取不到时线程进入等待队列休眠而不是自旋
+***********************************************************************/
+
+#ifndef _SLEEPLOCK_H
+#define _SLEEPLOCK_H
+
+#include "types.h"
+#include "spinlock.h"
+#include "condition.h"
+
+// 睡眠互斥锁
+typedef struct {
+    Spinlock guard;     // 保护以下字段
+    Condvar waiters;    // 等待获取锁的线程
+    int locked;         // 是否已被持有
+    int owner;          // 持有锁的线程 tid
+    LockStats stats;
+} Mutex;
+
+// 计数信号量
+typedef struct {
+    Spinlock guard;
+    Condvar waiters;    // 等待信号量的线程
+    int count;          // 剩余资源数
+    LockStats stats;
+} Semaphore;
+
+// 读写锁，写者优先：有写者等待时新的读者也需要等待，避免写者饿死
+typedef struct {
+    Spinlock guard;
+    Condvar readers;    // 等待的读者
+    Condvar writers;    // 等待的写者
+    int activeReaders;  // 正在读的读者数
+    int writing;        // 是否有写者正在写
+    int waitingWriters; // 等待中的写者数
+    LockStats stats;
+} RWLock;
+
+// name 为 0 时不登记竞争统计，会被释放的锁必须为 0（见 registerLockStats）
+void initMutex(Mutex *m, char *name);
+void acquireMutex(Mutex *m);
+void releaseMutex(Mutex *m);
+
+void initSemaphore(Semaphore *sem, int count, char *name);
+void downSemaphore(Semaphore *sem);
+void upSemaphore(Semaphore *sem);
+
+void initRWLock(RWLock *rw, char *name);
+void acquireRead(RWLock *rw);
+void releaseRead(RWLock *rw);
+void acquireWrite(RWLock *rw);
+void releaseWrite(RWLock *rw);
+
+#endif
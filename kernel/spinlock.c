@@ -0,0 +1,133 @@
+/******************************* 自旋锁 ********************************
+ * Author：Joker001014
+ * 2025.03.20
+ * 基于 RISC-V 原子指令的排号自旋锁（ticket spinlock），并记录锁的竞争统计
+***********************************************************************/
+
+#include "types.h"
+#include "def.h"
+#include "riscv.h"
+#include "spinlock.h"
+
+// 已登记统计信息的锁组成的链表（无锁栈，只会压入）
+static LockStats *LOCK_LIST;
+
+// 原子地将 *addr 加上 v，返回原来的值
+// amoadd.w.aqrl 同时具有获取和释放语义
+static inline uint32
+amoaddw(uint32 *addr, uint32 v)
+{
+    uint32 old;
+    asm volatile("amoadd.w.aqrl %0, %2, %1"
+                    : "=r"(old), "+A"(*addr)
+                    : "r"(v)
+                    : "memory");
+    return old;
+}
+
+// 登记一个锁的统计信息，name 为 0 时不登记
+// 链表只压入不删除，会被释放的锁（如 kalloc 分配的）必须传入 0，否则释放后链表中留下悬空指针
+void
+registerLockStats(LockStats *stats, char *name)
+{
+    stats->name = name;
+    stats->acquired = 0;
+    stats->contended = 0;
+    stats->maxHold = 0;
+    if(name == 0) return;
+    LockStats *old = __atomic_load_n(&LOCK_LIST, __ATOMIC_RELAXED);
+    do {
+        stats->next = old;
+    } while(!__atomic_compare_exchange_n(&LOCK_LIST, &old, stats, 0,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+// 记录一次获取锁，需在持有锁时调用
+void
+lockStatsAcquired(LockStats *stats, int contended)
+{
+    stats->acquired += 1;
+    if(contended) stats->contended += 1;
+    stats->holdStart = r_time();
+}
+
+// 记录一次释放锁，更新最长持有时间，需在释放锁之前调用
+void
+lockStatsReleased(LockStats *stats)
+{
+    usize hold = r_time() - stats->holdStart;
+    if(hold > stats->maxHold) stats->maxHold = hold;
+}
+
+// 初始化自旋锁
+void
+initLock(Spinlock *lock, char *name)
+{
+    lock->next = 0;
+    lock->serving = 0;
+    lock->hart = -1;
+    registerLockStats(&lock->stats, name);
+}
+
+// 获取自旋锁
+// 调用者需自行保证持有期间不会被同一 hart 上的中断处理程序再次获取，否则使用 Irqsave 版本
+void
+acquireLock(Spinlock *lock)
+{
+    uint32 ticket = amoaddw(&lock->next, 1);    // 领取号码
+    int contended = 0;
+    while(__atomic_load_n(&lock->serving, __ATOMIC_ACQUIRE) != ticket) {
+        contended = 1;      // 还没轮到自己，等待
+    }
+    lock->hart = cpuid();
+    lockStatsAcquired(&lock->stats, contended);
+}
+
+// 释放自旋锁，叫下一个号码
+void
+releaseLock(Spinlock *lock)
+{
+    if(lock->hart != cpuid()) {
+        panic("Release a lock not held!\n");
+    }
+    lockStatsReleased(&lock->stats);
+    lock->hart = -1;
+    __atomic_store_n(&lock->serving, lock->serving + 1, __ATOMIC_RELEASE);
+}
+
+// 关闭异步中断后获取自旋锁，返回原先的 sstatus
+// 用于中断处理程序也会获取的锁
+usize
+acquireLockIrqsave(Spinlock *lock)
+{
+    usize flags = disable_and_store();
+    acquireLock(lock);
+    return flags;
+}
+
+// 释放自旋锁并恢复原先的中断状态
+void
+releaseLockIrqrestore(Spinlock *lock, usize flags)
+{
+    releaseLock(lock);
+    restore_sstatus(flags);
+}
+
+// 当前 hart 是否持有该锁
+int
+holdingLock(Spinlock *lock)
+{
+    return __atomic_load_n(&lock->serving, __ATOMIC_RELAXED) != __atomic_load_n(&lock->next, __ATOMIC_RELAXED)
+            && lock->hart == cpuid();
+}
+
+// 输出所有登记过的锁的统计信息
+void
+printLockStats()
+{
+    LockStats *st = __atomic_load_n(&LOCK_LIST, __ATOMIC_ACQUIRE);
+    printf("lock name: acquired / contended / max hold\n");
+    for(; st != 0; st = st->next) {
+        printf("%s: %d / %d / %d\n", st->name, (int)st->acquired, (int)st->contended, (int)st->maxHold);
+    }
+}
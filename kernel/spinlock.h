@@ -0,0 +1,43 @@
+/******************************* 自旋锁 ********************************
+ * Author：Joker001014
+ * 2025.03.20
+ * 基于 RISC-V 原子指令的排号自旋锁（ticket spinlock），并记录锁的竞争统计
+***********************************************************************/
+
+#ifndef _SPINLOCK_H
+#define _SPINLOCK_H
+
+#include "types.h"
+
+// 锁的统计信息，所有类型的锁都包含一份
+typedef struct ls {
+    char *name;             // 锁的名称，为 0 时不登记到统计列表中
+    usize acquired;         // 获取锁的次数
+    usize contended;        // 获取锁时需要等待的次数
+    usize maxHold;          // 最长持有时间（time 寄存器计数）
+    usize holdStart;        // 本次持有开始的时间
+    struct ls *next;        // 统计列表中的下一项
+} LockStats;
+
+// 排号自旋锁：获取锁时原子地领取一个号码，等到 serving 叫到自己的号时进入临界区
+// 静态分配并清零的自旋锁可以直接使用，initLock 只是为其命名并登记统计
+typedef struct {
+    uint32 next;            // 下一个发放的号码
+    uint32 serving;         // 当前持有锁的号码
+    int hart;               // 持有锁的 hart，-1 表示未被持有
+    LockStats stats;        // 统计信息
+} Spinlock;
+
+void initLock(Spinlock *lock, char *name);
+void acquireLock(Spinlock *lock);
+void releaseLock(Spinlock *lock);
+usize acquireLockIrqsave(Spinlock *lock);
+void releaseLockIrqrestore(Spinlock *lock, usize flags);
+int holdingLock(Spinlock *lock);
+
+void registerLockStats(LockStats *stats, char *name);
+void lockStatsAcquired(LockStats *stats, int contended);
+void lockStatsReleased(LockStats *stats);
+void printLockStats();
+
+#endif
@@ -1,45 +1,161 @@
 /**************************** 标准输入缓冲区 *****************************
  * Author：Joker001014
  * 2025.03.16
+ * 固定大小的单生产者单消费者环形缓冲区，生产者为串口中断处理程序，消费者为持有 STDIN.lock 的读者
+ *      buf[tail, committed) 为读者可以取走的字符，buf[committed, head) 为规范模式下正在编辑、尚未输入完成的行
+ *      生产者只写 head 和 committed，消费者只写 tail，两端之间不需要加锁，也不为每个字符分配内存
+ * 规范模式的行规程在中断处理程序中完成：CR 转为 LF、回显、退格删除，整行完成时才唤醒读者
 ***********************************************************************/
 
-#include "queue.h"
+#include "types.h"
+#include "def.h"
+#include "consts.h"
 #include "condition.h"
+#include "spinlock.h"
+#include "stdin.h"
+
+#define BS  0x08    // 退格
+#define DL  0x7f    // 删除
 
-// 标准输入缓冲区，buf 为输入字符缓冲，pushed 为条件变量（等待输入的线程）
 struct
 {
-    Queue buf;          // 队列存储字符
-    Condvar pushed;     // 条件变量保存等待输入的线程id
+    Spinlock lock;      // 读者之间互斥，并与 pushed 一起用于休眠和唤醒；生产者只在唤醒时获取
+    Spinlock input;     // 生产者一侧（中断处理程序和切换终端模式）互斥，读者不获取
+    Condvar pushed;     // 等待输入的线程
+    char buf[STDIN_BUF];
+    usize head;         // 生产者下一个写入的位置
+    usize committed;    // 已完成、可以被读取的位置
+    usize tail;         // 消费者下一个读取的位置
+    int waiters;        // 正在等待输入的读者数，为 0 时生产者无需获取锁唤醒
+    int mode;           // 终端模式
 } STDIN;
 
+// 回显输入，只在规范模式下使用
+static void
+echo(char *s, usize len)
+{
+    consoleWrite(s, len);
+}
+
+// 将 buf[committed, head) 发布给读者，有读者等待时唤醒它们
+static void
+commit()
+{
+    __atomic_store_n(&STDIN.committed, STDIN.head, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&STDIN.waiters, __ATOMIC_SEQ_CST) > 0) {
+        usize flags = acquireLockIrqsave(&STDIN.lock);
+        notifyAllCondition(&STDIN.pushed);
+        releaseLockIrqrestore(&STDIN.lock, flags);
+    }
+}
+
+// 行规程处理一个输入字符，返回是否产生了需要发布的内容（只在中断处理程序中调用）
+static int
+inputChar(char ch)
+{
+    usize tail = __atomic_load_n(&STDIN.tail, __ATOMIC_ACQUIRE);
+    if(STDIN.mode == TTY_RAW) {
+        if(STDIN.head - tail == STDIN_BUF) {
+            return 0;       // 缓冲区满，丢弃
+        }
+        STDIN.buf[STDIN.head % STDIN_BUF] = ch;
+        STDIN.head += 1;
+        return 1;
+    }
+    if(ch == BS || ch == DL) {
+        // 只能删除正在编辑的行中的字符
+        if(STDIN.head != STDIN.committed) {
+            STDIN.head -= 1;
+            echo("\b \b", 3);
+        }
+        return 0;
+    }
+    if(ch == '\r') {
+        ch = '\n';
+    }
+    if(STDIN.head - tail >= STDIN_BUF - 1) {
+        // 只剩一个位置时留给换行，一行太长时强制结束
+        if(STDIN.head - tail == STDIN_BUF) {
+            return 1;
+        }
+        ch = '\n';
+    }
+    STDIN.buf[STDIN.head % STDIN_BUF] = ch;
+    STDIN.head += 1;
+    echo(&ch, 1);
+    return ch == '\n';
+}
+
 /*
- * 将一个字符放入标准输入缓冲区
- * 并唤醒一个等待字符的线程
+ * 串口中断处理程序一次收到的所有字符，经行规程处理后放入缓冲区
+ * 原始模式下每批字符唤醒一次读者，规范模式下只在一行输入完成时唤醒
  */
 void
-pushChar(char ch)
+pushChars(char *buf, int n)
 {
-    pushBack(&STDIN.buf, (usize)ch);    // 将字符放入标准输入缓冲区
-    notifyCondition(&STDIN.pushed);     // 从等待队列中唤醒一个线程
+    int i, publish = 0;
+    acquireLock(&STDIN.input);
+    for(i = 0; i < n; i ++) {
+        publish |= inputChar(buf[i]);
+    }
+    if(publish) {
+        commit();
+    }
+    releaseLock(&STDIN.input);
 }
 
 /*
- * 线程请求从 stdin 中获取一个输入的字符
- * 如果当前缓冲区为空，线程会进入等待队列，并挂起自己
- * 在之后的某个时刻被唤醒时，缓冲区必然有字符，就可以顺利返回
+ * 从 stdin 中读取最多 len 个字符，没有可读内容时休眠
+ * 规范模式下一次最多读取一行（含换行符），返回读取的字符数
  */
-char
-popChar()
-{
-    while(1) {
-        // 判断标准输入缓冲区是否有数据
-        if(!isEmpty(&STDIN.buf)) {
-            char ret = (char)popFront(&STDIN.buf);  // 获取数据
-            return ret;
-        } else {
-            // 没有数据则将当前线程加入到等待队列中
-            waitCondition(&STDIN.pushed);
+int
+popChars(char *buf, int len)
+{
+    int n = 0;
+    usize flags = acquireLockIrqsave(&STDIN.lock);
+    __atomic_fetch_add(&STDIN.waiters, 1, __ATOMIC_SEQ_CST);
+    // 先登记为等待者再检查，生产者发布后必然能看到等待者，不会丢失唤醒
+    while(__atomic_load_n(&STDIN.committed, __ATOMIC_SEQ_CST) == STDIN.tail) {
+        waitCondition(&STDIN.pushed, &STDIN.lock);
+    }
+    __atomic_fetch_sub(&STDIN.waiters, 1, __ATOMIC_RELAXED);
+    usize committed = __atomic_load_n(&STDIN.committed, __ATOMIC_ACQUIRE);
+    usize tail = STDIN.tail;
+    while(n < len && tail != committed) {
+        char ch = STDIN.buf[tail % STDIN_BUF];
+        buf[n ++] = ch;
+        tail += 1;
+        if(ch == '\n' && STDIN.mode == TTY_CANONICAL) {
+            break;
         }
     }
+    __atomic_store_n(&STDIN.tail, tail, __ATOMIC_RELEASE);
+    releaseLockIrqrestore(&STDIN.lock, flags);
+    return n;
+}
+
+// 设置终端模式，返回原来的模式；切换到原始模式时，正在编辑的行立即可读
+long
+setTtyMode(int mode)
+{
+    if(mode != TTY_RAW && mode != TTY_CANONICAL) {
+        return -EINVAL;
+    }
+    usize flags = acquireLockIrqsave(&STDIN.input);
+    int old = STDIN.mode;
+    STDIN.mode = mode;
+    if(mode == TTY_RAW && STDIN.head != STDIN.committed) {
+        commit();
+    }
+    releaseLockIrqrestore(&STDIN.input, flags);
+    return old;
+}
+
+// 初始化标准输入缓冲区
+void
+initStdin()
+{
+    initLock(&STDIN.lock, "stdin");
+    initLock(&STDIN.input, "stdin input");
+    STDIN.mode = TTY_CANONICAL;
 }
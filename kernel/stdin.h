@@ -6,7 +6,17 @@
 #ifndef _STDIN_H
 #define _STDIN_H
 
-void pushChar(char ch);
-char popChar();
+#define STDIN_BUF       1024    // 输入环形缓冲区大小，需为 2 的幂
 
-#endif
\ No newline at end of file
+/* 终端模式 */
+#define TTY_RAW         0       // 原始模式：字符到达即可读，不回显、不处理编辑键
+#define TTY_CANONICAL   1       // 规范模式：内核回显并处理退格，整行输入完成后才可读
+
+#define TTY_SETMODE     0x5402  // ioctl 请求：设置终端模式，返回原来的模式
+
+void pushChars(char *buf, int n);
+int  popChars(char *buf, int len);
+long setTtyMode(int mode);
+void initStdin();
+
+#endif
@@ -9,27 +9,306 @@
 #include "stdin.h"
 #include "thread.h"
 #include "fs.h"
+#include "futex.h"
+#include "edf.h"
+#include "ktimer.h"
+#include "log.h"
+#include "uring.h"
+#include "mapping.h"
+#include "consts.h"
+#include "file.h"
+#include "pipe.h"
+#include "shm.h"
+#include "ipc.h"
 
+const usize SYS_IOCTL = 29;
+const usize SYS_CLOSE = 57;
+const usize SYS_PIPE2 = 59;
 const usize SYS_READ = 63;
 const usize SYS_WRITE = 64;
+const usize SYS_VMSPLICE = 75;
 const usize SYS_EXIT = 93;
+const usize SYS_FUTEX_WAIT = 98;
+const usize SYS_FUTEX_WAKE = 99;
+const usize SYS_NANOSLEEP = 101;
+const usize SYS_CLOCK_GETTIME = 113;
+const usize SYS_SYSLOG = 116;
+const usize SYS_SCHED_YIELD = 124;
+const usize SYS_SETPRIORITY = 140;
+const usize SYS_GETTID = 178;
+const usize SYS_SHMGET = 194;
+const usize SYS_SHMAT = 196;
+const usize SYS_SHMDT = 197;
+const usize SYS_CLONE = 220;
 const usize SYS_EXEC     = 221;
+const usize SYS_JOIN = 260;
+const usize SYS_SCHED_SETATTR = 274;
+const usize SYS_SCHED_GETATTR = 275;
+const usize SYS_IO_URING_SETUP = 425;
+const usize SYS_IO_URING_ENTER = 426;
+const usize SYS_IPC_CALL = 500;
+const usize SYS_IPC_REPLY_WAIT = 501;
+const usize SYS_IPC_REPLY = 502;
 
+#define EXEC_PATH_MAX   256     // exec 的路径最大长度（含结尾的 0）
 
-// 只将 READ 系统调用实现读取输入缓冲区的功能，所以 fd 和 len 都不会被使用
-usize
-sysRead(usize fd, uint8 *base, usize len) {
-    *base = (uint8)popChar();
-    return 1;
+
+// 检查当前进程中的用户缓冲区是否可以按 perm 访问
+static int
+checkUserBuffer(usize va, usize len, usize perm)
+{
+    Process *p = getCurrentThread()->process;
+    if(p == 0) {
+        return 0;
+    }
+    Mapping m = satpMapping(p->satp);
+    return checkUserRange(m, va, len, perm);
+}
+
+/*
+ * 在当前进程的用户地址 va 与内核缓冲区 buf 之间拷贝 len 个字节，toUser 为 1 时写入用户空间
+ * 在访问时持有进程锁逐页查页表，系统调用休眠期间同进程的其他线程可能已解除映射（如 shmdt）
+ * 返回：1-成功，0-地址无效
+ */
+static int
+copyUser(usize va, char *buf, usize len, int toUser)
+{
+    Process *p = getCurrentThread()->process;
+    if(p == 0) {
+        return 0;
+    }
+    Mapping m = satpMapping(p->satp);
+    usize flags = acquireLockIrqsave(&p->lock);
+    int ok = toUser ? copyToUser(m, va, buf, len) : copyFromUser(m, buf, va, len);
+    releaseLockIrqrestore(&p->lock, flags);
+    return ok;
+}
+
+// 将当前进程用户地址 va 处以 0 结尾的字符串拷贝到 dst（最多 max 字节），返回长度，地址无效或过长时返回 -1
+static long
+copyUserString(usize va, char *dst, usize max)
+{
+    Process *p = getCurrentThread()->process;
+    if(p == 0) {
+        return -1;
+    }
+    Mapping m = satpMapping(p->satp);
+    usize flags = acquireLockIrqsave(&p->lock);
+    long n = copyStringFromUser(m, dst, va, max);
+    releaseLockIrqrestore(&p->lock, flags);
+    return n;
 }
 
-// 执行程序
+// 获取当前进程中描述符 fd 对应的文件并增加引用，fd 无效返回 0
+static File *
+currentFile(usize fd)
+{
+    if(fd >= MAX_FDS) {
+        return 0;
+    }
+    return fileOfFd(getCurrentThread(), (int)fd);
+}
+
+// 从 fd 读取最多 len 个字节（一次最多一页），没有数据时等待，之后只返回已经到达的字节
+// 数据先读到内核的中转页，再拷贝到用户缓冲区
+// 返回读取的字节数，管道的写端全部关闭且没有数据时返回 0，fd 不可读时返回 -EBADF
+long
+sysRead(usize fd, char *buf, usize len)
+{
+    File *f = currentFile(fd);
+    if(f == 0 || !f->readable) {
+        if(f != 0) putFile(f);
+        return -EBADF;
+    }
+    long ret = 0;
+    if(!checkUserBuffer((usize)buf, len, WRITABLE)) {
+        ret = -EFAULT;
+    } else if(len > 0) {
+        usize frame = allocFrame();
+        char *bounce = (char *)accessVaViaPa(frame);
+        usize n = len < PAGE_SIZE ? len : PAGE_SIZE;
+        if(f->type == FILE_PIPE) {
+            ret = pipeRead(f->pipe, bounce, n);
+        } else {
+            ret = popChars(bounce, (int)n);
+        }
+        if(ret > 0 && !copyUser((usize)buf, bounce, ret, 1)) {
+            ret = -EFAULT;
+        }
+        deallocFrame(frame);
+    }
+    putFile(f);
+    return ret;
+}
+
+// 向 fd 写入 len 个字节，写入管道或控制台时空间不足会等待
+// 每次从用户缓冲区拷贝一页到内核的中转页再写入，一页以内的写入不会与其他输出交错
+// 返回写入的字节数，中途地址失效或管道读端关闭时返回已写入的字节数
+long
+sysWrite(usize fd, char *buf, usize len)
+{
+    File *f = currentFile(fd);
+    if(f == 0 || !f->writable) {
+        if(f != 0) putFile(f);
+        return -EBADF;
+    }
+    long ret = 0;
+    if(!checkUserBuffer((usize)buf, len, READABLE)) {
+        ret = -EFAULT;
+    } else if(len > 0) {
+        usize frame = allocFrame();
+        char *bounce = (char *)accessVaViaPa(frame);
+        usize done = 0;
+        while(done < len) {
+            usize n = len - done < PAGE_SIZE ? len - done : PAGE_SIZE;
+            if(!copyUser((usize)buf + done, bounce, n, 0)) {
+                ret = -EFAULT;
+                break;
+            }
+            if(f->type == FILE_PIPE) {
+                long k = pipeWrite(f->pipe, bounce, n);
+                if(k < 0) {
+                    ret = k;
+                    break;
+                }
+                done += k;
+                if((usize)k < n) {
+                    break;      // 读端已关闭
+                }
+            } else {
+                consoleWriteSleep(bounce, n);
+                done += n;
+            }
+        }
+        if(done > 0) {
+            ret = done;
+        }
+        deallocFrame(frame);
+    }
+    putFile(f);
+    return ret;
+}
+
+// 读取保留的内核日志到用户缓冲区 buf，最多 len 字节：先读到内核缓冲区再拷贝，返回拷贝的字节数
+static long
+sysReadLog(usize buf, usize len)
+{
+    if(!checkUserBuffer(buf, len, WRITABLE)) {
+        return -EFAULT;
+    }
+    if(len > LOG_READ_MAX) {
+        len = LOG_READ_MAX;
+    }
+    if(len == 0) {
+        return 0;
+    }
+    char *kbuf = tryKalloc(len);
+    if(kbuf == 0) {
+        return -ENOMEM;
+    }
+    long n = syslog(SYSLOG_READ_ALL, kbuf, len);
+    if(n > 0 && !copyUser(buf, kbuf, n, 1)) {
+        n = -EFAULT;
+    }
+    kfree(kbuf);
+    return n;
+}
+
+// 创建管道，读端和写端的描述符写入 fds[0]、fds[1]
+static long
+sysPipe(int *fds)
+{
+    Thread *self = getCurrentThread();
+    if(!checkUserBuffer((usize)fds, 2 * sizeof(int), WRITABLE)) {
+        return -EFAULT;
+    }
+    File *in, *out;
+    newPipe(&in, &out);
+    int rfd = allocFd(self, in);
+    if(rfd < 0) {
+        putFile(in);
+        putFile(out);
+        return rfd;
+    }
+    int wfd = allocFd(self, out);
+    if(wfd < 0) {
+        deallocFd(self, rfd);
+        putFile(out);
+        return wfd;
+    }
+    int res[2] = {rfd, wfd};
+    if(!copyUser((usize)fds, (char *)res, sizeof(res), 1)) {
+        // 检查之后被同进程的其他线程解除了映射
+        deallocFd(self, rfd);
+        deallocFd(self, wfd);
+        return -EFAULT;
+    }
+    return 0;
+}
+
+// 按页传递管道数据：fd 为写端时交出 [addr, addr + len) 的页，为读端时将数据页映射到该范围
+// addr 和 len 需按页对齐
+static long
+sysVmsplice(usize fd, usize addr, usize len)
+{
+    if((addr | len) & (PAGE_SIZE - 1)) {
+        return -EINVAL;
+    }
+    File *f = currentFile(fd);
+    if(f == 0 || f->type != FILE_PIPE) {
+        if(f != 0) putFile(f);
+        return -EBADF;
+    }
+    long ret;
+    if(!checkUserBuffer(addr, len, READABLE | WRITABLE)) {
+        ret = -EFAULT;
+    } else if(f->writable) {
+        ret = pipeGift(f->pipe, addr, len);
+    } else {
+        ret = pipeMap(f->pipe, addr, len);
+    }
+    putFile(f);
+    return ret;
+}
+
+// 执行程序并等待其退出
+// stdio 不为 0 时，其中的两个描述符（为负数时保持控制台）作为新进程的标准输入、标准输出
+// 这两个描述符移交给新进程，在本进程中被关闭，新进程退出后管道的对端才能读到结束
 usize
-sysExec(char *path)
+sysExec(char *upath, int *stdio)
 {
-    if(executeCPU(path, getCurrentTid())) {
+    Thread *self = getCurrentThread();
+    int fds[2] = {-1, -1};
+    File *files[2] = {0, 0};
+    int i;
+    char path[EXEC_PATH_MAX];
+    if(copyUserString((usize)upath, path, EXEC_PATH_MAX) < 0) {
+        return -EFAULT;
+    }
+    if(stdio != 0) {
+        if(!copyUser((usize)stdio, (char *)fds, sizeof(fds), 0)) {
+            return -EFAULT;
+        }
+        for(i = 0; i < 2; i ++) {
+            if(fds[i] >= 0 && (files[i] = fileOfFd(self, fds[i])) == 0) {
+                if(i == 1 && files[0] != 0) putFile(files[0]);
+                return -EBADF;
+            }
+        }
+    }
+    // 先标记休眠再创建子线程，子线程在其他 hart 上很快退出时唤醒也不会丢失
+    prepareSleepCPU();
+    if(executeCPU(path, getCurrentTid(), files[0], files[1])) {
+        for(i = 0; i < 2; i ++) {
+            if(fds[i] >= 0) deallocFd(self, fds[i]);
+        }
         // 若执行成功则让当前进程进入休眠
         yieldCPU();
+    } else {
+        wakeupCPU(getCurrentTid());     // 执行失败，撤销休眠
+        for(i = 0; i < 2; i ++) {
+            if(files[i] != 0) putFile(files[i]);
+        }
     }
     return 0;
 }
@@ -40,17 +319,100 @@ syscall(usize id, usize args[3], InterruptContext *context)
 {
     switch (id)
     {
-    case SYS_WRITE:     // 系统写
-        consolePutchar(args[0]);
-        return 0;
+    case SYS_WRITE:     // 向 fd 写入缓冲区 (fd, buf, len)
+        return sysWrite(args[0], (char *)args[1], args[2]);
     case SYS_EXIT:      // 系统线程退出
         exitFromCPU(args[0]);
         return 0;
-    case SYS_READ:      // 系统读
-        return sysRead(args[0], (uint8 *)args[1], args[2]);
-    case SYS_EXEC:      // 系统执行
-        sysExec((char *)args[0]);
+    case SYS_IOCTL:     // 设备控制 (fd, request, arg)，目前只支持设置标准输入的终端模式
+        if(args[0] != 0) {
+            return -EBADF;
+        }
+        if(args[1] != TTY_SETMODE) {
+            return -EINVAL;
+        }
+        return setTtyMode((int)args[2]);
+    case SYS_READ:      // 从 fd 读取到缓冲区 (fd, buf, len)
+        return sysRead(args[0], (char *)args[1], args[2]);
+    case SYS_CLOSE:     // 关闭文件描述符 (fd)
+        if(args[0] >= MAX_FDS) {
+            return -EBADF;
+        }
+        return deallocFd(getCurrentThread(), (int)args[0]);
+    case SYS_PIPE2:     // 创建管道 (fds)
+        return sysPipe((int *)args[0]);
+    case SYS_VMSPLICE:  // 按页传递管道数据 (fd, addr, len)
+        return sysVmsplice(args[0], args[1], args[2]);
+    case SYS_FUTEX_WAIT:    // 若 futex 字仍为期望值则休眠 (uaddr, expected, 超时纳秒数或 0)
+        return futexWait(args[0], (uint32)args[1], args[2]);
+    case SYS_FUTEX_WAKE:    // 唤醒等待在 futex 字上的线程
+        return futexWake(args[0], (int)args[1]);
+    case SYS_NANOSLEEP:     // 休眠 (秒, 纳秒)，期间不占用 CPU
+        // 纳秒数不小于 1 秒或总纳秒数溢出时拒绝，不会回绕成很短的休眠
+        if(args[1] >= 1000000000 || args[0] > (-1UL - args[1]) / 1000000000) {
+            return -EINVAL;
+        }
+        sleepNs(args[0] * 1000000000 + args[1]);
         return 0;
+    case SYS_CLOCK_GETTIME: // 读取单调时钟，返回启动以来的纳秒数
+        return monotonicNs();
+    case SYS_SYSLOG:    // 读取内核日志或设置控制台日志级别 (type, buf, len)
+        if(args[0] == SYSLOG_READ_ALL) {
+            return sysReadLog(args[1], args[2]);
+        }
+        return syslog((int)args[0], 0, args[2]);
+    case SYS_SCHED_YIELD:   // 让出 CPU，实时线程表示本周期作业完成
+        schedYieldCPU();
+        return 0;
+    case SYS_SCHED_SETATTR: // 设置当前线程的实时参数 (runtime, period, deadline)
+        return edfSetAttr(args[0], args[1], args[2]);
+    case SYS_SCHED_GETATTR: // 读取当前线程的实时参数和截止时刻统计
+    {
+        SchedAttr attr;
+        if(!checkUserBuffer(args[0], sizeof(SchedAttr), WRITABLE)) {
+            return -EFAULT;
+        }
+        long ret = edfGetAttr(&attr);
+        if(ret == 0 && !copyUser(args[0], (char *)&attr, sizeof(attr), 1)) {
+            return -EFAULT;
+        }
+        return ret;
+    }
+    case SYS_SETPRIORITY:   // 设置线程的 nice 值
+        return setPriorityCPU((int)args[0], (int)args[1]);
+    case SYS_GETTID:    // 获取当前线程的线程号
+        return getCurrentThreadId();
+    case SYS_SHMGET:    // 按名字创建或打开共享内存段 (name, len, size)，返回段号
+    {
+        char name[SHM_NAME_MAX];
+        if(args[1] == 0 || args[1] >= SHM_NAME_MAX) {
+            return -EINVAL;
+        }
+        if(!copyUser(args[0], name, args[1], 0)) {
+            return -EFAULT;
+        }
+        return shmCreate(name, args[1], args[2]);
+    }
+    case SYS_SHMAT:     // 映射共享内存段 (id, addr)，addr 为 0 时由内核选择，返回映射地址
+        return shmAttach((int)args[0], args[1]);
+    case SYS_SHMDT:     // 解除共享内存段的映射 (addr)
+        return shmDetach(args[0]);
+    case SYS_CLONE:     // 在当前进程中创建线程
+        return cloneCPU(args[0], args[1], args[2]);
+    case SYS_JOIN:      // 等待同一进程中的线程退出
+        return joinThread((int)args[0]);
+    case SYS_EXEC:      // 执行程序并等待其退出 (path, stdio)
+        return sysExec((char *)args[0], (int *)args[1]);
+    case SYS_IO_URING_SETUP:    // 创建异步系统调用的环形队列 (flags)，返回共享区地址
+        return setupRing(args[0]);
+    case SYS_IO_URING_ENTER:    // 提交请求并等待完成 (toSubmit, minComplete, flags)
+        return enterRing(args[0], args[1], args[2]);
+    case SYS_IPC_CALL:  // 发送请求并等待回复 (port, a1 ~ a4 为消息)，回复写回 a1 ~ a4
+        return ipcCall((int)args[0], context);
+    case SYS_IPC_REPLY_WAIT:    // 回复并等待下一个请求 (port, a1 ~ a4 为回复, a5 为回复对象或 -1)，返回请求者线程号
+        return ipcReplyWait((int)args[0], (long)context->x[15], context);
+    case SYS_IPC_REPLY: // 只回复不等待 (port, a1 ~ a4 为回复, a5 为回复对象)
+        return ipcReply((int)args[0], (long)context->x[15], context);
     default:
         printf("Unknown syscall id %d\n", id);
         panic("");
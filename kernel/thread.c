@@ -11,16 +11,91 @@
 #include "mapping.h"
 #include "elf.h"
 #include "fs.h"
+#include "edf.h"
+#include "vdso.h"
+#include "fpu.h"
+
+/*
+ * 内核栈没有保护页，栈底放几个魔数，线程每次被换下时检查，溢出时立即 panic 而不是悄悄破坏相邻的堆内存
+ * 栈由 kalloc 清零，释放时从栈底向上找到第一个非零字，即可得到该线程用过的最大栈深度
+ */
+#define KSTACK_CANARY_WORDS 4
+#define KSTACK_MAGIC        0x57ac4ca7a12c0deUL
+
+static struct {
+    int live;           // 已分配的内核栈数，不超过 MAX_KERNEL_STACKS
+    int rejected;       // 因数量达到上限或堆空间不足而拒绝创建的线程数
+    usize maxDepth;     // 已释放的内核栈中用过的最大深度（字节）
+} KSTACKS;
 
 /*
  * 构建内核线程的内核栈
- * 输出栈空间的起始地址
+ * 输出栈空间的起始地址，内核栈数达到上限或堆空间不足时返回 0
  */
 usize newKernelStack()
 {
+    if (__atomic_add_fetch(&KSTACKS.live, 1, __ATOMIC_RELAXED) > MAX_KERNEL_STACKS)
+    {
+        __atomic_sub_fetch(&KSTACKS.live, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&KSTACKS.rejected, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
     /* 将内核线程的线程栈分配在内核堆中 */
-    usize bottom = (usize)kalloc(KERNEL_STACK_SIZE); // 在内核堆上分配内存
-    return bottom;
+    usize *bottom = tryKalloc(KERNEL_STACK_SIZE); // 在内核堆上分配内存
+    if (bottom == 0)
+    {
+        __atomic_sub_fetch(&KSTACKS.live, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&KSTACKS.rejected, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+    int i;
+    for (i = 0; i < KSTACK_CANARY_WORDS; i++)
+    {
+        bottom[i] = KSTACK_MAGIC;
+    }
+    return (usize)bottom;
+}
+
+// 检查线程的内核栈底的魔数是否完好，被覆盖说明栈已溢出
+void checkKernelStack(Thread *thread)
+{
+    usize *bottom = (usize *)thread->kstack;
+    if (bottom == 0)
+        return;     // 启动线程使用启动栈
+    int i;
+    for (i = 0; i < KSTACK_CANARY_WORDS; i++)
+    {
+        if (bottom[i] != KSTACK_MAGIC)
+        {
+            panic("Kernel stack overflow!\n");
+        }
+    }
+}
+
+// 释放内核栈，并记录它用过的最大深度
+void freeKernelStack(usize kstack)
+{
+    if (kstack == 0)
+        return;
+    usize *word = (usize *)kstack + KSTACK_CANARY_WORDS;
+    usize *top = (usize *)(kstack + KERNEL_STACK_SIZE);
+    while (word < top && *word == 0)
+        word++;
+    usize depth = (usize)top - (usize)word;
+    usize old = __atomic_load_n(&KSTACKS.maxDepth, __ATOMIC_RELAXED);
+    while (depth > old && !__atomic_compare_exchange_n(&KSTACKS.maxDepth, &old, depth, 0,
+                                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+    kfree((void *)kstack);
+    __atomic_sub_fetch(&KSTACKS.live, 1, __ATOMIC_RELAXED);
+}
+
+// 输出内核栈的使用情况
+void printKernelStackStats()
+{
+    printf("kernel stacks: live %d / %d, rejected %d, max depth %d / %d bytes\n",
+           KSTACKS.live, MAX_KERNEL_STACKS, KSTACKS.rejected,
+           (int)KSTACKS.maxDepth, KERNEL_STACK_SIZE);
 }
 
 /*
@@ -71,14 +146,15 @@ usize newKernelThreadContext(usize entry, usize kernelStackTop, usize satp)
     /* 开启 新线程 异步中断使能 */
     ic.sstatus |= SSTATUS_SPIE; // 保存中断处理发生前的SIE值
     ic.sstatus &= ~SSTATUS_SIE; // 禁用中断使能，因为下文将借助中断恢复机制
+    ic.sstatus &= ~(SSTATUS_FS | SSTATUS_VS);   // 内核线程不使用浮点和向量单元
     // ！下文借助中断恢复机制，即将SIE=SPIE，成功设置中断使能
     // 创建新线程
     ThreadContext tc;
     // 借助中断的恢复机制，来初始化新线程的每个寄存器，从 Context 中恢复所有寄存器
-    extern void __restore();
-    tc.ra = (usize)__restore;
+    extern void __threadStart();
+    tc.ra = (usize)__threadStart;
     // 即 switchContext切换完后回收ra、satp、s[12]，栈顶只剩tc.ic，和中断处理程序返回是一样的
-    // 所以设置 switchContext 的返回地址为__restore，借助中断恢复机制来恢复所有寄存器
+    // 所以设置 switchContext 的返回地址为__threadStart，完成切换收尾后借助中断恢复机制（__restore）来恢复所有寄存器
     tc.satp = satp; // 设置页表
     tc.ic = ic;
     return pushContextToStack(tc, kernelStackTop);
@@ -94,6 +170,7 @@ usize newUserThreadContext(usize entry, usize ustackTop, usize kstackTop, usize
 {
     InterruptContext ic;
     ic.x[2] = ustackTop; // 设置sp寄存器为用户栈顶
+    ic.x[4] = 0;         // tp 为线程局部存储地址，主线程没有
     ic.sepc = entry;     // 中断返回地址为线程入口点
     ic.sstatus = r_sstatus();
     // 设置返回后的特权级为 U-Mode
@@ -101,14 +178,16 @@ usize newUserThreadContext(usize entry, usize ustackTop, usize kstackTop, usize
     // 异步中断使能
     ic.sstatus |= SSTATUS_SPIE;
     ic.sstatus &= ~SSTATUS_SIE;
+    ic.sstatus &= ~(SSTATUS_FS | SSTATUS_VS);   // 浮点单元在第一次使用时才打开（见 fpu.c）
     // 创新新线程上下文
     ThreadContext tc;
     // 借助中断的恢复机制，来初始化新线程的每个寄存器，从 Context 中恢复所有寄存器
-    extern void __restore();
-    tc.ra = (usize)__restore;
+    extern void __threadStart();
+    tc.ra = (usize)__threadStart;
     tc.satp = satp; // 设置页表
     tc.ic = ic;
-    return pushContextToStack(tc, kstackTop);
+    // 从 U-Mode 进入内核时 Context 位于内核栈顶保留区之下，初始 Context 也放在同一位置
+    return pushContextToStack(tc, kstackTop - KSTACK_TRAP_RESERVE);
 }
 
 // 为线程传入初始化参数
@@ -128,21 +207,26 @@ void appendArguments(Thread *thread, usize args[8])
 
 /*
  * 创建新的内核线程
- * 创建内核栈，创建上下文
+ * 创建内核栈，创建上下文，内核栈分配失败时返回的线程 kstack 为 0
  */
 Thread
 newKernelThread(usize entry)
 {
     // 构建内核线程的内核栈
     usize stackBottom = newKernelStack();
+    if (stackBottom == 0)
+    {
+        Thread t = {0, 0, 0, -1, -1};
+        return t;
+    }
     // 创建新的内核线程上下文
     usize contextAddr = newKernelThreadContext(
         entry,                           // 线程入口点
         stackBottom + KERNEL_STACK_SIZE, // 内核栈顶
         r_satp()                         // 创建的内核线程与启动线程同属于一个进程，所以直接获取satp赋值
     );
-    Thread t = {// 线程上下文地址， 线程栈底地址
-                contextAddr, stackBottom};
+    Thread t = {// 线程上下文地址， 线程栈底地址， 所属进程， 等待线程， 用户栈槽位
+                contextAddr, stackBottom, 0, -1, -1};
     return t;
 }
 
@@ -168,10 +252,18 @@ void mapFramedSegment(Mapping m, Segment segment)
 /*
  * 创建新的用户线程
  * 加载ELF用户程序，创建用户栈，创建内核栈，创建上下文
+ * 内核栈分配失败时不创建进程，返回的线程 kstack 为 0
  */
 Thread
 newUserThread(char *data)
 {
+    // 构建用户线程的内核栈，先于地址空间分配，失败时无需回收
+    usize kstack = newKernelStack();
+    if (kstack == 0)
+    {
+        Thread t = {0, 0, 0, -1, -1};
+        return t;
+    }
     // 解析 ELF 文件，完成内核和可执行程序各个段的映射,data为指向 ELF 文件的首字节的指针
     Mapping m = newUserMapping(data);
     usize ustackBottom = USER_STACK_OFFSET;                // 用户栈底
@@ -179,19 +271,48 @@ newUserThread(char *data)
     // 将用户栈映射到未被分配物理内存的段(添加到页表上、分配物理页映射)
     Segment s = {ustackBottom, ustackTop, 1L | USER | READABLE | WRITABLE};
     mapFramedSegment(m, s);
+    // 只读映射共享数据页，用户程序直接读取时钟参数和调度统计
+    mapVdso(m.rootPpn);
 
-    // 构建用户线程的内核栈
-    usize kstack = newKernelStack();
     usize entryAddr = ((ElfHeader *)data)->entry;
-    Process p = {m.rootPpn | (8L << 60)}; // 构造进程（根页表地址，mode为sv39）
+    Process *p = newProcess(m.rootPpn | (8L << 60)); // 构造进程（根页表地址，mode为sv39）
     // 创建新的用户线程上下文
     usize context = newUserThreadContext(
         entryAddr,                  // 线程入口点
         ustackTop,                  // 用户线程栈顶
         kstack + KERNEL_STACK_SIZE, // 内核线程线程栈顶
-        p.satp                      // 内核线程页表
+        p->satp                     // 内核线程页表
     );
-    Thread t = {context, kstack, p}; // 线程上下文地址，线程栈底地址，所属进程
+    Thread t = {context, kstack, p, -1, 0}; // 线程上下文地址，线程栈底地址，所属进程，等待线程，用户栈槽位
+    return t;
+}
+
+/*
+ * 在已有进程中创建新的用户线程，与进程中其他线程共享地址空间
+ * slot 为已分配并映射好用户栈的槽位，新线程从 entry 开始执行，a0 为 arg，tp 为线程局部存储地址 tls
+ * 调用者需已为新线程增加进程引用，内核栈分配失败时返回的线程 kstack 为 0
+ */
+Thread
+newCloneThread(Process *process, int slot, usize entry, usize arg, usize tls)
+{
+    usize ustackBottom, ustackTop;
+    userStackRange(slot, &ustackBottom, &ustackTop);
+    usize kstack = newKernelStack();
+    if (kstack == 0)
+    {
+        Thread t = {0, 0, process, -1, slot};
+        return t;
+    }
+    usize context = newUserThreadContext(
+        entry,
+        ustackTop,
+        kstack + KERNEL_STACK_SIZE,
+        process->satp
+    );
+    ThreadContext *tc = (ThreadContext *)context;
+    tc->ic.x[10] = arg;     // a0
+    tc->ic.x[4] = tls;      // tp，返回 U-Mode 时由 __restore 恢复
+    Thread t = {context, kstack, process, -1, slot};
     return t;
 }
 
@@ -235,7 +356,10 @@ newBootThread()
     Thread t;
     t.contextAddr = 0L;
     t.kstack = 0L;
+    t.process = 0;
     t.wait = -1;
+    t.ustackSlot = -1;
+    t.fp = 0;
     return t;
 }
 
@@ -243,22 +367,85 @@ newBootThread()
 ThreadPool
 newThreadPool(Scheduler scheduler)
 {
+    // 线程表在第一次添加线程时才开始分配，此时线程池已经拷贝到最终位置
     ThreadPool pool;
+    pool.chunks = 0;
+    pool.freeHead = -1;
     pool.scheduler = scheduler;
     return pool;
 }
 
+// 启动时选择的调度算法，编译时由 Makefile 的 SCHED 变量指定
+#ifndef SCHED_POLICY
+#define SCHED_POLICY "rr"
+#endif
+
+// 可选的调度算法实现
+static struct {
+    char *name;
+    Scheduler scheduler;
+} SCHEDULERS[] = {
+    {"rr",   {schedulerInit, schedulerPush, schedulerPop, schedulerTick, schedulerExit, 0, schedulerNeedTick, 0}},
+    {"mlfq", {mlfqInit, mlfqPush, mlfqPop, mlfqTick, mlfqExit, 0, mlfqNeedTick, mlfqWake}},
+    {"fair", {fairInit, fairPush, fairPop, fairTick, fairExit, fairSetPriority, fairNeedTick, 0}},
+};
+
+// 根据名称查找调度算法，找不到时使用 RR
+Scheduler
+findScheduler(char *name)
+{
+    int i;
+    for (i = 0; i < sizeof(SCHEDULERS) / sizeof(SCHEDULERS[0]); i++)
+    {
+        if (!strcmp(SCHEDULERS[i].name, name))
+        {
+            return SCHEDULERS[i].scheduler;
+        }
+    }
+    printf("Unknown scheduler %s, fallback to rr\n", name);
+    return SCHEDULERS[0].scheduler;
+}
+
+// 启动时运行的内核微基准，编译时由 Makefile 的 BENCH 变量指定，默认不运行
+#ifndef BOOT_BENCH
+#define BOOT_BENCH ""
+#endif
+
+// 可选的内核微基准
+static struct {
+    char *name;
+    void (*entry)();
+} BENCHES[] = {
+    {"ctxswitch", benchContextSwitch},  // 上下文切换往返（需 CPUS=1）
+    {"timer", benchTimerProgram},       // 设置时钟中断的开销（stimecmp 与 SBI）
+};
+
+// 按名称把微基准作为内核线程加入调度，名称为空时不运行
+static void
+startBootBench(char *name)
+{
+    if (name[0] == 0)
+        return;
+    int i;
+    for (i = 0; i < sizeof(BENCHES) / sizeof(BENCHES[0]); i++)
+    {
+        if (!strcmp(BENCHES[i].name, name))
+        {
+            addToCPU(newKernelThread((usize)BENCHES[i].entry));
+            return;
+        }
+    }
+    printf("Unknown benchmark %s\n", name);
+}
+
 // 初始化线程
 void initThread()
 {
     // 1.创建调度函数实现
-    Scheduler s = {
-        schedulerInit,
-        schedulerPush,
-        schedulerPop,
-        schedulerTick,
-        schedulerExit};
+    // 实时调度类（EDF）包装选定的普通调度算法，实时线程总是先于普通线程运行
+    Scheduler s = edfWrap(findScheduler(SCHED_POLICY));
     s.init(); // 初始化调度器
+    printf("***** scheduler: %s *****\n", SCHED_POLICY);
     // 2.创建线程池
     ThreadPool pool = newThreadPool(s);
     // 3.构建idle调度线程
@@ -276,6 +463,7 @@ void initThread()
     //     // 6.启动
     //     addToCPU(t); // 将线程添加到调度队列中
     // }
+    startBootBench(BOOT_BENCH);
 
     // 从文件系统中读取 elf 文件
     Inode *helloInode = lookup(0, "/bin/sh");     // 查找文件inode
@@ -286,6 +474,15 @@ void initThread()
     addToCPU(t);                                    // 添加到线程池
     printf("***** init thread *****\n");
 }
+
+// 其他 hart 初始化线程管理
+// 线程池和调度器已由启动 hart 创建，只需构建本 hart 自己的 idle 调度线程
+void initHartThread()
+{
+    Thread idle = newKernelThread((usize)idleMain);
+    initSecondaryCPU(idle);
+    printf("***** hart %d online *****\n", cpuid());
+}
 // 测试线程切换 5.4
 // void
 // initThread()
@@ -304,69 +501,172 @@ void initThread()
 //     printf("I'm back from tempThread!\n");
 // }
 
-// 遍历线程池，寻找未被使用的tid
-int allocTid(ThreadPool *pool)
+/*
+ * 线程表增长一块（需持有线程池锁），新槽位全部加入空闲链表
+ * 先发布块指针再增加块数，无锁读者按块数遍历时不会访问到未初始化的块
+ * 返回 0 表示已达到 MAX_LIVE_THREADS 或内存不足
+ */
+static int
+growPool(ThreadPool *pool)
 {
+    int chunk = pool->chunks;
+    if (chunk == THREAD_CHUNKS)
+    {
+        return 0;
+    }
+    ThreadHot *hot = tryKalloc(sizeof(ThreadHot) * THREAD_CHUNK);
+    ThreadInfo *cold = tryKalloc(sizeof(ThreadInfo) * THREAD_CHUNK);
+    if (hot == 0 || cold == 0)
+    {
+        kfree(hot);
+        kfree(cold);
+        return 0;
+    }
     int i;
-    for (i = 0; i < MAX_THREAD; i++)
+    for (i = THREAD_CHUNK - 1; i >= 0; i--)
+    {
+        int tid = chunk * THREAD_CHUNK + i;
+        hot[i].status = Exited;
+        hot[i].occupied = 0;
+        hot[i].running = 0;
+        hot[i].hart = 0;
+        hot[i].wakeNext = -1;
+        hot[i].generation = 0;
+        hot[i].nextFree = pool->freeHead;
+        pool->freeHead = tid;
+        cold[i].tid = tid;
+        cold[i].pool = pool;
+    }
+    __atomic_store_n(&pool->hot[chunk], hot, __ATOMIC_RELEASE);
+    __atomic_store_n(&pool->cold[chunk], cold, __ATOMIC_RELEASE);
+    __atomic_store_n(&pool->chunks, chunk + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// 从空闲链表取出一个未被使用的 tid（需持有线程池锁），空闲链表为空时线程表增长一块
+// 线程数已达 MAX_LIVE_THREADS 或内存不足时返回 -1
+int allocTid(ThreadPool *pool)
+{
+    // 已退出线程的槽位在 RCU 宽限期结束后才会回到空闲链表（见 reclaimThreadSlot）
+    if (pool->freeHead == -1 && !growPool(pool))
     {
-        if (!pool->threads[i].occupied)
-            return i;
+        return -1;
     }
-    panic("Alloc tid failed!\n");
-    return -1;
+    int tid = pool->freeHead;
+    pool->freeHead = threadHot(pool, tid)->nextFree;
+    return tid;
 }
 
-// 将线程添加到线程池中
-void addToPool(ThreadPool *pool, Thread thread)
+// 将线程添加到线程池中，返回对外的线程号，线程池已满时返回 -EAGAIN
+// 线程池锁只保护槽位和状态，释放后再将线程加入本 hart 的就绪队列（由调度器的队列锁保护）
+int addToPool(ThreadPool *pool, Thread thread)
 {
-    int tid = allocTid(pool); // 遍历线程池，寻找未使用tid
+    usize flags = disable_and_store();
+    acquireLock(&pool->lock);
+    int tid = allocTid(pool); // 从空闲链表取出一个 tid
+    if (tid == -1)
+    {
+        releaseLock(&pool->lock);
+        restore_sstatus(flags);
+        return -EAGAIN;
+    }
     // 配置线程信息
-    pool->threads[tid].status = Ready;  // 就绪
-    pool->threads[tid].occupied = 1;    // 占用
-    pool->threads[tid].thread = thread; // 线程上下文地址和栈底地址
+    ThreadHot *th = threadHot(pool, tid);
+    th->generation += 1;            // 槽位被复用，之前的线程号失效
+    th->status = Ready;             // 就绪
+    th->hart = cpuid();             // 新线程先加入创建它的 hart 的就绪队列
+    th->wakeNext = -1;
+    th->running = 0;
+    threadInfo(pool, tid)->thread = thread; // 线程上下文地址和栈底地址
+    __atomic_store_n(&th->occupied, 1, __ATOMIC_RELEASE);   // 占用，无锁读者此后才能看到该线程
+    int id = THREAD_ID(th->generation, tid);
+    if (thread.process != 0 && thread.ustackSlot >= 0)
+    {
+        thread.process->slots[thread.ustackSlot].tid = id; // 供 join 按线程号查找
+    }
+    releaseLock(&pool->lock);
     pool->scheduler.push(tid);          // 将线程加入参与调度
+    restore_sstatus(flags);
+    return id;
 }
 
 // 向线程池获取一个可以运行的线程，若没有返回-1
+// 出队（及窃取）只持有调度器的队列锁；出队的线程已不在任何就绪队列中，其他 hart 不会再选中它
 RunningThread
 acquireFromPool(ThreadPool *pool)
 {
+    usize flags = disable_and_store();
     int tid = pool->scheduler.pop(); // 从就绪线程中获取一个可运行线程
     RunningThread rt;
     rt.tid = tid;
+    rt.thread = 0;
     if (tid != -1)
     {
-        ThreadInfo *ti = &pool->threads[tid]; // 从线程池取出线程
-        // 修改取出线程在线程池的状态（上行代码用&引用传入的）
-        ti->status = Running; // 由于调用该函数的下一步就要直接切换到这个线程，所以在线程池中直接标记为 Running 状态
-        ti->tid = tid;        // 线程ID（因为将线程添加到线程池中时没用设置ThreadInfo.tid，所以这里初始化）
-        rt.thread = ti->thread;
+        acquireLock(&pool->lock);
+        ThreadHot *th = threadHot(pool, tid); // 从线程池取出线程
+        th->status = Running; // 由于调用该函数的下一步就要直接切换到这个线程，所以在线程池中直接标记为 Running 状态
+        th->hart = cpuid();   // 记录运行所在的 hart（可能是从其他 hart 窃取来的）
+        th->running = 1;
+        releaseLock(&pool->lock);
+        rt.thread = &threadInfo(pool, tid)->thread;
     }
+    restore_sstatus(flags);
     return rt;
 }
 
-// 修改线程池内的线程信息：在一个线程停止运行，切换回调度线程后调用
+// RCU 回调：所有可能看到已退出线程的读者都已离开读临界区，回收内核栈并将槽位放回空闲链表
+static void
+reclaimThreadSlot(RcuHead *head)
+{
+    ThreadInfo *ti = CONTAINER_OF(head, ThreadInfo, rcu);
+    ThreadPool *pool = ti->pool;
+    // 回收栈空间（传入栈底地址，根据HEAP维护的二叉树，即可知道回收多大空间）
+    freeKernelStack(ti->thread.kstack);
+    fpFree(&ti->thread);
+    // 释放进程引用，进程中最后一个线程被回收时销毁地址空间
+    if (ti->thread.process != 0)
+    {
+        putProcess(ti->thread.process);
+    }
+    usize flags = acquireLockIrqsave(&pool->lock);
+    ThreadHot *th = threadHot(pool, ti->tid);
+    th->occupied = 0;
+    th->nextFree = pool->freeHead;
+    pool->freeHead = ti->tid;
+    releaseLockIrqrestore(&pool->lock, flags);
+}
+
+// 修改线程池内的线程信息：在一个线程停止运行、上下文保存之后调用
 // 线程停止运行有两种情况
 //      一种是线程运行结束
 //      一种是还没有运行完，但是时间片用尽，这种情况就需要重新将线程加入调度器
+// 线程上下文在切换时已直接保存到线程表中
 void retrieveToPool(ThreadPool *pool, RunningThread rt)
 {
     int tid = rt.tid;
-    // 若线程不被占用了，即线程运行结束
-    if (!pool->threads[tid].occupied)
+    checkKernelStack(rt.thread);    // 线程刚被换下，检查它的内核栈是否溢出
+    usize flags = acquireLockIrqsave(&pool->lock);
+    ThreadHot *th = threadHot(pool, tid);
+    th->running = 0;        // 上下文已经保存，其他 hart 可以运行它了
+    // 线程运行结束，内核栈已不再使用
+    // 无锁读者可能还持有该槽位，等宽限期结束后再回收栈空间并释放槽位
+    if (th->status == Exited)
     {
-        // 表明刚刚这个线程退出了，回收栈空间（传入栈底地址，根据HEAP维护的二叉树，即可知道回收多大空间）
-        kfree((void *)pool->threads[tid].thread.kstack);
+        releaseLockIrqrestore(&pool->lock, flags);
+        callRcu(&threadInfo(pool, tid)->rcu, reclaimThreadSlot);
         return;
     }
-    // 线程时间片用完，重新加入调度器
-    ThreadInfo *ti = &pool->threads[tid];
-    ti->thread = rt.thread; // 更新线程上下文、栈地址
-    if (ti->status == Running)
+    // 状态仍为 Running 有两种情况：时间片用完，或准备休眠时已经被唤醒
+    // 由 Running 改为 Ready 的一方负责入队，入队在释放线程池锁之后进行
+    int requeue = th->status == Running;
+    if (requeue)
+    {
+        th->status = Ready;        // 更新线程状态
+    }
+    releaseLockIrqrestore(&pool->lock, flags);
+    if (requeue)
     {
-        ti->status = Ready;        // 更新线程状态
-        pool->scheduler.push(tid); // 加入线程调度
+        pool->scheduler.push(tid); // 加入线程调度（调用者已关中断）
     }
 }
 
@@ -377,9 +677,14 @@ int tickPool(ThreadPool *pool)
     return pool->scheduler.tick();
 }
 
-// 线程退出，释放该 tid 线程信息的占用位，并且通知调度器让这个 tid 不再参与调度
+// 线程退出，标记为已退出，并且通知调度器让这个 tid 不再参与调度
+// 槽位的占用位在线程切换出去并经过 RCU 宽限期后才清除
 void exitFromPool(ThreadPool *pool, int tid)
 {
-    pool->threads[tid].occupied = 0; // 清除占用标志
+    usize flags = disable_and_store();
+    acquireLock(&pool->lock);
+    threadHot(pool, tid)->status = Exited;
+    releaseLock(&pool->lock);
     pool->scheduler.exit(tid);       // 告诉调度算法线程已经结束
+    restore_sstatus(flags);
 }
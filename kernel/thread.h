@@ -9,20 +9,46 @@
 #include "types.h"
 #include "consts.h"
 #include "context.h"
+#include "spinlock.h"
+#include "rcu.h"
+#include "condition.h"
+
+/* 进程中用户线程槽位的状态，每个槽位对应一段用户栈 */
+#define SLOT_FREE       0   // 空闲
+#define SLOT_RUNNING    1   // 线程运行中
+#define SLOT_EXITED     2   // 线程已退出，等待被 join
+#define SLOT_JOINING    3   // 已被 join，正在回收用户栈
+
+typedef struct {
+    int state;          // 槽位状态
+    int tid;            // 占用该槽位的线程的线程号（见 THREAD_ID）
+    usize exitCode;     // 线程退出码
+} UserThreadSlot;
 
 // 进程结构体，为资源分配的最小单位
-// 保存线程共享资源
+// 保存线程共享资源，由进程内所有线程共享，最后一个线程被回收后销毁
 typedef struct {
     // 页表寄存器
     usize satp;
+    // 正在运行该进程线程的 hart 位图，修改页表后只需刷新这些 hart 的 TLB
+    usize cpumask;
+    Spinlock lock;      // 保护页表修改和线程槽位
+    int refs;           // 引用该进程的线程数
+    UserThreadSlot slots[MAX_PROCESS_THREADS];  // 用户线程槽位，0 号为主线程
+    Condvar joinWait;   // 等待线程退出的 join 调用者
+    struct IoRing *ring;    // 异步系统调用的环形队列，没有为 0
+    struct File *files[MAX_FDS];    // 文件描述符表，由 lock 保护
+    struct ShmAttach *shm;  // 映射的共享内存段链表，由 lock 保护
 } Process;
 
 // 线程结构体
 typedef struct {
     usize contextAddr;  /* 线程上下文存储的地址 */
     usize kstack;       /* 线程栈底地址 */
-    Process process;    /* 所属进程 */
+    Process *process;   /* 所属进程，内核线程为 0（代替进程取走异步请求的轮询线程除外） */
     int wait;           /* 等待其退出的Tid,当没有线程等待时，wait 被赋值为-1 */
+    int ustackSlot;     /* 在所属进程中的用户栈槽位，内核线程（包括轮询线程）为 -1 */
+    struct FpContext *fp;   /* 浮点寄存器，第一次使用浮点指令时才分配，没有为 0 */
 } Thread;
 
 /* 线程状态 */
@@ -41,45 +67,111 @@ typedef struct {
     int     (* pop) (void);     // 从就绪线程中选择一个运行，如果没有可运行的线程则返回 -1
     int     (* tick)(void);     // 提醒调度算法当前线程又运行了一个 tick，返回的 int 表示调度算法认为当前线程是否需要被切换出去
     void    (* exit)(int);      // 告诉调度算法某个线程已经结束
+    int     (* setPriority)(int, int);  // 设置线程的 nice 值，不支持优先级的调度算法为 0
+    int     (* needTick)(int);  // hart 是否需要周期 tick，即是否还有线程在该 hart 的就绪队列中等待
+    void    (* wake)(int);      // 将一个休眠后被唤醒的线程加入线程调度，不区分唤醒的调度算法为 0（使用 push）
 } Scheduler;
 
-/* 线程池中的线程信息槽 */
+/* 线程表中线程的调度热数据，紧凑存放，调度和唤醒路径只访问这部分 */
 typedef struct {
     Status status;      // 线程状态
-    int tid;            // 线程ID
     int occupied;       // 该槽位是否被占用
-    Thread thread;      // 线程
+    int running;        // 线程是否正在某个 hart 上运行（上下文尚未保存）
+    int hart;           // 线程最近一次运行所在的 hart，唤醒时优先投递回该 hart
+    int wakeNext;       // 跨 hart 唤醒时在目标 hart inbox 中的下一个线程
+    int nextFree;       // 槽位空闲时，空闲链表中的下一个槽位
+    uint32 generation;  // 槽位每次被分配时加一，与下标一起组成对外的线程号
+} ThreadHot;
+
+/* 线程表中线程的冷数据，只在切换、收尾和回收时访问 */
+typedef struct {
+    int tid;                    // 线程表下标
+    struct ThreadPool *pool;    // 所属线程池，回收槽位时使用
+    Thread thread;              // 线程，运行时由 RunningThread 直接引用
+    RcuHead rcu;                // 线程退出后推迟释放槽位
 } ThreadInfo;
 
+#define THREAD_CHUNKS   (MAX_LIVE_THREADS / THREAD_CHUNK)
+_Static_assert(MAX_LIVE_THREADS % THREAD_CHUNK == 0 && MAX_LIVE_THREADS <= MAX_THREAD,
+               "thread table must be whole chunks and fit in the tid index bits");
+
 // 线程池
-typedef struct {
-    ThreadInfo threads[MAX_THREAD];
+// 线程表按 THREAD_CHUNK 个槽位一块按需增长，块分配后不再移动，槽位的地址在线程生命周期内不变
+typedef struct ThreadPool {
+    Spinlock lock;      // 保护线程槽位的状态变化和空闲链表，所有 hart 共享；入队、出队和窃取不在此锁下，由调度器的各 hart 队列锁保护
+    ThreadHot *hot[THREAD_CHUNKS];      // 各块的热数据
+    ThreadInfo *cold[THREAD_CHUNKS];    // 各块的冷数据
+    int chunks;         // 已分配的块数
+    int freeHead;       // 空闲槽位链表头，-1 为空
     Scheduler scheduler;
 } ThreadPool;
 
-// 正在运行的线程
+// 线程表下标对应的热数据和冷数据
+static inline ThreadHot *
+threadHot(ThreadPool *pool, int tid)
+{
+    return &pool->hot[tid / THREAD_CHUNK][tid % THREAD_CHUNK];
+}
+
+static inline ThreadInfo *
+threadInfo(ThreadPool *pool, int tid)
+{
+    return &pool->cold[tid / THREAD_CHUNK][tid % THREAD_CHUNK];
+}
+
+// 对外的线程号：高位为槽位的代数，低位为线程表下标，槽位被复用后旧线程号不再有效
+#define THREAD_ID(gen, tid)     ((int)((((gen) & 0x7ffff) << TID_INDEX_BITS) | (tid)))
+#define THREAD_INDEX(id)        ((id) & (MAX_THREAD - 1))
+
+// 正在运行的线程，直接引用线程表中的 Thread，不做拷贝
 typedef struct {
     int tid;
-    Thread thread;
+    Thread *thread;
 } RunningThread;
 
-// 调度线程参与调度所需要的所有信息
+// 每个 hart 的负载均衡统计信息
 typedef struct {
-    ThreadPool pool;        // 线程池
+    usize enqueued;         // 加入本 hart 就绪队列的线程数
+    usize dispatched;       // 本 hart 选出运行的线程数
+    usize stolen;           // 本 hart 空闲时从其他 hart 窃取的线程数
+    usize donated;          // 被其他 hart 窃取走的线程数
+    usize remoteWakeups;    // 其他 hart 通过 inbox 投递过来的唤醒数
+    usize ipiSent;          // 本 hart 发出的 IPI 数
+    usize ipiReceived;      // 本 hart 收到的 IPI 数
+    usize idleWaits;        // 本 hart 无线程可运行而进入 wfi 的次数
+    usize directSwitches;   // 不经过调度线程直接切换到下一个线程的次数
+    usize handoffs;         // 同步 IPC 中不经过就绪队列直接交给指定线程的次数
+} LoadStats;
+
+// 调度线程参与调度所需要的所有信息，每个 hart 一个
+// 线程池由所有 hart 共享，不在 Processor 中
+typedef struct {
+    int hartid;             // hart 编号
+    int online;             // 该 hart 是否已经启动并参与调度
     Thread idle;            // 调度线程
     RunningThread current;  // 当前运行线程信息
+    RunningThread previous; // 直接切换时被换下、等待收尾的线程，tid 为 -1 表示没有
     int occupied;           // 当前是否有线程（除了调度线程）正在运行
+    int inbox;              // 其他 hart 投递的待唤醒线程（无锁多生产者单消费者栈，-1 为空）
+    LoadStats stats;        // 负载均衡统计
 } Processor;
 
 /* 线程相关函数 */
 void switchThread(Thread *self, Thread *target);
+usize newKernelStack();
+void freeKernelStack(usize kstack);
+void checkKernelStack(Thread *thread);
+void printKernelStackStats();
 Thread newUserThread(char *data);
-int allocFd(Thread *thread);
-void deallocFd(Thread *thread, int fd);
+Thread newKernelThread(usize entry);
+Thread newCloneThread(Process *process, int slot, usize entry, usize arg, usize tls);
+void appendArguments(Thread *thread, usize args[8]);
+int allocFd(Thread *thread, struct File *file);
+int deallocFd(Thread *thread, int fd);
 
 /* 线程池相关函数 */
 ThreadPool newThreadPool(Scheduler scheduler);
-void addToPool(ThreadPool *pool, Thread thread);
+int addToPool(ThreadPool *pool, Thread thread);
 RunningThread acquireFromPool(ThreadPool *pool);
 void retrieveToPool(ThreadPool *pool, RunningThread rt);
 int tickPool(ThreadPool *pool);
@@ -87,23 +179,66 @@ void exitFromPool(ThreadPool *pool, int tid);
 
 /* Processor 相关函数 */
 void initCPU(Thread idle, ThreadPool pool);
-void addToCPU(Thread thread);
+void initSecondaryCPU(Thread idle);
+void startHarts();
+void ipiCPU();
+LoadStats *getLoadStats(int hart);
+int isHartOnline(int hart);
+void printLoadStats();
+void printThreads();
+void benchContextSwitch();
+int addToCPU(Thread thread);
 void idleMain();
 void tickCPU();
+void finishSwitchCPU();
 void exitFromCPU(usize code);
 void runCPU();
+void prepareSleepCPU();
 void yieldCPU();
+void handoffCPU(int tid);
+void schedYieldCPU();
 void wakeupCPU(int tid);
-int executeCPU(char *path, int hostTid);
+int executeCPU(char *path, int hostTid, struct File *in, struct File *out);
+long cloneCPU(usize entry, usize arg, usize tls);
+long setPriorityCPU(int id, int nice);
 int getCurrentTid();
+int getCurrentThreadId();
+int resolveThreadId(int id);
 Thread *getCurrentThread();
 
+/* 进程相关函数 */
+Process *newProcess(usize satp);
+void getProcess(Process *process);
+void putProcess(Process *process);
+void userStackRange(int slot, usize *bottom, usize *top);
+int allocStackSlot(Process *process);
+void releaseStackSlot(Process *process, int slot);
+void exitUserThread(Thread *thread, usize code);
+long joinThread(int id);
+
 /* 调度器相关函数 */
 void schedulerInit();
 void schedulerPush(int tid);
 int  schedulerPop();
 int  schedulerTick();
 void schedulerExit(int tid);
+int  schedulerNeedTick(int hart);
+
+void mlfqInit();
+void mlfqPush(int tid);
+void mlfqWake(int tid);
+int  mlfqPop();
+int  mlfqTick();
+void mlfqExit(int tid);
+int  mlfqNeedTick(int hart);
+
+void fairInit();
+void fairPush(int tid);
+int  fairPop();
+int  fairTick();
+void fairExit(int tid);
+int  fairSetPriority(int tid, int nice);
+int  fairNeedTick(int hart);
 
 
 
@@ -6,60 +6,187 @@
 #include "types.h"
 #include "riscv.h"
 #include "def.h"
+#include "consts.h"
+#include "ktimer.h"
+#include "edf.h"
+
+static const usize INTERVAL = TICK_INTERVAL;   // 时钟中断为 100000 个CPU周期
+
+#define NO_TIMER    ((usize)-1)     // 不设置时钟中断
+
+/*
+ * 时钟中断按需设置，不再固定每 INTERVAL 触发一次
+ *      有线程在运行且还有其他线程等待本 hart 时，才需要周期 tick 来轮转时间片
+ *      空闲或只有一个可运行线程时停止周期 tick，只为最早的定时事件（内核定时器、实时线程周期）设置时钟中断
+ *      有新线程就绪时由 updateTimer() 重新开启周期 tick
+ */
+static usize ARMED[MAX_CPU];        // 各 hart 已设置的时钟中断时刻，NO_TIMER 表示没有设置
+static usize TICK_STOPPED;          // 停止了周期 tick 的 hart 位图
+static usize PROGRAMS[MAX_CPU];     // 各 hart 设置时钟中断的次数（统计）
+
+/*
+ * 支持 Sstc 扩展时 S 态可以直接写 stimecmp 设置时钟中断，不需要每次 ecall 进入 M 态固件
+ * 启动时每个 hart 自行探测：临时把 stvec 指向 __sstcProbeTrap 后写 stimecmp
+ * 不支持（或 M 态没有打开 menvcfg.STCE）时写 stimecmp 触发非法指令异常，陷入处理跳过该指令并将 a0 清零
+ */
+static int SSTC[MAX_CPU];           // 各 hart 是否直接写 stimecmp
+
+asm(
+    "   .text\n"
+    "   .align 2\n"
+    "__sstcProbeTrap:\n"
+    "   csrr t0, sepc\n"
+    "   addi t0, t0, 4\n"
+    "   csrw sepc, t0\n"
+    "   li a0, 0\n"
+    "   sret\n"
+);
+
+// 探测本 hart 能否写 stimecmp（需关闭异步中断），探测时写入的值不会触发时钟中断
+static int
+probeSstc()
+{
+    extern void __sstcProbeTrap();
+    usize stvec = r_stvec();
+    w_stvec((usize)__sstcProbeTrap | MODE_DIRECT);
+    register usize a0 asm("a0") = 1;
+    asm volatile("csrw 0x14d, %1" : "+r"(a0) : "r"(NO_TIMER) : "t0", "memory");
+    w_stvec(stvec);
+    return a0;
+}
 
-static const usize INTERVAL = 100000;   // 时钟中断为 100000 个CPU周期
+// 设置本 hart 的硬件定时器
+static inline void
+programTimer(usize when)
+{
+    if(SSTC[cpuid()]) {
+        w_stimecmp(when);
+    } else {
+        setTimer(when);
+    }
+}
 
-void setTimerout();
+// 计算本 hart 下一次需要时钟中断的时刻，并记录是否停止了周期 tick（需关闭异步中断）
+static usize
+nextTimerEvent()
+{
+    usize next = NO_TIMER, event;
+    usize bit = 1UL << cpuid();
+    extern int needTickCPU();
+    if(needTickCPU()) {
+        next = r_time() + INTERVAL;
+        __atomic_fetch_and(&TICK_STOPPED, ~bit, __ATOMIC_RELEASE);
+    } else {
+        __atomic_fetch_or(&TICK_STOPPED, bit, __ATOMIC_RELEASE);
+    }
+    event = nextKtimerEvent();
+    if(event < next) next = event;
+    event = edfNextEvent();
+    if(event < next) next = event;
+    return next;
+}
+
+// 设置本 hart 的时钟中断，NO_TIMER 时同时清除挂起的时钟中断
+static void
+armTimer(usize when)
+{
+    ARMED[cpuid()] = when;
+    PROGRAMS[cpuid()] += 1;
+    programTimer(when);
+}
 
 // 初始化时钟中断
 void 
 initTimer()
 {
-    // 写 sie 时钟中断使能
-    w_sie(SIE_STIE);
-    // 写 scause 监管者模式中断使能（因为时钟中断还需打断内核线程）
-    w_sstatus(SSTATUS_SIE);
+    // 用户程序可以直接读取 time、cycle 和 instret 计数器，配合共享数据页计时
+    w_scounteren(SCOUNTEREN_CY | SCOUNTEREN_TM | SCOUNTEREN_IR);
+    // 探测 Sstc 扩展
+    usize flags = disable_and_store();
+    SSTC[cpuid()] = probeSstc();
+    restore_sstatus(flags);
+    // 写 sie 时钟中断使能（保留 initInterrupt 中已打开的外部中断和软件中断）
+    w_sie(r_sie() | SIE_STIE);
+    // 写 sstatus 监管者模式中断使能（因为时钟中断还需打断内核线程）
+    w_sstatus(r_sstatus() | SSTATUS_SIE);
     // 初始化时设置第一次时钟中断
-    setTimerout();
+    armTimer(r_time() + INTERVAL);
 }
 
-// 设置下一次时钟中断时间为 当前时间 + INTERVAL个CPU周期
+// 时钟中断发生，重新计算并设置下一次时钟中断
 void 
-setTimerout()
+tick()
 {
-    setTimer(r_time() + INTERVAL); // r_time() 读取硬件时间（kernel/riscv.h）
+    armTimer(nextTimerEvent());
 }
 
-// 触发时钟中断，并记录 TICKS
-// static usize TICKS = 0;
-void 
-tick()
+// 本 hart 的状态变化后调用（有线程就绪、开始运行或进入空闲）
+// 只在需要比已设置的更早的时钟中断时重新设置；需要的更晚时不改动，等已设置的中断到来时再重新计算，避免频繁的 SBI 调用
+void
+updateTimer()
 {
-    setTimerout();
-    // TICKS += 1;
-    // if(TICKS % 100 == 0) {
-    //     printf("** TICKS = %d **\n", TICKS);    // 每 100 次时钟中断输出 TICKS
-    // }
+    usize flags = disable_and_store();
+    usize next = nextTimerEvent();
+    if(next < ARMED[cpuid()]) {
+        armTimer(next);
+    }
+    restore_sstatus(flags);
 }
 
+// hart 是否停止了周期 tick，此时向它投递的线程和 RCU 宽限期需要用 IPI 通知
+int
+tickStopped(int hart)
+{
+    return (__atomic_load_n(&TICK_STOPPED, __ATOMIC_ACQUIRE) >> hart) & 1;
+}
 
+// 打印各 hart 设置时钟中断的次数
+void
+printTimerStats()
+{
+    int hart;
+    for(hart = 0; hart < MAX_CPU; hart ++) {
+        if(PROGRAMS[hart] != 0) {
+            printf("hart %d: timer programmed %d times via %s, tick %s\n",
+                    hart, (int)PROGRAMS[hart], SSTC[hart] ? "stimecmp" : "SBI",
+                    tickStopped(hart) ? "stopped" : "running");
+        }
+    }
+}
 
+#define BENCH_ROUNDS    10000
 
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
+/*
+ * 设置时钟中断的开销微基准：分别通过 stimecmp 和 SBI 设置 BENCH_ROUNDS 次很远的时钟中断，输出平均每次的时间
+ * 每个 tick 和每次更早的定时事件都要设置一次时钟中断，这就是两种方式每次的开销差
+ * 作为内核线程运行，启动时由 make qemu BENCH=timer 选择
+ */
+void
+benchTimerProgram()
+{
+    usize cost[2] = {0, 0};
+    int i, sstc;
+    usize flags = disable_and_store();
+    int hart = cpuid();
+    for(sstc = 0; sstc < 2; sstc ++) {
+        if(sstc && !SSTC[hart]) break;
+        usize start = r_time();
+        for(i = 0; i < BENCH_ROUNDS; i ++) {
+            if(sstc) {
+                w_stimecmp(NO_TIMER - i);
+            } else {
+                setTimer(NO_TIMER - i);
+            }
+        }
+        cost[sstc] = r_time() - start;
+    }
+    armTimer(ARMED[hart]);      // 恢复测量前设置的时钟中断
+    restore_sstatus(flags);
+    printf("timer program: SBI %d ns", (int)(cost[0] * (1000000000 / TIMEBASE_FREQ) / BENCH_ROUNDS));
+    if(SSTC[hart]) {
+        printf(", stimecmp %d ns\n", (int)(cost[1] * (1000000000 / TIMEBASE_FREQ) / BENCH_ROUNDS));
+    } else {
+        printf(", stimecmp unsupported\n");
+    }
+    exitFromCPU(0);
+}
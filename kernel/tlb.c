@@ -0,0 +1,150 @@
+/*************************** TLB 一致性 *********************************
+ * Author：Joker001014
+ * 2025.03.21
+ * 每个 Process 用 cpumask 记录当前运行着它的线程的 hart
+ * switchContext 切换页表时会执行 sfence.vma，因此不在 cpumask 中的 hart 不会缓存该地址空间的旧映射，
+ * 修改页表后只需要通知 cpumask 中的 hart，并且只刷新被修改的地址范围
+***********************************************************************/
+
+#include "types.h"
+#include "def.h"
+#include "consts.h"
+#include "riscv.h"
+#include "thread.h"
+#include "tlb.h"
+
+static TlbStats STATS;
+
+// 当前 hart 将要切换到 process 的线程，在切换页表之前调用
+void
+activateAddressSpace(Process *process)
+{
+    if(process != 0) {
+        __atomic_fetch_or(&process->cpumask, 1UL << cpuid(), __ATOMIC_SEQ_CST);
+    }
+}
+
+// 当前 hart 已经从 process 的线程切换出去（切换时已刷新 TLB）
+void
+deactivateAddressSpace(Process *process)
+{
+    if(process != 0) {
+        __atomic_fetch_and(&process->cpumask, ~(1UL << cpuid()), __ATOMIC_RELEASE);
+    }
+}
+
+// 所有在线 hart 的位图，用于内核地址空间的刷新
+static usize
+onlineMask()
+{
+    usize mask = 0;
+    int hart;
+    for(hart = 0; hart < MAX_CPU; hart ++) {
+        if(isHartOnline(hart)) {
+            mask |= 1UL << hart;
+        }
+    }
+    return mask;
+}
+
+/*
+ * 页表修改完成后调用，使所有可能缓存了 [start, start + size) 旧映射的 hart 刷新 TLB
+ * process 为 0 表示修改的是所有 hart 共享的内核映射
+ */
+void
+flushTlbRange(Process *process, usize start, usize size)
+{
+    // 页表的修改必须先于读取 cpumask 对其他 hart 可见，
+    // 否则之后切换进来的 hart 可能既不在 mask 中，又读到了旧的页表项
+    __sync_synchronize();
+    usize self = 1UL << cpuid();
+    usize mask = process ? __atomic_load_n(&process->cpumask, __ATOMIC_SEQ_CST) : onlineMask();
+    if(process != 0 && r_satp() == process->satp) {
+        mask |= self;   // 在该地址空间的线程中修改（如系统调用），本 hart 也可能缓存了旧映射
+    }
+    start &= ~(PAGE_SIZE - 1);
+    usize pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    int full = size == (usize)-1 || pages > TLB_FULL_FLUSH_PAGES;
+    __atomic_fetch_add(&STATS.flushes, 1, __ATOMIC_RELAXED);
+    if(full) {
+        __atomic_fetch_add(&STATS.fullFlushes, 1, __ATOMIC_RELAXED);
+    }
+
+    if(mask & self) {
+        if(full) {
+            sfence_vma();
+        } else {
+            usize i;
+            for(i = 0; i < pages; i ++) {
+                sfence_vma_addr(start + i * PAGE_SIZE);
+            }
+        }
+    }
+    usize remote = mask & ~self;
+    if(remote != 0) {
+        __atomic_fetch_add(&STATS.remote, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&STATS.remoteHarts, __builtin_popcountl(remote), __ATOMIC_RELAXED);
+        // SBI 在所有目标 hart 完成刷新后才返回
+        if(full) {
+            remoteSfenceVma(remote, 0, (usize)-1);
+        } else {
+            remoteSfenceVma(remote, start, pages * PAGE_SIZE);
+        }
+    }
+}
+
+// 开始收集一批对 process 页表的修改
+void
+initTlbBatch(TlbBatch *batch, Process *process)
+{
+    batch->process = process;
+    batch->start = 0;
+    batch->end = 0;
+    batch->pages = 0;
+    batch->nframes = 0;
+}
+
+// 记录虚拟地址 va 所在页的映射已被修改，frame 不为 0 时为原先映射的物理页，刷新后释放
+void
+addTlbBatch(TlbBatch *batch, usize va, usize frame)
+{
+    if(frame != 0 && batch->nframes == TLB_FULL_FLUSH_PAGES) {
+        flushTlbBatch(batch);
+    }
+    va &= ~(PAGE_SIZE - 1);
+    if(batch->pages == 0 || va < batch->start) {
+        batch->start = va;
+    }
+    if(batch->pages == 0 || va + PAGE_SIZE > batch->end) {
+        batch->end = va + PAGE_SIZE;
+    }
+    batch->pages += 1;
+    if(frame != 0) {
+        batch->frames[batch->nframes ++] = frame;
+    }
+}
+
+// 将收集到的修改合并为一次刷新，范围过大时 flushTlbRange 会退化为刷新全部
+// 刷新完成后释放收集到的物理页
+void
+flushTlbBatch(TlbBatch *batch)
+{
+    if(batch->pages == 0) {
+        return;
+    }
+    flushTlbRange(batch->process, batch->start, batch->end - batch->start);
+    int i;
+    for(i = 0; i < batch->nframes; i ++) {
+        deallocFrame(batch->frames[i]);
+    }
+    batch->pages = 0;
+    batch->nframes = 0;
+}
+
+// 打印 TLB shootdown 统计
+void
+printTlbStats()
+{
+    printf("tlb: flushes %d, remote %d, remote harts %d, full %d\n",
+        STATS.flushes, STATS.remote, STATS.remoteHarts, STATS.fullFlushes);
+}
@@ -0,0 +1,43 @@
+/*************************** TLB 一致性 *********************************
+ * Author：Joker001014
+ * 2025.03.21
+ * 记录每个地址空间正在哪些 hart 上运行，修改页表后只刷新这些 hart 上受影响的范围
+***********************************************************************/
+
+#ifndef _TLB_H
+#define _TLB_H
+
+#include "types.h"
+#include "thread.h"
+
+// 一次刷新超过该页数时直接刷新整个 TLB，逐页刷新的开销已超过重新填充 TLB
+#define TLB_FULL_FLUSH_PAGES    32
+
+// 批量刷新：解除映射时先收集受影响的页，结束后合并为一次 shootdown
+// 被解除映射的物理页要等所有 hart 刷新 TLB 之后才能释放，否则其他 hart 仍可能通过旧映射访问它
+typedef struct {
+    Process *process;   // 被修改的地址空间，0 表示内核地址空间
+    usize start;        // 收集到的虚拟地址范围 [start, end)
+    usize end;
+    usize pages;        // 收集到的页数
+    int nframes;        // 等待释放的物理页数
+    usize frames[TLB_FULL_FLUSH_PAGES];     // 等待释放的物理页地址，满了时先刷新一次
+} TlbBatch;
+
+// TLB shootdown 统计
+typedef struct {
+    usize flushes;      // 刷新请求次数
+    usize remote;       // 需要通知其他 hart 的次数
+    usize remoteHarts;  // 累计通知的 hart 数
+    usize fullFlushes;  // 退化为整个 TLB 刷新的次数
+} TlbStats;
+
+void activateAddressSpace(Process *process);
+void deactivateAddressSpace(Process *process);
+void flushTlbRange(Process *process, usize start, usize size);
+void initTlbBatch(TlbBatch *batch, Process *process);
+void addTlbBatch(TlbBatch *batch, usize va, usize frame);
+void flushTlbBatch(TlbBatch *batch);
+void printTlbStats();
+
+#endif
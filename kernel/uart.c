@@ -0,0 +1,184 @@
+/**************************** 16550 串口驱动 ******************************
+ * Author：Joker001014
+ * 2025.03.29
+ * 直接读写 UART 的 MMIO 寄存器，不再每个字符都通过 SBI 进入 M 态
+ *      输出：字符先放入发送缓冲区，发送 FIFO 空时一次写入 UART_FIFO_SIZE 个字符，之后的由发送中断继续写入
+ *      输入：一次接收中断取出接收 FIFO 中的所有字符，一起交给标准输入的行规程
+ * 发送缓冲区满时：系统调用等线程上下文休眠，发送中断腾出一半空间后唤醒
+ *      中断处理程序和关中断输出日志时不能休眠，仍在原地等待发送 FIFO 空，直接写入
+***********************************************************************/
+
+#include "types.h"
+#include "def.h"
+#include "consts.h"
+#include "spinlock.h"
+#include "condition.h"
+#include "stdin.h"
+#include "uart.h"
+
+#define REG(r)  ((volatile uint8 *)(UART0_BASE + (r)))
+
+// 发送缓冲区，buf[r, w) 为待发送的字符，r 和 w 只增不减，取下标时对 UART_TX_BUF 取模
+static struct {
+    Spinlock lock;      // 外部中断处理程序也会获取，线程中需关中断获取
+    char buf[UART_TX_BUF];
+    usize r;
+    usize w;
+    Condvar txWait;     // 发送缓冲区满时休眠的线程
+    int ready;          // 驱动是否已初始化，之前的输出通过 SBI
+    usize rxInterrupts; // 接收中断次数（统计）
+    usize rxChars;      // 接收的字符数（统计）
+    usize txFills;      // 向发送 FIFO 批量写入的次数（统计）
+    usize txChars;      // 发送的字符数（统计）
+    usize txSleeps;     // 线程因发送缓冲区满而休眠的次数（统计）
+} UART;
+
+void
+initUart()
+{
+    initLock(&UART.lock, "uart");
+    *REG(UART_IER) = 0;                             // 初始化期间关闭串口中断
+    *REG(UART_LCR) = LCR_BAUD_LATCH;                // 设置波特率 38.4K
+    *REG(0) = 0x03;
+    *REG(1) = 0x00;
+    *REG(UART_LCR) = LCR_EIGHT_BITS;                // 8 位数据，无校验
+    *REG(UART_FCR) = FCR_FIFO_ENABLE | FCR_FIFO_CLEAR;
+    *REG(UART_MCR) = MCR_DTR_RTS_OUT2;
+    *REG(UART_IER) = IER_RX_ENABLE;                 // 发送中断在有待发送的字符时才打开
+    __atomic_store_n(&UART.ready, 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * 发送 FIFO 为空时，从发送缓冲区向其写入最多 UART_FIFO_SIZE 个字符（需持有 UART.lock）
+ * 缓冲区中还有字符时打开发送中断，FIFO 再次为空时继续写入；缓冲区空后关闭发送中断，避免中断反复触发
+ * 腾出一半空间后唤醒休眠的写者，每次唤醒可以拷贝一大块
+ */
+static void
+uartStart()
+{
+    if(UART.r != UART.w && (*REG(UART_LSR) & LSR_TX_IDLE)) {
+        int n = 0;
+        while(UART.r != UART.w && n < UART_FIFO_SIZE) {
+            *REG(UART_THR) = UART.buf[UART.r % UART_TX_BUF];
+            UART.r += 1;
+            n ++;
+        }
+        UART.txFills += 1;
+        UART.txChars += n;
+        if(UART.w - UART.r <= UART_TX_BUF / 2) {
+            notifyAllCondition(&UART.txWait);
+        }
+    }
+    *REG(UART_IER) = UART.r != UART.w ? IER_RX_ENABLE | IER_TX_ENABLE : IER_RX_ENABLE;
+}
+
+/*
+ * 将一段字符一起放入发送缓冲区，只获取一次锁，内容不会与其他输出交错
+ * 用于中断处理程序和关中断输出日志等不能休眠的场合，缓冲区满时原地等待发送 FIFO 腾出空间
+ * 驱动尚未初始化时返回 -1，由调用者改用 SBI 输出
+ */
+int
+uartWrite(char *buf, usize len)
+{
+    if(!__atomic_load_n(&UART.ready, __ATOMIC_ACQUIRE)) {
+        return -1;
+    }
+    usize i, flags = acquireLockIrqsave(&UART.lock);
+    for(i = 0; i < len; i ++) {
+        while(UART.w - UART.r == UART_TX_BUF) {
+            uartStart();    // 可能处于关中断状态，不能等待发送中断
+        }
+        UART.buf[UART.w % UART_TX_BUF] = buf[i];
+        UART.w += 1;
+    }
+    uartStart();
+    releaseLockIrqrestore(&UART.lock, flags);
+    return 0;
+}
+
+/*
+ * 在线程上下文中将一段字符放入发送缓冲区，缓冲区满时休眠，由发送中断唤醒后继续拷贝
+ * 超过剩余空间的内容分块拷贝，块之间可能与其他输出交错
+ * 驱动尚未初始化时返回 -1
+ */
+int
+uartWriteSleep(char *buf, usize len)
+{
+    if(!__atomic_load_n(&UART.ready, __ATOMIC_ACQUIRE)) {
+        return -1;
+    }
+    usize flags = acquireLockIrqsave(&UART.lock);
+    while(len > 0) {
+        // 缓冲区满时发送中断一定已打开
+        while(UART.w - UART.r == UART_TX_BUF) {
+            UART.txSleeps += 1;
+            waitCondition(&UART.txWait, &UART.lock);
+        }
+        while(len > 0 && UART.w - UART.r < UART_TX_BUF) {
+            UART.buf[UART.w % UART_TX_BUF] = *buf++;
+            UART.w += 1;
+            len --;
+        }
+        uartStart();
+    }
+    releaseLockIrqrestore(&UART.lock, flags);
+    return 0;
+}
+
+// 发送缓冲区的剩余空间，不加锁读取，只作为估计；驱动尚未初始化时不限制
+usize
+uartTxRoom()
+{
+    if(!__atomic_load_n(&UART.ready, __ATOMIC_ACQUIRE)) {
+        return -1UL;
+    }
+    return UART_TX_BUF - (__atomic_load_n(&UART.w, __ATOMIC_RELAXED) - __atomic_load_n(&UART.r, __ATOMIC_RELAXED));
+}
+
+// 同步输出一个字符，先发送缓冲区中已有的字符，保持输出顺序；用于 panic 等不能依赖中断的场合
+void
+uartPutcSync(int c)
+{
+    if(!__atomic_load_n(&UART.ready, __ATOMIC_ACQUIRE)) {
+        consolePutchar(c);
+        return;
+    }
+    // 不获取锁：panic 时持有锁的 hart 已经停下
+    while(UART.r != UART.w) {
+        while(!(*REG(UART_LSR) & LSR_TX_IDLE)) {}
+        *REG(UART_THR) = UART.buf[UART.r % UART_TX_BUF];
+        UART.r += 1;
+    }
+    while(!(*REG(UART_LSR) & LSR_TX_IDLE)) {}
+    *REG(UART_THR) = c;
+}
+
+/*
+ * 串口中断处理：取出接收 FIFO 中的所有字符一起放入标准输入缓冲区，并继续发送
+ */
+void
+uartInterrupt()
+{
+    char buf[UART_FIFO_SIZE * 4];
+    int n = 0;
+    acquireLock(&UART.lock);
+    UART.rxInterrupts += 1;
+    while(n < (int)sizeof(buf) && (*REG(UART_LSR) & LSR_RX_READY)) {
+        buf[n ++] = *REG(UART_RHR);     // 由 stdin 的行规程转换回车和处理编辑键
+    }
+    UART.rxChars += n;
+    uartStart();
+    releaseLock(&UART.lock);
+    if(n > 0) {
+        pushChars(buf, n);
+    }
+}
+
+// 打印串口收发统计
+void
+printUartStats()
+{
+    printf("uart: rx %d chars in %d interrupts, tx %d chars in %d fills, %d writer sleeps\n",
+            (int)UART.rxChars, (int)UART.rxInterrupts, (int)UART.txChars, (int)UART.txFills,
+            (int)UART.txSleeps);
+}
@@ -0,0 +1,46 @@
+/**************************** 16550 串口驱动 ******************************
+ * Author：Joker001014
+ * 2025.03.29
+***********************************************************************/
+
+#ifndef _UART_H
+#define _UART_H
+
+#include "types.h"
+#include "consts.h"
+
+#define UART0_BASE      (0x10000000 + KERNEL_MAP_OFFSET)   // QEMU virt 的 UART0，在 mapExtInterruptArea 中映射
+#define UART0_IRQ       10                                  // UART0 在 PLIC 中的中断号
+
+/* 16550 寄存器偏移 */
+#define UART_RHR        0       // 接收保持寄存器（读）
+#define UART_THR        0       // 发送保持寄存器（写）
+#define UART_IER        1       // 中断使能寄存器
+#define UART_FCR        2       // FIFO 控制寄存器（写）
+#define UART_ISR        2       // 中断状态寄存器（读）
+#define UART_LCR        3       // 线路控制寄存器
+#define UART_MCR        4       // 调制解调器控制寄存器
+#define UART_LSR        5       // 线路状态寄存器
+
+#define IER_RX_ENABLE   (1 << 0)    // 接收到数据时中断
+#define IER_TX_ENABLE   (1 << 1)    // 发送保持寄存器空时中断
+#define FCR_FIFO_ENABLE (1 << 0)
+#define FCR_FIFO_CLEAR  (3 << 1)    // 清空收发 FIFO
+#define LCR_EIGHT_BITS  (3 << 0)
+#define LCR_BAUD_LATCH  (1 << 7)    // 设置波特率的特殊模式
+#define MCR_DTR_RTS_OUT2 0x0b       // OUT2 打开后中断信号才能送到 PLIC
+#define LSR_RX_READY    (1 << 0)    // 接收 FIFO 中有数据
+#define LSR_TX_IDLE     (1 << 5)    // 发送 FIFO 为空，可以写入
+
+#define UART_FIFO_SIZE  16          // 收发 FIFO 的深度
+#define UART_TX_BUF     4096        // 发送缓冲区大小
+
+void initUart();
+void uartPutcSync(int c);
+int  uartWrite(char *buf, usize len);
+int  uartWriteSleep(char *buf, usize len);
+usize uartTxRoom();
+void uartInterrupt();
+void printUartStats();
+
+#endif
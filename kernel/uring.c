@@ -0,0 +1,302 @@
+/************************ 异步系统调用环形队列 ***************************
+ * Author：Joker001014
+ * 2025.03.30
+ * 进程与内核共享一对环形队列：用户在提交队列中放入多个请求，一次 io_uring_enter 全部提交
+ *      完成项由内核写入完成队列，用户直接从共享内存读取，不需要陷入内核
+ *      请求由提交者（或轮询线程）按顺序执行，会阻塞的请求（读、执行程序）执行完后才处理下一个
+ *      超时请求由内核定时器完成，不占用提交者
+ *      设置 URING_SETUP_SQPOLL 时，内核轮询线程代替进程取走请求，提交不需要系统调用；空闲一段时间后休眠
+***********************************************************************/
+
+#include "types.h"
+#include "def.h"
+#include "consts.h"
+#include "riscv.h"
+#include "mapping.h"
+#include "thread.h"
+#include "ktimer.h"
+#include "uring.h"
+
+#define URING_POLL_IDLE_NS  2000000     // 轮询线程连续空闲 2ms 后休眠
+
+// 超时请求，到期后由定时器回调写入完成项
+typedef struct {
+    Ktimer timer;
+    IoRing *ring;
+    usize userData;
+} IoTimeout;
+
+// 增加环形队列的引用
+static void
+getRing(IoRing *ring)
+{
+    __atomic_fetch_add(&ring->refs, 1, __ATOMIC_RELAXED);
+}
+
+// 释放环形队列的引用，最后一个引用释放时释放共享区的物理页
+// 共享区的页表项带有 SHARED 标志，销毁地址空间时不会释放它们
+void
+putRing(IoRing *ring)
+{
+    if(__atomic_sub_fetch(&ring->refs, 1, __ATOMIC_ACQ_REL) != 0) {
+        return;
+    }
+    int i;
+    for(i = 0; i < USER_URING_PAGES; i ++) {
+        deallocFrame(ring->frames[i]);
+    }
+    kfree(ring);
+}
+
+// 写入一个完成项，唤醒等待完成的线程；取走请求时已预留位置，不会溢出
+static void
+postCqe(IoRing *ring, usize userData, long res)
+{
+    usize flags = acquireLockIrqsave(&ring->lock);
+    IoCqe *cqe = &ring->cqes[ring->cqTail & (URING_CQ_ENTRIES - 1)];
+    cqe->userData = userData;
+    cqe->res = res;
+    ring->cqTail += 1;
+    __atomic_store_n(&ring->sh->cqTail, ring->cqTail, __ATOMIC_RELEASE);
+    ring->inflight -= 1;
+    notifyAllCondition(&ring->cqWait);
+    releaseLockIrqrestore(&ring->lock, flags);
+}
+
+// 超时请求到期，在时钟中断中执行
+static void
+ringTimeout(Ktimer *t)
+{
+    IoTimeout *to = (IoTimeout *)t->data;
+    postCqe(to->ring, to->userData, 0);
+    putRing(to->ring);
+    kfree(to);
+}
+
+// 执行一个请求，同步请求执行完后写入完成项，超时请求交给定时器
+static void
+executeSqe(IoRing *ring, IoSqe *sqe)
+{
+    long res;
+    switch(sqe->opcode) {
+    case URING_OP_NOP:
+        res = 0;
+        break;
+    case URING_OP_READ:
+        res = sysRead(sqe->fd, (char *)sqe->addr, sqe->len);
+        break;
+    case URING_OP_WRITE:
+        res = sysWrite(sqe->fd, (char *)sqe->addr, sqe->len);
+        break;
+    case URING_OP_TIMEOUT: {
+        IoTimeout *to = kalloc(sizeof(IoTimeout));
+        to->ring = ring;
+        to->userData = sqe->userData;
+        getRing(ring);      // 进程退出后定时器仍可能到期
+        usize duration = nsToTime(sqe->len);
+        initKtimer(&to->timer, ringTimeout, (usize)to);
+        addKtimer(&to->timer, r_time() + duration, timerSlack(duration));
+        return;
+    }
+    case URING_OP_EXEC:
+        res = sysExec((char *)sqe->addr, 0);
+        break;
+    default:
+        res = -EINVAL;
+        break;
+    }
+    postCqe(ring, sqe->userData, res);
+}
+
+/*
+ * 从提交队列取出一个请求并执行，没有请求或完成队列没有空位时返回 0
+ * 请求先拷贝出来再推进 sqHead，之后用户即可复用该槽位
+ */
+static int
+submitOne(IoRing *ring)
+{
+    usize flags = acquireLockIrqsave(&ring->lock);
+    uint32 tail = __atomic_load_n(&ring->sh->sqTail, __ATOMIC_ACQUIRE);
+    uint32 used = ring->cqTail - __atomic_load_n(&ring->sh->cqHead, __ATOMIC_ACQUIRE);
+    if(ring->sqHead == tail || used > URING_CQ_ENTRIES || used + ring->inflight >= URING_CQ_ENTRIES) {
+        releaseLockIrqrestore(&ring->lock, flags);
+        return 0;
+    }
+    IoSqe sqe = ring->sh->sqes[ring->sqHead & (URING_SQ_ENTRIES - 1)];
+    ring->sqHead += 1;
+    __atomic_store_n(&ring->sh->sqHead, ring->sqHead, __ATOMIC_RELEASE);
+    ring->inflight += 1;
+    releaseLockIrqrestore(&ring->lock, flags);
+    executeSqe(ring, &sqe);
+    return 1;
+}
+
+/*
+ * 轮询线程：持续取走提交队列中的请求，连续空闲 URING_POLL_IDLE_NS 后设置 URING_SQ_NEED_WAKEUP 并休眠
+ * 运行在进程的地址空间中并持有进程引用，可以像进程自己的线程一样访问用户缓冲区
+ */
+static void
+ringPoller(IoRing *ring)
+{
+    usize idleSince = monotonicNs();
+    while(!__atomic_load_n(&ring->stop, __ATOMIC_ACQUIRE)) {
+        if(submitOne(ring)) {
+            idleSince = monotonicNs();
+            continue;
+        }
+        if(monotonicNs() - idleSince < URING_POLL_IDLE_NS) {
+            schedYieldCPU();    // 让同一 hart 上的其他线程运行
+            continue;
+        }
+        usize flags = acquireLockIrqsave(&ring->lock);
+        __atomic_fetch_or(&ring->sh->flags, URING_SQ_NEED_WAKEUP, __ATOMIC_SEQ_CST);
+        // 设置标志后再检查一次，用户在此之前提交的请求不会因为没有唤醒而滞留
+        if(ring->sqHead == __atomic_load_n(&ring->sh->sqTail, __ATOMIC_SEQ_CST) && !ring->stop) {
+            waitCondition(&ring->sqWait, &ring->lock);
+        }
+        __atomic_fetch_and(&ring->sh->flags, ~URING_SQ_NEED_WAKEUP, __ATOMIC_RELAXED);
+        releaseLockIrqrestore(&ring->lock, flags);
+        idleSince = monotonicNs();
+    }
+    exitFromCPU(0);
+}
+
+// 为进程创建共享区并映射到 USER_URING_ADDR（需持有进程锁），该地址已有映射时返回 0
+static IoRing *
+newRing(Process *p)
+{
+    Mapping m = satpMapping(p->satp);
+    int i, j;
+    for(i = 0; i < USER_URING_PAGES; i ++) {
+        PageTableEntry *entry = lookupEntry(m, USER_URING_ADDR / PAGE_SIZE + i);
+        if(entry != 0 && *entry != 0) {
+            return 0;
+        }
+    }
+    IoRing *ring = kalloc(sizeof(IoRing));
+    initLock(&ring->lock, 0);      // 共享区随进程释放，不登记到锁统计链表
+    for(i = 0; i < USER_URING_PAGES; i ++) {
+        ring->frames[i] = allocFrame();
+        usize *page = (usize *)accessVaViaPa(ring->frames[i]);
+        for(j = 0; j < PAGE_SIZE / sizeof(usize); j ++) {
+            page[j] = 0;
+        }
+        PageTableEntry *entry = findEntry(m, USER_URING_ADDR / PAGE_SIZE + i);
+        *entry = (ring->frames[i] >> 2) | USER | READABLE | WRITABLE | SHARED | VALID;
+    }
+    ring->sh = (IoRingShared *)accessVaViaPa(ring->frames[0]);
+    ring->cqes = (IoCqe *)accessVaViaPa(ring->frames[1]);
+    ring->sh->sqEntries = URING_SQ_ENTRIES;
+    ring->sh->cqEntries = URING_CQ_ENTRIES;
+    ring->sqHead = 0;
+    ring->cqTail = 0;
+    ring->inflight = 0;
+    ring->refs = 1;
+    ring->poller = 0;
+    ring->stop = 0;
+    initCondition(&ring->cqWait);
+    initCondition(&ring->sqWait);
+    return ring;
+}
+
+/*
+ * io_uring_setup：为当前进程创建环形队列，返回共享区的用户地址
+ * 已创建时只能再用 URING_SETUP_SQPOLL 为其启动轮询线程，否则返回 -EBUSY
+ * 共享区的地址已被其他映射占用时也返回 -EBUSY
+ */
+long
+setupRing(usize flags)
+{
+    Process *p = getCurrentThread()->process;
+    if(p == 0) {
+        return -EINVAL;
+    }
+    usize sflags = acquireLockIrqsave(&p->lock);
+    IoRing *ring = p->ring;
+    if(ring != 0 && (!(flags & URING_SETUP_SQPOLL) || ring->poller)) {
+        releaseLockIrqrestore(&p->lock, sflags);
+        return -EBUSY;
+    }
+    if(ring == 0) {
+        ring = p->ring = newRing(p);
+        if(ring == 0) {
+            releaseLockIrqrestore(&p->lock, sflags);
+            return -EBUSY;
+        }
+    }
+    int poll = (flags & URING_SETUP_SQPOLL) != 0;
+    if(poll) {
+        ring->poller = 1;
+    }
+    releaseLockIrqrestore(&p->lock, sflags);
+    if(poll) {
+        // 在系统调用中创建，内核线程沿用当前进程的页表
+        Thread t = newKernelThread((usize)ringPoller);
+        t.process = p;
+        getProcess(p);
+        if(t.kstack != 0) {
+            usize args[8] = {(usize)ring};
+            appendArguments(&t, args);
+        }
+        if(addToCPU(t) < 0) {
+            // 内核栈或线程池耗尽，撤销轮询线程，环形队列仍可通过 io_uring_enter 使用
+            freeKernelStack(t.kstack);
+            putProcess(p);
+            sflags = acquireLockIrqsave(&p->lock);
+            ring->poller = 0;
+            releaseLockIrqrestore(&p->lock, sflags);
+            return -EAGAIN;
+        }
+    }
+    return USER_URING_ADDR;
+}
+
+/*
+ * io_uring_enter：提交最多 toSubmit 个请求，URING_ENTER_GETEVENTS 时再等待完成队列中至少有 minComplete 项
+ * 有轮询线程时请求由它取走，这里只在 URING_ENTER_SQ_WAKEUP 时唤醒它
+ * 返回提交的请求数
+ */
+long
+enterRing(usize toSubmit, usize minComplete, usize flags)
+{
+    Process *p = getCurrentThread()->process;
+    IoRing *ring = p ? p->ring : 0;
+    if(ring == 0) {
+        return -EINVAL;
+    }
+    long submitted = 0;
+    if(ring->poller) {
+        if(flags & URING_ENTER_SQ_WAKEUP) {
+            usize sflags = acquireLockIrqsave(&ring->lock);
+            notifyCondition(&ring->sqWait);
+            releaseLockIrqrestore(&ring->lock, sflags);
+        }
+    } else {
+        while(submitted < toSubmit && submitOne(ring)) {
+            submitted ++;
+        }
+    }
+    if(flags & URING_ENTER_GETEVENTS) {
+        if(minComplete > URING_CQ_ENTRIES) {
+            minComplete = URING_CQ_ENTRIES;
+        }
+        usize sflags = acquireLockIrqsave(&ring->lock);
+        // 没有执行中的请求，且没有轮询线程会取走新请求时，完成项不会再增加
+        while(ring->cqTail - __atomic_load_n(&ring->sh->cqHead, __ATOMIC_ACQUIRE) < minComplete
+                && (ring->inflight > 0 || (ring->poller && ring->sqHead != __atomic_load_n(&ring->sh->sqTail, __ATOMIC_ACQUIRE)))) {
+            waitCondition(&ring->cqWait, &ring->lock);
+        }
+        releaseLockIrqrestore(&ring->lock, sflags);
+    }
+    return submitted;
+}
+
+// 进程中的用户线程都已退出，通知轮询线程退出，它释放进程引用后进程才能被销毁
+void
+stopRing(IoRing *ring)
+{
+    usize flags = acquireLockIrqsave(&ring->lock);
+    ring->stop = 1;
+    notifyAllCondition(&ring->sqWait);
+    releaseLockIrqrestore(&ring->lock, flags);
+}
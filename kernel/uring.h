@@ -0,0 +1,89 @@
+/************************ 异步系统调用环形队列 ***************************
+ * Author：Joker001014
+ * 2025.03.30
+***********************************************************************/
+
+#ifndef _URING_H
+#define _URING_H
+
+#include "types.h"
+#include "spinlock.h"
+#include "condition.h"
+
+#define URING_SQ_ENTRIES    64      // 提交队列容量，需为 2 的幂
+#define URING_CQ_ENTRIES    256     // 完成队列容量，需为 2 的幂，大于提交队列以容纳未收割的完成项
+
+/* 请求的操作码 */
+#define URING_OP_NOP        0       // 空操作，直接完成
+#define URING_OP_READ       1       // 同 read(fd, addr, len)
+#define URING_OP_WRITE      2       // 同 write(fd, addr, len)
+#define URING_OP_TIMEOUT    3       // len 纳秒后完成，不占用提交者
+#define URING_OP_EXEC       4       // 执行 addr 处路径的程序，程序退出后完成
+
+/* io_uring_setup 的参数 */
+#define URING_SETUP_SQPOLL      (1 << 1)    // 创建内核轮询线程，提交请求不再需要系统调用
+
+/* io_uring_enter 的参数 */
+#define URING_ENTER_GETEVENTS   (1 << 0)    // 等待至少 minComplete 个完成项
+#define URING_ENTER_SQ_WAKEUP   (1 << 1)    // 唤醒休眠的轮询线程
+
+/* 共享区 flags 中的标志 */
+#define URING_SQ_NEED_WAKEUP    (1 << 0)    // 轮询线程已休眠，提交后需要 URING_ENTER_SQ_WAKEUP 唤醒
+
+// 提交队列项，由用户填写
+typedef struct {
+    uint8 opcode;       // 操作码
+    uint8 flags;        // 保留
+    uint16 reserved;
+    int fd;             // 文件描述符
+    usize addr;         // 缓冲区或路径的用户地址
+    usize len;          // 缓冲区长度，或超时的纳秒数
+    usize userData;     // 原样带回完成项，由用户区分请求
+} IoSqe;
+
+// 完成队列项，由内核填写
+typedef struct {
+    usize userData;     // 对应请求的 userData
+    long res;           // 结果，与对应系统调用的返回值相同
+} IoCqe;
+
+/*
+ * 映射到用户地址 USER_URING_ADDR 的共享区，第 0 页为队列头和提交队列，第 1 页为完成队列
+ * 提交队列：用户写入 sqes 后推进 sqTail，内核取走后推进 sqHead
+ * 完成队列：内核写入 cqes 后推进 cqTail，用户处理后推进 cqHead
+ * 下标只增不减，取槽位时与容量减一相与
+ */
+typedef struct {
+    uint32 sqHead;
+    uint32 sqTail;
+    uint32 cqHead;
+    uint32 cqTail;
+    uint32 sqEntries;
+    uint32 cqEntries;
+    uint32 flags;
+    uint32 reserved;
+    IoSqe sqes[URING_SQ_ENTRIES];
+} IoRingShared;
+
+// 每个进程至多一组环形队列
+typedef struct IoRing {
+    Spinlock lock;          // 保护下面的字段，定时器回调中也会获取，需关中断获取
+    IoRingShared *sh;       // 共享区第 0 页（内核通过线性映射访问）
+    IoCqe *cqes;            // 共享区第 1 页
+    usize frames[USER_URING_PAGES]; // 共享区的物理页
+    uint32 sqHead;          // 内核自己的下标，不信任用户可写的共享区中的副本
+    uint32 cqTail;
+    int inflight;           // 已取走尚未完成的请求数，取请求前为其预留完成队列的位置
+    int refs;               // 进程和未到期的超时请求各持有一个引用
+    int poller;             // 是否有轮询线程
+    int stop;               // 进程中的用户线程都已退出，轮询线程应退出
+    Condvar cqWait;         // 等待完成项的线程
+    Condvar sqWait;         // 休眠的轮询线程
+} IoRing;
+
+long setupRing(usize flags);
+long enterRing(usize toSubmit, usize minComplete, usize flags);
+void stopRing(IoRing *ring);
+void putRing(IoRing *ring);
+
+#endif
@@ -0,0 +1,42 @@
+/************************** 用户态共享数据页 ****************************
+ * Author：Joker001014
+ * 2025.03.29
+ * 启动时分配一页物理内存，创建进程时以 USER | READABLE 映射到用户地址空间，并标记为 SHARED
+ * 内核通过线性映射写入，用户只能读取；销毁地址空间时共享页不被释放
+***********************************************************************/
+
+#include "types.h"
+#include "def.h"
+#include "consts.h"
+#include "mapping.h"
+#include "ktimer.h"
+#include "vdso.h"
+
+VdsoData *VDSO;
+static usize VDSO_PADDR;
+
+void
+initVdso()
+{
+    VDSO_PADDR = allocFrame();      // 已清零
+    VDSO = (VdsoData *)accessVaViaPa(VDSO_PADDR);
+    VDSO->version = VDSO_VERSION;
+    VDSO->harts = MAX_CPU;
+    VDSO->timebaseFreq = TIMEBASE_FREQ;
+    VDSO->nsPerTime = 1000000000 / TIMEBASE_FREQ;
+    VDSO->bootTime = bootTime();
+    int hart;
+    for(hart = 0; hart < MAX_CPU; hart ++) {
+        VDSO->hart[hart].tid = -1;
+    }
+    printf("==== Init vDSO page ====\n");
+}
+
+// 将共享数据页只读映射到地址空间的 USER_VDSO_ADDR 处
+void
+mapVdso(usize rootPpn)
+{
+    Mapping m = {rootPpn};
+    PageTableEntry *entry = findEntry(m, USER_VDSO_ADDR / PAGE_SIZE);
+    *entry = (VDSO_PADDR >> 2) | USER | READABLE | SHARED | VALID;
+}
@@ -0,0 +1,47 @@
+/************************** 用户态共享数据页 ****************************
+ * Author：Joker001014
+ * 2025.03.29
+ * 内核维护、以只读方式映射到每个进程 USER_VDSO_ADDR 处的一页数据
+ * 用户程序直接读取时钟参数和调度统计，配合 scounteren 开放的 time/cycle/instret 计数器，计时无需系统调用
+***********************************************************************/
+
+#ifndef _VDSO_H
+#define _VDSO_H
+
+#include "types.h"
+#include "consts.h"
+
+#define VDSO_VERSION    1
+
+// 一个 hart 的调度信息，各字段由该 hart 单独更新，用户读到的是某一时刻的近似值
+typedef struct {
+    int tid;            // 正在运行的线程号（见 THREAD_ID），-1 表示空闲
+    uint32 reserved;
+    usize switches;     // 开始运行一个线程的次数
+    usize idleWaits;    // 无线程可运行而进入 wfi 的次数
+} VdsoHart;
+
+// 共享数据页的布局，需与 user/ulib.h 中的定义一致
+typedef struct {
+    uint32 version;     // 布局版本
+    uint32 harts;       // hart 数组的长度
+    usize timebaseFreq; // time 计数器的频率
+    usize nsPerTime;    // 一个 time 计数的纳秒数
+    usize bootTime;     // 内核启动时的 time 计数，单调时钟从这里开始
+    VdsoHart hart[MAX_CPU];
+} VdsoData;
+
+extern VdsoData *VDSO;
+
+void initVdso();
+void mapVdso(usize rootPpn);
+
+// 本 hart 切换到线程 id（-1 为调度线程）
+static inline void
+vdsoSwitch(int hart, int id)
+{
+    VDSO->hart[hart].tid = id;
+    VDSO->hart[hart].switches += 1;
+}
+
+#endif
@@ -0,0 +1,24 @@
+/************************** 用户程序dmesg.c *****************************
+ * Author：Joker001014
+ * 2025.03.30
+ * 输出内核日志缓冲区中保留的日志，每行前的 <n> 为日志级别
+***********************************************************************/
+
+#include "types.h"
+#include "ulib.h"
+
+#define DMESG_BUF   0x10000     // 大于内核各 hart 日志缓冲区的总和
+
+static char BUF[DMESG_BUF];
+
+uint64
+main()
+{
+    long n = syslog(SYSLOG_READ_ALL, BUF, DMESG_BUF);
+    if(n < 0) {
+        printf("dmesg: syslog failed %d\n", (int)n);
+        return 1;
+    }
+    write(1, BUF, n);
+    return 0;
+}
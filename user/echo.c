@@ -1,6 +1,7 @@
 /*********************** 将输入字符输出到屏幕上 ***************************
  * Author：Joker001014
  * 2025.03.16
+ * 终端切换到原始模式，每个字符到达即读到，回显和退格由程序自己处理
 ***********************************************************************/
 
 #include "types.h"
@@ -17,10 +18,14 @@ uint64
 main()
 {
     printf("Welcome to echo!\n");
+    ttyMode(TTY_RAW);
     int lineCount = 0;      // 当前输入行的字符数
     while(1) {
         // 从标准输入缓存区获取一个字符
-        uint8 c = getc();
+        int c = getc();
+        if(c == EOF) {
+            break;      // 标准输入为管道且写端已全部关闭
+        }
         // 字符处理
         switch(c) {
             // 换行/回车
@@ -46,5 +51,5 @@ main()
                 break;
         }
     }
+    return 0;
 }
-
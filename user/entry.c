@@ -29,5 +29,7 @@ _start(uint8 _args, uint8 *_argv)
 {
     // 初始化用户堆空间
     extern void initHeap();     initHeap();
-    sys_exit(main());
+    uint64 ret = main();
+    flush();        // 输出标准输出缓冲区中剩余的内容
+    sys_exit(ret);
 }
\ No newline at end of file
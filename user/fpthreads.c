@@ -0,0 +1,74 @@
+/************************ 用户程序fpthreads.c ****************************
+ * Author：Joker001014
+ * 2025.03.30
+ * 多个线程交替使用浮点寄存器，检查线程切换后各自的浮点状态没有被破坏
+ * 另有一个只使用整数的线程，它不会分配浮点上下文，切换时也不保存浮点寄存器
+***********************************************************************/
+
+#include "types.h"
+#include "ulib.h"
+
+#define FP_THREADS  3
+#define ROUNDS      2000
+
+// 浮点线程：每个线程用不同的步长累加，累加过程中频繁让出 CPU，结果应与整数计算一致
+uint64
+fpWorker(void *arg)
+{
+    int id = (int)(uint64)arg;
+    double step = (double)(id + 1) * 0.5;
+    double sum = 0.0;
+    int i;
+    for(i = 0; i < ROUNDS; i ++) {
+        sum += step;
+        if(i % 16 == 0) {
+            schedYield();
+        }
+    }
+    // 步长是 0.5 的整数倍，累加结果可以精确表示
+    uint64 expected = (uint64)(id + 1) * ROUNDS / 2;
+    uint64 got = (uint64)sum;
+    printf("fp thread %d: sum = %d, expected %d\n", id, (int)got, (int)expected);
+    return got == expected;
+}
+
+// 整数线程：不执行任何浮点指令
+uint64
+intWorker(void *arg)
+{
+    uint64 sum = 0;
+    int i;
+    for(i = 0; i < ROUNDS; i ++) {
+        sum += i;
+        if(i % 16 == 0) {
+            schedYield();
+        }
+    }
+    return sum == (uint64)ROUNDS * (ROUNDS - 1) / 2;
+}
+
+uint64
+main()
+{
+    UThread threads[FP_THREADS + 1];
+    int i;
+    for(i = 0; i < FP_THREADS; i ++) {
+        if(threadCreate(&threads[i], fpWorker, (void *)(uint64)i) < 0) {
+            printf("create thread %d failed\n", i);
+            return 1;
+        }
+    }
+    if(threadCreate(&threads[FP_THREADS], intWorker, 0) < 0) {
+        printf("create integer thread failed\n");
+        return 1;
+    }
+    int ok = 1;
+    for(i = 0; i <= FP_THREADS; i ++) {
+        if(threadJoin(&threads[i]) != 1) {
+            printf("thread %d got a wrong result\n", i);
+            ok = 0;
+        }
+    }
+    printf(ok ? "fpthreads passed\n" : "fpthreads failed\n");
+    return !ok;
+}
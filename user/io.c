@@ -2,6 +2,8 @@
  * Author：Joker001014
  * 2025.02.26
  * 大都拷贝自内核的 printf.c，OpenSBI 调用被替换为系统调用
+ * 标准输出先写入进程内的缓冲区，按行或缓冲区满时才通过一次 write 系统调用输出
+ * 标准输入一次 read 读取所有已到达的字符，之后的 getc 直接从缓冲区取
 ***********************************************************************/
 
 #include <stdarg.h>     // 对于参数不定场景，使用 va_list 迭代遍历采参数
@@ -12,19 +14,138 @@
 // 提供 16 进制数字字符的映射，供 printint 和 printptr 使用
 static char digits[] = "0123456789abcdef";
 
-// 从标准输入缓存区获取一个字符
-uint8 getc()
+#define OUT_BUF_SIZE    1024
+#define IN_BUF_SIZE     256
+
+// 标准输出缓冲区，由进程内所有线程共享，lock 保证一次 printf 的内容在缓冲区中连续
+static struct {
+    Mutex lock;
+    int mode;           // 刷新策略，见 ulib.h 中的 BUF_*
+    int len;            // 缓冲区中待输出的字节数
+    char buf[OUT_BUF_SIZE];
+} OUT = {.mode = BUF_LINE};
+
+// 标准输入缓冲区，buf[pos, len) 为已读入未取走的字符
+static struct {
+    Mutex lock;
+    int pos;
+    int len;
+    char buf[IN_BUF_SIZE];
+} IN;
+
+// 从 fd 读取最多 len 个字节，返回读取的字节数或负的错误码
+long read(int fd, void *buf, uint64 len)
+{
+    return (long)sys_read(fd, buf, len);
+}
+
+// 向 fd 写入 len 个字节，返回写入的字节数或负的错误码
+long write(int fd, void *buf, uint64 len)
+{
+    return (long)sys_write(fd, buf, len);
+}
+
+// 创建管道，fds[0] 为读端，fds[1] 为写端，失败返回负的错误码
+int pipe(int fds[2])
+{
+    return (int)(long)sys_pipe2(fds);
+}
+
+// 关闭文件描述符
+int close(int fd)
+{
+    return (int)(long)sys_close(fd);
+}
+
+// 按页传递管道数据，addr 和 len 需按页对齐
+// fd 为写端时交出这些页（之后这段内存变为全零），为读端时把管道中的整页直接映射到这段地址上
+long vmsplice(int fd, void *addr, uint64 len)
+{
+    return (long)sys_vmsplice(fd, addr, len);
+}
+
+// 执行程序并等待其退出；stdio 不为 0 时其中的描述符作为程序的标准输入、标准输出（为负数时保持控制台）
+// 传入的描述符移交给新程序，在本进程中被关闭
+long exec(char *path, int stdio[2])
+{
+    return (long)sys_exec(path, stdio);
+}
+
+// 输出缓冲区中的所有内容（需持有 OUT.lock）
+static void flushLocked()
 {
-    uint8 c;
-    // 读取的文件描述符，读取的字节数组，读取的长度
-    sys_read(0, &c, 1);
+    int off = 0;
+    while(off < OUT.len) {
+        long n = write(1, OUT.buf + off, OUT.len - off);
+        if(n <= 0)
+            break;      // 输出失败，丢弃剩余内容
+        off += n;
+    }
+    OUT.len = 0;
+}
+
+// 向缓冲区放入一个字符，按刷新策略输出（需持有 OUT.lock）
+static void putcLocked(int c)
+{
+    OUT.buf[OUT.len++] = c;
+    if(OUT.len == OUT_BUF_SIZE || OUT.mode == BUF_NONE || (OUT.mode == BUF_LINE && c == '\n'))
+        flushLocked();
+}
+
+// 立即输出标准输出缓冲区中的内容
+void flush()
+{
+    mutexLock(&OUT.lock);
+    flushLocked();
+    mutexUnlock(&OUT.lock);
+}
+
+// 设置标准输出的刷新策略：BUF_NONE-每个字符输出，BUF_LINE-遇到换行输出，BUF_FULL-缓冲区满才输出
+void setBufferMode(int mode)
+{
+    mutexLock(&OUT.lock);
+    flushLocked();
+    OUT.mode = mode;
+    mutexUnlock(&OUT.lock);
+}
+
+// 从标准输入缓存区获取一个字符，输入结束或读取出错时返回 EOF
+// 缓冲区为空时先输出标准输出中的内容（提示符、回显），再一次读入所有已到达的字符
+int getc()
+{
+    int c = EOF;
+    mutexLock(&IN.lock);
+    if(IN.pos == IN.len) {
+        flush();
+        long n = read(0, IN.buf, IN_BUF_SIZE);
+        IN.pos = 0;
+        IN.len = n > 0 ? n : 0;
+    }
+    if(IN.pos < IN.len) {
+        c = IN.buf[IN.pos++];
+    }
+    mutexUnlock(&IN.lock);
     return c;
 }
 
+// 设置标准输入的终端模式，返回原来的模式
+int ttyMode(int mode)
+{
+    return (int)(long)sys_ioctl(0, TTY_SETMODE, mode);
+}
+
+// 读取内核日志（SYSLOG_READ_ALL）或设置控制台日志级别（SYSLOG_CONSOLE_LEVEL，len 为级别）
+long syslog(int type, char *buf, uint64 len)
+{
+    return (long)sys_syslog(type, buf, len);
+}
+
 // 向终端输出一个字符
 void putchar(int c)
 {
-    sys_write(c);
+    mutexLock(&OUT.lock);
+    putcLocked(c);
+    mutexUnlock(&OUT.lock);
 }
 
 /*
@@ -55,7 +176,7 @@ printint(int xx, int base, int sign)
         buf[i++] = '-';
 
     while (--i >= 0)
-        putchar(buf[i]);
+        putcLocked(buf[i]);
 }
 
 /*
@@ -66,10 +187,10 @@ static void
 printptr(uint64 x)
 {
     int i;
-    putchar('0');
-    putchar('x');
+    putcLocked('0');
+    putcLocked('x');
     for (i = 0; i < (sizeof(uint64) * 2); i++, x <<= 4)
-        putchar(digits[x >> (sizeof(uint64) * 8 - 4)]);
+        putcLocked(digits[x >> (sizeof(uint64) * 8 - 4)]);
 }
 
 /*
@@ -90,12 +211,13 @@ void printf(char *fmt, ...)
     if (fmt == 0)
         panic("null fmt");
 
+    mutexLock(&OUT.lock);   // 一次 printf 的内容在缓冲区中连续，不与其他线程交错
     va_start(ap, fmt);
     for (i = 0; (c = fmt[i] & 0xff) != 0; i++)
     {
         if (c != '%')
         {
-            putchar(c);
+            putcLocked(c);
             continue;
         }
         c = fmt[++i] & 0xff;
@@ -116,17 +238,19 @@ void printf(char *fmt, ...)
             if ((s = va_arg(ap, char *)) == 0)
                 s = "(null)";
             for (; *s; s++)
-                putchar(*s);
+                putcLocked(*s);
             break;
         case '%':
-            putchar('%');
+            putcLocked('%');
             break;
         default:
-            putchar('%');
-            putchar(c);
+            putcLocked('%');
+            putcLocked(c);
             break;
         }
     }
+    va_end(ap);
+    mutexUnlock(&OUT.lock);
 }
 
 /*
@@ -138,6 +262,7 @@ void panic(char *s)
     printf("panic: ");
     printf(s);
     printf("\n");
+    flush();
     sys_exit(1);
 }
 
@@ -0,0 +1,55 @@
+/************************** U-Mode 同步 IPC ******************************
+ * Author：Joker001014
+ * 2025.03.30
+ * 消息的四个字直接放在 a1 ~ a4 中，系统调用返回时回复也在 a1 ~ a4 中，不经过内存
+***********************************************************************/
+
+#include "types.h"
+#include "ulib.h"
+#include "syscall.h"
+
+// a0 为端口，a1 ~ a4 为消息，a5 为回复对象，成功（a0 非负）时把 a1 ~ a4 写回 msg
+static long
+ipcSyscall(SyscallId num, int port, long replyTo, IpcMsg *msg)
+{
+    register unsigned long a0 asm("a0") = (unsigned long)port;
+    register unsigned long a1 asm("a1") = msg->w[0];
+    register unsigned long a2 asm("a2") = msg->w[1];
+    register unsigned long a3 asm("a3") = msg->w[2];
+    register unsigned long a4 asm("a4") = msg->w[3];
+    register unsigned long a5 asm("a5") = (unsigned long)replyTo;
+    register unsigned long a7 asm("a7") = (unsigned long)num;
+    asm volatile("ecall"
+                : "+r"(a0), "+r"(a1), "+r"(a2), "+r"(a3), "+r"(a4)
+                : "r"(a5), "r"(a7)
+                : "memory");
+    if((long)a0 >= 0) {
+        msg->w[0] = a1;
+        msg->w[1] = a2;
+        msg->w[2] = a3;
+        msg->w[3] = a4;
+    }
+    return (long)a0;
+}
+
+// 向端口 port 发送 msg 并等待回复，回复写回 msg，成功返回 0
+long
+ipcCall(int port, IpcMsg *msg)
+{
+    return ipcSyscall(IpcCall, port, -1, msg);
+}
+
+// 服务端：replyTo 不为 -1 时先把 msg 作为回复交给线程 replyTo，再等待下一个请求
+// 请求写入 msg，返回发送者的线程号，之后以它作为 replyTo 回复
+long
+ipcReplyWait(int port, long replyTo, IpcMsg *msg)
+{
+    return ipcSyscall(IpcReplyWait, port, replyTo, msg);
+}
+
+// 只把 msg 作为回复交给线程 replyTo，不等待下一个请求
+long
+ipcReply(int port, long replyTo, IpcMsg *msg)
+{
+    return ipcSyscall(IpcReply, port, replyTo, msg);
+}
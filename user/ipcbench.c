@@ -0,0 +1,125 @@
+/************************ 用户程序ipcbench.c *****************************
+ * Author：Joker001014
+ * 2025.03.30
+ * 同步 IPC 往返延迟：客户端与服务端线程之间反复 ipcCall / ipcReplyWait
+ * 对比用互斥锁和条件变量（futex）实现的同样的乒乓往返
+***********************************************************************/
+
+#include "types.h"
+#include "ulib.h"
+
+#define PORT        1
+#define ROUNDS      10000
+#define QUIT        ((uint64)-1)
+
+// IPC 服务端：把请求的每个字加一后作为回复，收到 QUIT 时只回复并退出
+uint64
+ipcServer(void *arg)
+{
+    IpcMsg msg;
+    long from = ipcReplyWait(PORT, -1, &msg);
+    while(from >= 0) {
+        int quit = msg.w[0] == QUIT;
+        int i;
+        for(i = 0; i < 4; i ++) {
+            msg.w[i] += 1;
+        }
+        if(quit) {
+            ipcReply(PORT, from, &msg);
+            return 0;
+        }
+        from = ipcReplyWait(PORT, from, &msg);
+    }
+    printf("ipcbench: reply_wait returned %d\n", (int)from);
+    return 1;
+}
+
+// futex 乒乓：turn 为 0 时轮到服务端，为 1 时轮到客户端
+static Mutex LOCK;
+static Cond CHANGED;
+static int TURN;
+static uint64 VALUE;
+
+uint64
+futexServer(void *arg)
+{
+    int n;
+    for(n = 0; n < ROUNDS; n ++) {
+        mutexLock(&LOCK);
+        while(TURN != 0) {
+            condWait(&CHANGED, &LOCK);
+        }
+        VALUE += 1;
+        TURN = 1;
+        condSignal(&CHANGED);
+        mutexUnlock(&LOCK);
+    }
+    return 0;
+}
+
+static void
+report(char *name, uint64 ns, int bad)
+{
+    printf("ipcbench: %s %d round trips in %d us, %d ns per round trip, %d bad replies\n",
+            name, ROUNDS, (int)(ns / 1000), (int)(ns / ROUNDS), bad);
+}
+
+static void
+runIpc()
+{
+    UThread t;
+    threadCreate(&t, ipcServer, 0);
+    IpcMsg msg;
+    int n, bad = 0;
+    uint64 start = clockNs();
+    for(n = 0; n < ROUNDS; n ++) {
+        msg.w[0] = n;
+        msg.w[1] = n * 2;
+        msg.w[2] = n * 3;
+        msg.w[3] = n * 4;
+        if(ipcCall(PORT, &msg) < 0) {
+            printf("ipcbench: call failed\n");
+            break;
+        }
+        bad += msg.w[0] != n + 1 || msg.w[3] != n * 4 + 1;
+    }
+    uint64 ns = clockNs() - start;
+    msg.w[0] = QUIT;
+    ipcCall(PORT, &msg);
+    threadJoin(&t);
+    report("ipc call  ", ns, bad);
+}
+
+static void
+runFutex()
+{
+    mutexInit(&LOCK);
+    condInit(&CHANGED);
+    TURN = 0;
+    VALUE = 0;
+    UThread t;
+    threadCreate(&t, futexServer, 0);
+    int n, bad = 0;
+    uint64 start = clockNs();
+    for(n = 0; n < ROUNDS; n ++) {
+        mutexLock(&LOCK);
+        while(TURN != 1) {
+            condWait(&CHANGED, &LOCK);
+        }
+        bad += VALUE != n + 1;
+        TURN = 0;
+        condSignal(&CHANGED);
+        mutexUnlock(&LOCK);
+    }
+    uint64 ns = clockNs() - start;
+    threadJoin(&t);
+    report("futex cond", ns, bad);
+}
+
+uint64
+main()
+{
+    runIpc();
+    runFutex();
+    return 0;
+}
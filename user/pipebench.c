@@ -0,0 +1,91 @@
+/************************ 用户程序pipebench.c ****************************
+ * Author：Joker001014
+ * 2025.03.30
+ * 两个线程通过管道传递数据，比较 read/write 拷贝和 vmsplice 按页传递的吞吐量
+***********************************************************************/
+
+#include "types.h"
+#include "ulib.h"
+
+#define PAGE        4096
+#define CHUNK_PAGES 8                       // 每次传递的页数
+#define CHUNK       (CHUNK_PAGES * PAGE)
+#define TOTAL       (4 * 1024 * 1024)       // 每种方式传递的总字节数
+
+static char SRC[CHUNK] __attribute__((aligned(PAGE)));
+static char DST[CHUNK] __attribute__((aligned(PAGE)));
+static int FDS[2];
+static int SPLICE;      // 当前是否使用 vmsplice
+
+// 写者：每块的每页以块号和页号填充首字节，交给管道
+uint64
+producer(void *arg)
+{
+    int chunk, i;
+    for(chunk = 0; chunk < TOTAL / CHUNK; chunk ++) {
+        for(i = 0; i < CHUNK_PAGES; i ++) {
+            SRC[i * PAGE] = (char)(chunk * CHUNK_PAGES + i);
+        }
+        long n = SPLICE ? vmsplice(FDS[1], SRC, CHUNK) : write(FDS[1], SRC, CHUNK);
+        if(n != CHUNK) {
+            printf("pipebench: write returned %d\n", (int)n);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// 读者：读满一块后检查每页的首字节，返回检查出错的页数
+static int
+consume()
+{
+    int bad = 0, page = 0;
+    uint64 got = 0;
+    while(got < TOTAL) {
+        uint64 filled = 0;
+        while(filled < CHUNK) {
+            long n = SPLICE ? vmsplice(FDS[0], DST + filled, CHUNK - filled)
+                            : read(FDS[0], DST + filled, CHUNK - filled);
+            if(n <= 0) {
+                printf("pipebench: read returned %d\n", (int)n);
+                return -1;
+            }
+            filled += n;
+        }
+        int i;
+        for(i = 0; i < CHUNK_PAGES; i ++, page ++) {
+            bad += DST[i * PAGE] != (char)page;
+        }
+        got += CHUNK;
+    }
+    return bad;
+}
+
+// 用一种方式传递 TOTAL 字节并报告吞吐量
+static void
+run(char *name, int splice)
+{
+    SPLICE = splice;
+    UThread t;
+    uint64 start = clockNs();
+    threadCreate(&t, producer, 0);
+    int bad = consume();
+    threadJoin(&t);
+    uint64 ns = clockNs() - start;
+    printf("pipebench: %s %d KiB in %d us, %d MiB/s, %d bad pages\n", name, TOTAL / 1024,
+            (int)(ns / 1000), (int)((uint64)TOTAL * 1000000000 / (ns ? ns : 1) / (1024 * 1024)), bad);
+}
+
+uint64
+main()
+{
+    if(pipe(FDS) < 0) {
+        printf("pipebench: cannot create pipe\n");
+        return 1;
+    }
+    run("copy    ", 0);
+    run("vmsplice", 1);
+    close(FDS[0]);
+    close(FDS[1]);
+    return 0;
+}
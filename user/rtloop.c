@@ -0,0 +1,43 @@
+/************************* 用户程序rtloop.c ****************************
+ * Author：Joker001014
+ * 2025.03.27
+ * 周期性控制循环：以实时线程运行若干周期，每个周期完成一次作业后让出 CPU，最后打印截止时刻统计
+***********************************************************************/
+
+#include "types.h"
+#include "ulib.h"
+
+#define RUNTIME     20000       // 每周期预算 20ms
+#define PERIOD      100000      // 周期 100ms
+#define DEADLINE    50000       // 周期开始后 50ms 内完成
+#define JOBS        20
+#define WORK        20000       // 每次作业的计算量
+
+static volatile uint64 SINK;
+
+uint64
+main()
+{
+    if(schedSetattr(RUNTIME, PERIOD, DEADLINE) < 0) {
+        printf("rtloop: admission rejected\n");
+        return 1;
+    }
+    int job, i;
+    uint64 busy = 0, cycles = 0;    // 作业本身的耗时，通过共享数据页和计数器测量，不引入系统调用
+    for(job = 0; job < JOBS; job ++) {
+        uint64 start = clockNs(), c = rdcycle();
+        for(i = 0; i < WORK; i ++) {
+            SINK += i;
+        }
+        cycles += rdcycle() - c;
+        busy += clockNs() - start;
+        schedYield();   // 本周期作业完成，等待下一周期
+    }
+    SchedAttr attr;
+    schedGetattr(&attr);
+    printf("rtloop: runtime %d period %d deadline %d us\n", (int)attr.runtime, (int)attr.period, (int)attr.deadline);
+    printf("rtloop: jobs %d, misses %d, overruns %d\n", (int)attr.jobs, (int)attr.misses, (int)attr.overruns);
+    printf("rtloop: average job %d us, %d cycles\n", (int)(busy / JOBS / 1000), (int)(cycles / JOBS));
+    schedSetattr(0, 0, 0);
+    return 0;
+}
@@ -1,17 +1,23 @@
 /***************************** shell 终端 ******************************
  * Author：Joker001014
  * 2025.03.16
+ * 终端处于规范模式，回显和退格由内核的行规程处理，这里每次读到的都是完整的一行
+ * 用 | 连接的多个程序同时运行，前一个程序的标准输出通过管道接到后一个程序的标准输入
 ***********************************************************************/
 
 #include "types.h"
 #include "ulib.h"
-#include "syscall.h"
 
 // 定义一些控制字符常量
 #define LF 0x0au        // 换行
-#define CR 0x0du        // 回车
-#define BS 0x08u        // 退格
-#define DL 0x7fu        // 删除
+
+#define MAX_STAGES  8   // 一行命令中最多用 | 连接的程序数
+
+// 管道中的一个程序
+typedef struct {
+    char *path;         // 程序路径
+    int stdio[2];       // 标准输入、标准输出的描述符，-1 表示控制台
+} Stage;
 
 // 判断当前行是否为空
 int
@@ -36,47 +42,125 @@ empty(char *line, int length)
     }
 }
 
+// 去掉命令首尾的空白
+char *
+trim(char *s)
+{
+    while(*s == ' ' || *s == '\t') {
+        s ++;
+    }
+    char *end = s;
+    while(*end != 0) {
+        end ++;
+    }
+    while(end > s && (end[-1] == ' ' || end[-1] == '\t')) {
+        end --;
+    }
+    *end = 0;
+    return s;
+}
+
+// 在单独的线程中执行管道中的一个程序并等待其退出
+// 执行成功时描述符已移交给程序，失败时在这里关闭，相邻的程序才不会一直等待
+uint64
+runStage(void *arg)
+{
+    Stage *s = arg;
+    exec(s->path, s->stdio);
+    if(s->stdio[0] >= 0) close(s->stdio[0]);
+    if(s->stdio[1] >= 0) close(s->stdio[1]);
+    return 0;
+}
+
+// 执行一行命令，多个程序用 | 连接时为每两个相邻的程序创建一个管道，各程序同时运行
+void
+runLine(char *line)
+{
+    Stage stages[MAX_STAGES];
+    UThread threads[MAX_STAGES];
+    int n = 0, i;
+    char *p = line;
+    while(1) {
+        char *start = p;
+        while(*p != 0 && *p != '|') {
+            p ++;
+        }
+        int last = *p == 0;
+        *p = 0;
+        if(n == MAX_STAGES) {
+            printf("Too many commands in a pipeline!\n");
+            return;
+        }
+        stages[n].path = trim(start);
+        stages[n].stdio[0] = -1;
+        stages[n].stdio[1] = -1;
+        if(stages[n].path[0] == 0) {
+            printf("Empty command in a pipeline!\n");
+            return;
+        }
+        n ++;
+        if(last) break;
+        p ++;
+    }
+    if(n == 1) {
+        exec(stages[0].path, 0);
+        return;
+    }
+    for(i = 0; i + 1 < n; i ++) {
+        int fds[2];
+        if(pipe(fds) < 0) {
+            printf("Cannot create pipe!\n");
+            for(i = i - 1; i >= 0; i --) {
+                close(stages[i].stdio[1]);
+                close(stages[i + 1].stdio[0]);
+            }
+            return;
+        }
+        stages[i].stdio[1] = fds[1];
+        stages[i + 1].stdio[0] = fds[0];
+    }
+    for(i = 0; i < n; i ++) {
+        if(threadCreate(&threads[i], runStage, &stages[i]) < 0) {
+            printf("Cannot run %s!\n", stages[i].path);
+            if(stages[i].stdio[0] >= 0) close(stages[i].stdio[0]);
+            if(stages[i].stdio[1] >= 0) close(stages[i].stdio[1]);
+        }
+    }
+    for(i = 0; i < n; i ++) {
+        if(threads[i].tid >= 0) threadJoin(&threads[i]);
+    }
+}
+
 uint64
 main()
 {
     char line[256];
     int lineCount = 0;      // 当前输入行的字符数
+    empty(line, 256);
     printf("Welcome to Moonix!\n");
     printf("$ ");
     while(1) {
         // 从标准输入缓存区获取一个字符
-        uint8 c = getc();
-        // 字符处理
-        switch(c) {
-            // 换行/回车
-            case LF: case CR: 
-                printf("\n");
-                // 当前行不为空，则执行指令
-                if(!isEmpty(line, 256)) {
-                    sys_exec(line);     // 执行指令
-                    lineCount = 0;      // 清空当前指令行
-                    empty(line, 256);
-                }
-                printf("$ ");
-                break;
-            // 删除
-            case DL:
-                if(lineCount > 0) {
-                    putchar(BS);        // 退格
-                    putchar(' ');       // 输出空格覆盖
-                    putchar(BS);        // 退格
-                    line[lineCount-1] = 0;
-                    lineCount -= 1;
-                }
-                break;
-            // 其他字符正常输出
-            default:
-                if(lineCount < 255) {
-                    line[lineCount] = c;    // 记录指令
-                    lineCount += 1;
-                    putchar(c);
-                }
-                break;
+        int c = getc();
+        if(c == EOF) {
+            // 标准输入为管道且写端已全部关闭，执行最后一行后退出
+            if(!isEmpty(line, 256)) {
+                runLine(line);
+            }
+            return 0;
+        }
+        // 字符处理，字符已由内核回显
+        if(c == LF) {
+            // 当前行不为空，则执行指令
+            if(!isEmpty(line, 256)) {
+                runLine(line);      // 执行指令
+            }
+            lineCount = 0;          // 清空当前指令行
+            empty(line, 256);
+            printf("$ ");
+        } else if(lineCount < 255) {
+            line[lineCount] = c;    // 记录指令
+            lineCount += 1;
         }
     }
 }
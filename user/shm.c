@@ -0,0 +1,39 @@
+/************************ U-Mode 共享内存段 *****************************
+ * Author：Joker001014
+ * 2025.03.30
+ * 按名字创建或打开共享内存段，映射到本进程后直接读写，与其他进程交换数据不需要系统调用
+***********************************************************************/
+
+#include "types.h"
+#include "ulib.h"
+#include "syscall.h"
+
+// 创建名为 name、至少 size 字节的共享内存段，同名的段已存在时打开它
+// 返回段号，失败返回负的错误码；本进程退出前段不会被释放
+int
+shmCreate(char *name, uint64 size)
+{
+    uint64 len = 0;
+    while(name[len] != 0) {
+        len ++;
+    }
+    return (int)(long)sys_shmget(name, len, size);
+}
+
+// 将段映射到 addr 处，addr 为 0 时由内核选择地址，返回映射地址，失败返回 0
+void *
+shmAttach(int id, void *addr)
+{
+    long ret = (long)sys_shmat(id, addr);
+    if(ret < 0 && ret > -4096) {
+        return 0;
+    }
+    return (void *)ret;
+}
+
+// 解除 addr 处的映射，所有映射都已解除且打开过段的进程都已退出后段被释放
+int
+shmDetach(void *addr)
+{
+    return (int)(long)sys_shmdt(addr);
+}
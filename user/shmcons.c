@@ -0,0 +1,44 @@
+/************************ 用户程序shmcons.c *****************************
+ * Author：Joker001014
+ * 2025.03.30
+ * 共享内存消费者：从共享内存段中的环形队列直接读取 shmprod 写入的数据并校验，报告吞吐量
+***********************************************************************/
+
+#include "types.h"
+#include "ulib.h"
+#include "shmring.h"
+
+uint64
+main()
+{
+    int id = shmCreate(SHM_RING_NAME, SHM_RING_SIZE);
+    ShmRing *ring = id < 0 ? 0 : shmAttach(id, 0);
+    if(ring == 0) {
+        printf("shmcons: cannot attach shared memory\n");
+        return 1;
+    }
+    uint64 start = clockNs();
+    uint32 n, bad = 0;
+    for(n = 0; n < SHM_TOTAL_SLOTS; n ++) {
+        mutexLock(&ring->lock);
+        while(ring->tail == n) {
+            condWait(&ring->changed, &ring->lock);
+        }
+        mutexUnlock(&ring->lock);
+        uint64 *slot = SHM_SLOT(ring, n);
+        int i;
+        for(i = 0; i < SHM_SLOT_SIZE / sizeof(uint64); i ++) {
+            bad += slot[i] != n + i;
+        }
+        mutexLock(&ring->lock);
+        ring->head = n + 1;
+        condBroadcast(&ring->changed);
+        mutexUnlock(&ring->lock);
+    }
+    uint64 ns = clockNs() - start;
+    uint64 bytes = (uint64)SHM_TOTAL_SLOTS * SHM_SLOT_SIZE;
+    printf("shmcons: %d KiB in %d us, %d MiB/s, %d bad words\n", (int)(bytes / 1024), (int)(ns / 1000),
+            (int)(bytes * 1000000000 / (ns ? ns : 1) / (1024 * 1024)), (int)bad);
+    shmDetach(ring);
+    return 0;
+}
@@ -0,0 +1,40 @@
+/************************ 用户程序shmprod.c *****************************
+ * Author：Joker001014
+ * 2025.03.30
+ * 共享内存生产者：把数据直接写入共享内存段中的环形队列，与 shmcons 同时运行（shmprod | shmcons）
+***********************************************************************/
+
+#include "types.h"
+#include "ulib.h"
+#include "shmring.h"
+
+uint64
+main()
+{
+    int id = shmCreate(SHM_RING_NAME, SHM_RING_SIZE);
+    ShmRing *ring = id < 0 ? 0 : shmAttach(id, 0);
+    if(ring == 0) {
+        printf("shmprod: cannot attach shared memory\n");
+        return 1;
+    }
+    uint32 n;
+    for(n = 0; n < SHM_TOTAL_SLOTS; n ++) {
+        mutexLock(&ring->lock);
+        while(ring->tail - ring->head == SHM_SLOTS) {
+            condWait(&ring->changed, &ring->lock);
+        }
+        mutexUnlock(&ring->lock);
+        // 空槽只属于生产者，填充数据时不持有锁
+        uint64 *slot = SHM_SLOT(ring, n);
+        int i;
+        for(i = 0; i < SHM_SLOT_SIZE / sizeof(uint64); i ++) {
+            slot[i] = n + i;
+        }
+        mutexLock(&ring->lock);
+        ring->tail = n + 1;
+        condBroadcast(&ring->changed);
+        mutexUnlock(&ring->lock);
+    }
+    shmDetach(ring);
+    return 0;
+}
@@ -0,0 +1,29 @@
+/*********************** 共享内存环形队列布局 ****************************
+ * Author：Joker001014
+ * 2025.03.30
+ * shmprod 和 shmcons 共用的共享内存段布局：首页为控制块，之后是 SHM_SLOTS 个数据槽
+***********************************************************************/
+
+#ifndef _SHMRING_H
+#define _SHMRING_H
+
+#define SHM_RING_NAME   "bulk"
+#define SHM_PAGE        4096
+#define SHM_SLOTS       8
+#define SHM_SLOT_SIZE   (64 * 1024)
+#define SHM_RING_SIZE   (SHM_PAGE + SHM_SLOTS * SHM_SLOT_SIZE)
+#define SHM_TOTAL_SLOTS 256             // 共传递 16 MiB
+
+// 控制块，新段的内容全为 0，锁和条件变量不需要再初始化
+// futex 按物理地址区分，不同进程可以在其中的锁和条件变量上等待
+typedef struct {
+    Mutex lock;
+    Cond changed;       // head 或 tail 改变时通知
+    uint32 head;        // 消费者下一个读取的槽
+    uint32 tail;        // 生产者下一个写入的槽
+} ShmRing;
+
+// 第 n 个槽的数据
+#define SHM_SLOT(ring, n)   ((uint64 *)((char *)(ring) + SHM_PAGE + ((n) % SHM_SLOTS) * SHM_SLOT_SIZE))
+
+#endif
@@ -0,0 +1,19 @@
+/************************** 用户程序stats.c *****************************
+ * Author：Joker001014
+ * 2025.03.30
+ * 输出线程表和内核各子系统的统计信息（负载均衡、锁竞争、RCU、TLB、浮点、EDF、定时器、串口等）
+***********************************************************************/
+
+#include "types.h"
+#include "ulib.h"
+
+uint64
+main()
+{
+    long ret = syslog(SYSLOG_KERNEL_STATS, 0, 0);
+    if(ret < 0) {
+        printf("stats: syslog failed %d\n", (int)ret);
+        return 1;
+    }
+    return 0;
+}
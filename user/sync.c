@@ -0,0 +1,105 @@
+/************************* U-Mode 同步原语 *****************************
+ * Author：Joker001014
+ * 2025.03.23
+ * 基于 futex 系统调用的互斥锁和条件变量
+ * 无竞争时只使用原子指令，不进入内核；有竞争时等待者在内核中休眠，不再空转消耗时间片
+***********************************************************************/
+
+#include "types.h"
+#include "ulib.h"
+#include "syscall.h"
+
+#define ETIMEDOUT   110
+
+void
+mutexInit(Mutex *m)
+{
+    m->state = 0;
+}
+
+// 加锁：0->1 成功则直接返回；否则将状态置为 2，表示有等待者，并休眠到锁被释放
+void
+mutexLock(Mutex *m)
+{
+    uint32 c = 0;
+    if(__atomic_compare_exchange_n(&m->state, &c, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return;
+    }
+    if(c != 2) {
+        c = __atomic_exchange_n(&m->state, 2, __ATOMIC_ACQUIRE);
+    }
+    while(c != 0) {
+        sys_futex_wait(&m->state, 2, 0);
+        c = __atomic_exchange_n(&m->state, 2, __ATOMIC_ACQUIRE);
+    }
+}
+
+// 尝试加锁，成功返回 1
+int
+mutexTryLock(Mutex *m)
+{
+    uint32 c = 0;
+    return __atomic_compare_exchange_n(&m->state, &c, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+// 解锁：只有状态为 2（可能有等待者）时才进入内核唤醒一个等待者
+void
+mutexUnlock(Mutex *m)
+{
+    if(__atomic_exchange_n(&m->state, 0, __ATOMIC_RELEASE) == 2) {
+        sys_futex_wake(&m->state, 1);
+    }
+}
+
+void
+condInit(Cond *c)
+{
+    c->seq = 0;
+}
+
+// 重新获取互斥锁，被条件变量唤醒后总是以“有等待者”状态加锁，避免遗漏其他等待者
+static void
+mutexRelock(Mutex *m)
+{
+    while(__atomic_exchange_n(&m->state, 2, __ATOMIC_ACQUIRE) != 0) {
+        sys_futex_wait(&m->state, 2, 0);
+    }
+}
+
+// 释放互斥锁并等待通知，返回前重新持有互斥锁
+// 解锁前读取序号，解锁后到达的通知会改变序号，futex 等待会立即返回而不会丢失
+void
+condWait(Cond *c, Mutex *m)
+{
+    uint32 seq = __atomic_load_n(&c->seq, __ATOMIC_RELAXED);
+    mutexUnlock(m);
+    sys_futex_wait(&c->seq, seq, 0);
+    mutexRelock(m);
+}
+
+// 带超时的等待，ns 为等待的纳秒数（不为 0），超时返回 0，否则返回 1
+int
+condTimedWait(Cond *c, Mutex *m, uint64 ns)
+{
+    uint32 seq = __atomic_load_n(&c->seq, __ATOMIC_RELAXED);
+    mutexUnlock(m);
+    long ret = (long)sys_futex_wait(&c->seq, seq, ns);
+    mutexRelock(m);
+    return ret != -ETIMEDOUT;
+}
+
+// 唤醒一个等待者
+void
+condSignal(Cond *c)
+{
+    __atomic_fetch_add(&c->seq, 1, __ATOMIC_RELEASE);
+    sys_futex_wake(&c->seq, 1);
+}
+
+// 唤醒所有等待者
+void
+condBroadcast(Cond *c)
+{
+    __atomic_fetch_add(&c->seq, 1, __ATOMIC_RELEASE);
+    sys_futex_wake(&c->seq, 0x7fffffff);
+}
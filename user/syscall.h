@@ -8,10 +8,34 @@
 
 // 系统调用号定义
 typedef enum {
-    Read = 63,      // 从标准输入读取字符
-    Write = 64,     // 向屏幕输出字符
+    Ioctl = 29,     // 设备控制，目前只用于设置终端模式
+    Close = 57,     // 关闭文件描述符
+    Pipe2 = 59,     // 创建管道
+    Read = 63,      // 从 fd 读取到缓冲区
+    Write = 64,     // 向 fd 写入缓冲区
+    Vmsplice = 75,  // 按页传递管道数据，不拷贝
     Exit = 93,      // 退出当前线程
+    FutexWait = 98, // 若 futex 字仍为期望值则休眠
+    FutexWake = 99, // 唤醒等待在 futex 字上的线程
+    Nanosleep = 101,    // 休眠指定的秒数和纳秒数
+    ClockGettime = 113, // 读取单调时钟（纳秒）
+    Syslog = 116,   // 读取内核日志
+    SchedYield = 124,   // 让出 CPU，实时线程表示本周期作业完成
+    SetPriority = 140,  // 设置线程的 nice 值
+    Gettid = 178,   // 获取当前线程 tid
+    ShmGet = 194,   // 按名字创建或打开共享内存段
+    ShmAt = 196,    // 映射共享内存段
+    ShmDt = 197,    // 解除共享内存段的映射
+    Clone = 220,    // 在当前进程中创建线程
     Exec = 221,     // 执行程序系统调用
+    Join = 260,     // 等待同一进程中的线程退出
+    SchedSetattr = 274, // 设置当前线程的实时参数
+    SchedGetattr = 275, // 读取当前线程的实时参数和统计
+    IoUringSetup = 425, // 创建异步系统调用的环形队列
+    IoUringEnter = 426, // 提交环形队列中的请求并等待完成
+    IpcCall = 500,      // 发送消息并等待回复
+    IpcReplyWait = 501, // 回复上一个请求并等待下一个请求
+    IpcReply = 502,     // 只回复，不等待
 } SyscallId;
 
 // 系统调用宏定义（用户态调用ECALL）
@@ -35,9 +59,30 @@ typedef enum {
 })
 
 // 不同参数个数系统调用宏拓展，没有参数时传递0
+#define sys_ioctl(__a0, __a1, __a2) sys_call(Ioctl, __a0, __a1, __a2, 0)
 #define sys_read(__a0, __a1, __a2) sys_call(Read, __a0, __a1, __a2, 0)
-#define sys_write(__a0) sys_call(Write, __a0, 0, 0, 0)
+#define sys_write(__a0, __a1, __a2) sys_call(Write, __a0, __a1, __a2, 0)
 #define sys_exit(__a0) sys_call(Exit, __a0, 0, 0, 0)
-#define sys_exec(__a0) sys_call(Exec, __a0, 0, 0, 0)
+#define sys_exec(__a0, __a1) sys_call(Exec, __a0, __a1, 0, 0)
+#define sys_close(__a0) sys_call(Close, __a0, 0, 0, 0)
+#define sys_pipe2(__a0) sys_call(Pipe2, __a0, 0, 0, 0)
+#define sys_vmsplice(__a0, __a1, __a2) sys_call(Vmsplice, __a0, __a1, __a2, 0)
+#define sys_futex_wait(__a0, __a1, __a2) sys_call(FutexWait, __a0, __a1, __a2, 0)
+#define sys_futex_wake(__a0, __a1) sys_call(FutexWake, __a0, __a1, 0, 0)
+#define sys_setpriority(__a0, __a1) sys_call(SetPriority, __a0, __a1, 0, 0)
+#define sys_gettid() sys_call(Gettid, 0, 0, 0, 0)
+#define sys_clone(__a0, __a1, __a2) sys_call(Clone, __a0, __a1, __a2, 0)
+#define sys_join(__a0) sys_call(Join, __a0, 0, 0, 0)
+#define sys_syslog(__a0, __a1, __a2) sys_call(Syslog, __a0, __a1, __a2, 0)
+#define sys_sched_yield() sys_call(SchedYield, 0, 0, 0, 0)
+#define sys_sched_setattr(__a0, __a1, __a2) sys_call(SchedSetattr, __a0, __a1, __a2, 0)
+#define sys_sched_getattr(__a0) sys_call(SchedGetattr, __a0, 0, 0, 0)
+#define sys_nanosleep(__a0, __a1) sys_call(Nanosleep, __a0, __a1, 0, 0)
+#define sys_clock_gettime() sys_call(ClockGettime, 0, 0, 0, 0)
+#define sys_shmget(__a0, __a1, __a2) sys_call(ShmGet, __a0, __a1, __a2, 0)
+#define sys_shmat(__a0, __a1) sys_call(ShmAt, __a0, __a1, 0, 0)
+#define sys_shmdt(__a0) sys_call(ShmDt, __a0, 0, 0, 0)
+#define sys_io_uring_setup(__a0) sys_call(IoUringSetup, __a0, 0, 0, 0)
+#define sys_io_uring_enter(__a0, __a1, __a2) sys_call(IoUringEnter, __a0, __a1, __a2, 0)
 
 #endif
\ No newline at end of file
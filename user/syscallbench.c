@@ -0,0 +1,37 @@
+/********************** 用户程序syscallbench.c ***************************
+ * Author：Joker001014
+ * 2025.03.30
+ * 测量空系统调用（gettid）的往返延迟，以及作为对比的不陷入内核的 vDSO 时钟读取
+***********************************************************************/
+
+#include "types.h"
+#include "ulib.h"
+
+#define CALLS       100000
+
+// 打印每次调用的平均耗时，纳秒保留一位小数
+static void
+report(char *name, uint64 ns, uint64 cycles)
+{
+    printf("syscallbench: %s %d.%d ns, %d cycles per call\n",
+            name, (int)(ns / CALLS), (int)(ns * 10 / CALLS % 10), (int)(cycles / CALLS));
+}
+
+uint64
+main()
+{
+    int i;
+    uint64 start = clockNs(), c = rdcycle();
+    for(i = 0; i < CALLS; i ++) {
+        gettid();
+    }
+    report("gettid    ", clockNs() - start, rdcycle() - c);
+
+    start = clockNs();
+    c = rdcycle();
+    for(i = 0; i < CALLS; i ++) {
+        clockNs();
+    }
+    report("vdso clock", clockNs() - start, rdcycle() - c);
+    return 0;
+}
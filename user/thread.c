@@ -0,0 +1,76 @@
+/*************************** U-Mode 线程 ******************************
+ * Author：Joker001014
+ * 2025.03.24
+ * 在当前进程中创建共享地址空间的线程，每个线程的 tp 指向自己的控制块
+***********************************************************************/
+
+#include "types.h"
+#include "ulib.h"
+#include "syscall.h"
+
+// 新线程的入口，a0 为控制块地址，执行线程函数后以其返回值退出
+static void
+threadEntry(UThread *t)
+{
+    uint64 ret = t->func(t->arg);
+    flush();
+    sys_exit(ret);
+}
+
+// 创建线程执行 func(arg)，成功返回 tid，失败返回负的错误码
+int
+threadCreate(UThread *t, uint64 (*func)(void *), void *arg)
+{
+    t->self = t;
+    t->func = func;
+    t->arg = arg;
+    t->local = 0;
+    long tid = (long)sys_clone(threadEntry, t, t);
+    t->tid = (int)tid;
+    return (int)tid;
+}
+
+// 等待线程退出并返回其线程函数的返回值
+uint64
+threadJoin(UThread *t)
+{
+    return sys_join(t->tid);
+}
+
+// 获取当前线程的控制块，主线程没有控制块，返回 0
+UThread *
+threadSelf()
+{
+    UThread *t;
+    asm volatile("mv %0, tp" : "=r"(t));
+    return t;
+}
+
+// 获取当前线程 tid
+int
+gettid()
+{
+    return (int)sys_gettid();
+}
+
+// 将当前线程设为实时线程：每 period 微秒内最多运行 runtime 微秒，须在 deadline 微秒内完成
+// runtime 为 0 时回到普通调度类；带宽不足时返回负数
+int
+schedSetattr(uint64 runtime, uint64 period, uint64 deadline)
+{
+    return (int)(long)sys_sched_setattr(runtime, period, deadline);
+}
+
+// 读取当前线程的实时参数和截止时刻统计
+int
+schedGetattr(SchedAttr *attr)
+{
+    return (int)(long)sys_sched_getattr(attr);
+}
+
+// 让出 CPU，实时线程表示本周期的作业已完成
+void
+schedYield()
+{
+    sys_sched_yield();
+}
@@ -0,0 +1,49 @@
+/************************* 用户程序threads.c ****************************
+ * Author：Joker001014
+ * 2025.03.24
+ * 多个线程共享地址空间，在互斥锁保护下累加同一个计数器
+***********************************************************************/
+
+#include "types.h"
+#include "ulib.h"
+
+#define THREADS     4
+#define ROUNDS      10000
+
+static Mutex LOCK;
+static uint64 COUNTER;
+
+// 线程函数：在互斥锁保护下累加计数器，返回 tp 是否指向自己的控制块
+uint64
+worker(void *arg)
+{
+    int i;
+    for(i = 0; i < ROUNDS; i ++) {
+        mutexLock(&LOCK);
+        COUNTER ++;
+        mutexUnlock(&LOCK);
+    }
+    printf("thread %d (tid %d) done\n", (int)(uint64)arg, gettid());
+    return threadSelf()->self == threadSelf();
+}
+
+uint64
+main()
+{
+    UThread threads[THREADS];
+    mutexInit(&LOCK);
+    int i;
+    for(i = 0; i < THREADS; i ++) {
+        if(threadCreate(&threads[i], worker, (void *)(uint64)i) < 0) {
+            printf("create thread %d failed\n", i);
+            return 1;
+        }
+    }
+    for(i = 0; i < THREADS; i ++) {
+        if(threadJoin(&threads[i]) != 1) {
+            printf("thread %d has wrong tp\n", i);
+        }
+    }
+    printf("counter = %d, expected %d\n", (int)COUNTER, THREADS * ROUNDS);
+    return 0;
+}
@@ -0,0 +1,38 @@
+/*************************** U-Mode 时间 ******************************
+ * Author：Joker001014
+ * 2025.03.28
+ * 单调时钟与休眠，休眠期间线程不占用 CPU
+ * 单调时钟从内核映射的共享数据页读取参数，直接读 time 计数器计算
+***********************************************************************/
+
+#include "types.h"
+#include "ulib.h"
+#include "syscall.h"
+
+// 启动以来的纳秒数，读 time 计数器并用共享数据页中的参数换算，不陷入内核
+uint64
+clockNs()
+{
+    return (rdtime() - VDSO->bootTime) * VDSO->nsPerTime;
+}
+
+// 通过系统调用读取同一个单调时钟，用于对比开销
+uint64
+clockNsSyscall()
+{
+    return sys_clock_gettime();
+}
+
+// 休眠 sec 秒加 nsec 纳秒，nsec 不小于 1 秒或总时长溢出时返回 -EINVAL
+long
+nanosleep(uint64 sec, uint64 nsec)
+{
+    return (long)sys_nanosleep(sec, nsec);
+}
+
+// 休眠 ms 毫秒
+void
+msleep(uint64 ms)
+{
+    sys_nanosleep(ms / 1000, (ms % 1000) * 1000000);
+}
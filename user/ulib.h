@@ -7,15 +7,218 @@
 #define _ULIB_H
 
 /*  io.c    */
-uint8 getc();
+// 标准输出的刷新策略
+#define BUF_NONE    0   // 不缓冲，每个字符立即输出
+#define BUF_LINE    1   // 行缓冲，遇到换行或缓冲区满时输出（默认）
+#define BUF_FULL    2   // 全缓冲，缓冲区满或调用 flush 时输出
+
+// 终端模式，与内核 stdin.h 中的定义一致
+#define TTY_RAW         0   // 原始模式：字符到达即可读，不回显
+#define TTY_CANONICAL   1   // 规范模式（默认）：内核回显并处理退格，整行输入完成后才可读
+#define TTY_SETMODE     0x5402
+
+// syslog 的操作，与内核 log.h 中的定义一致
+#define SYSLOG_READ_ALL         3   // 读取内核日志缓冲区中保留的全部日志
+#define SYSLOG_CONSOLE_LEVEL    8   // 设置输出到控制台的最低日志级别
+#define SYSLOG_KERNEL_STATS     100 // 把内核各子系统的统计信息写入日志
+
+#define EOF             (-1)    // getc 读到输入结束（标准输入为已关闭写端的管道）
+
+int  getc();
+int  ttyMode(int mode);
+long syslog(int type, char *buf, uint64 len);
 void printf(char *, ...);
 void panic(char*);
 void putchar(int c);
+void flush();
+void setBufferMode(int mode);
+long read(int fd, void *buf, uint64 len);
+long write(int fd, void *buf, uint64 len);
+int  pipe(int fds[2]);
+int  close(int fd);
+long vmsplice(int fd, void *addr, uint64 len);
+long exec(char *path, int stdio[2]);
 
 /*  malloc.c    */
 void *malloc(uint32 size);
 void free(void *ptr);
 
+/*  sync.c    */
+// 互斥锁：0-未加锁，1-已加锁且没有等待者，2-已加锁且可能有等待者
+typedef struct {
+    uint32 state;
+} Mutex;
+
+// 条件变量：每次通知时序号加一，等待者在序号改变前休眠
+typedef struct {
+    uint32 seq;
+} Cond;
+
+void mutexInit(Mutex *m);
+void mutexLock(Mutex *m);
+int  mutexTryLock(Mutex *m);
+void mutexUnlock(Mutex *m);
+void condInit(Cond *c);
+void condWait(Cond *c, Mutex *m);
+int  condTimedWait(Cond *c, Mutex *m, uint64 ns);
+void condSignal(Cond *c);
+void condBroadcast(Cond *c);
+
+/*  thread.c    */
+// 线程控制块，由创建者提供存储空间，同时作为新线程的线程局部存储（tp 指向它）
+typedef struct uthread {
+    struct uthread *self;       // 指向自身，线程通过 tp 找到自己的控制块
+    int tid;                    // 线程 tid
+    uint64 (*func)(void *);     // 线程函数
+    void *arg;                  // 线程函数参数
+    void *local;                // 留给用户程序的线程局部数据
+} UThread;
+
+int    threadCreate(UThread *t, uint64 (*func)(void *), void *arg);
+uint64 threadJoin(UThread *t);
+UThread *threadSelf();
+int    gettid();
+
+// 实时线程的参数和统计，时间单位为微秒，与内核 edf.h 中的定义一致
+typedef struct {
+    uint64 runtime;
+    uint64 period;
+    uint64 deadline;
+    uint64 jobs;        // 已开始的作业数
+    uint64 misses;      // 错过截止时刻的作业数
+    uint64 overruns;    // 用完预算被限流的次数
+} SchedAttr;
+
+int    schedSetattr(uint64 runtime, uint64 period, uint64 deadline);
+int    schedGetattr(SchedAttr *attr);
+void   schedYield();
+
+/*  time.c    */
+// 内核只读映射到每个进程的共享数据页，与内核 vdso.h 中的定义一致
+#define VDSO_ADDR   0xfffffffeffffe000UL
+#define VDSO_HARTS  4
+
+typedef struct {
+    int tid;            // 正在运行的线程号，-1 表示空闲
+    uint32 reserved;
+    uint64 switches;    // 开始运行一个线程的次数
+    uint64 idleWaits;   // 无线程可运行而进入 wfi 的次数
+} VdsoHart;
+
+typedef struct {
+    uint32 version;
+    uint32 harts;
+    uint64 timebaseFreq;
+    uint64 nsPerTime;
+    uint64 bootTime;
+    VdsoHart hart[VDSO_HARTS];
+} VdsoData;
+
+#define VDSO        ((volatile VdsoData *)VDSO_ADDR)
+
+// 直接读取计数器（内核已通过 scounteren 开放），不需要系统调用
+static inline uint64
+rdtime()
+{
+    uint64 x;
+    asm volatile("rdtime %0" : "=r"(x));
+    return x;
+}
+
+static inline uint64
+rdcycle()
+{
+    uint64 x;
+    asm volatile("rdcycle %0" : "=r"(x));
+    return x;
+}
+
+static inline uint64
+rdinstret()
+{
+    uint64 x;
+    asm volatile("rdinstret %0" : "=r"(x));
+    return x;
+}
+
+uint64 clockNs();
+uint64 clockNsSyscall();
+long   nanosleep(uint64 sec, uint64 nsec);
+void   msleep(uint64 ms);
+
+/*  uring.c    */
+// 异步系统调用的环形队列，与内核 uring.h 中的定义一致
+#define URING_SQ_ENTRIES    64
+#define URING_CQ_ENTRIES    256
+
+#define URING_OP_NOP        0       // 空操作
+#define URING_OP_READ       1       // 同 read(fd, addr, len)
+#define URING_OP_WRITE      2       // 同 write(fd, addr, len)
+#define URING_OP_TIMEOUT    3       // len 纳秒后完成
+#define URING_OP_EXEC       4       // 执行 addr 处路径的程序，程序退出后完成
+
+#define URING_SETUP_SQPOLL      (1 << 1)    // 由内核轮询线程取走请求，提交不需要系统调用
+#define URING_ENTER_GETEVENTS   (1 << 0)
+#define URING_ENTER_SQ_WAKEUP   (1 << 1)
+#define URING_SQ_NEED_WAKEUP    (1 << 0)
+
+typedef struct {
+    uint8 opcode;
+    uint8 flags;
+    uint16 reserved;
+    int fd;
+    uint64 addr;
+    uint64 len;
+    uint64 userData;
+} IoSqe;
+
+typedef struct {
+    uint64 userData;
+    long res;
+} IoCqe;
+
+typedef struct {
+    uint32 sqHead;
+    uint32 sqTail;
+    uint32 cqHead;
+    uint32 cqTail;
+    uint32 sqEntries;
+    uint32 cqEntries;
+    uint32 flags;
+    uint32 reserved;
+    IoSqe sqes[URING_SQ_ENTRIES];
+} IoRingShared;
+
+// 用户侧的环形队列句柄
+typedef struct {
+    IoRingShared *sh;   // 共享区第 0 页：队列头和提交队列
+    IoCqe *cqes;        // 共享区第 1 页：完成队列
+    uint32 sqTail;      // 已填写尚未发布的提交队列尾
+    int sqpoll;         // 是否由内核轮询线程取走请求
+} IoUring;
+
+int    uringSetup(IoUring *ring, int flags);
+IoSqe *uringGetSqe(IoUring *ring);
+long   uringSubmit(IoUring *ring, int wait);
+IoCqe *uringPeekCqe(IoUring *ring);
+IoCqe *uringWaitCqe(IoUring *ring);
+void   uringCqeSeen(IoUring *ring);
+
+/*  shm.c    */
+int   shmCreate(char *name, uint64 size);
+void *shmAttach(int id, void *addr);
+int   shmDetach(void *addr);
+
+/*  ipc.c    */
+// 同步 IPC 的消息，由 a1 ~ a4 直接传递
+typedef struct {
+    uint64 w[4];
+} IpcMsg;
+
+long ipcCall(int port, IpcMsg *msg);
+long ipcReplyWait(int port, long replyTo, IpcMsg *msg);
+long ipcReply(int port, long replyTo, IpcMsg *msg);
+
 /*  string.c    */
 int strcmp(char *str1, char *str2);
 int strlen(char *str);
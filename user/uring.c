@@ -0,0 +1,95 @@
+/************************ U-Mode 异步系统调用 ****************************
+ * Author：Joker001014
+ * 2025.03.30
+ * 对内核共享的提交/完成环形队列的封装
+ *      uringGetSqe 取得提交队列的空槽位，填写后由 uringSubmit 一次发布并提交
+ *      完成项直接从共享内存读取，只有需要等待时才陷入内核
+***********************************************************************/
+
+#include "types.h"
+#include "ulib.h"
+#include "syscall.h"
+
+// 为当前进程创建环形队列，flags 为 URING_SETUP_SQPOLL 时由内核轮询线程取走请求
+// 返回 0 成功，否则为内核返回的错误码
+int
+uringSetup(IoUring *ring, int flags)
+{
+    long addr = (long)sys_io_uring_setup(flags);
+    if(addr < 0 && addr > -4096) {
+        return (int)addr;
+    }
+    ring->sh = (IoRingShared *)addr;
+    ring->cqes = (IoCqe *)(addr + 4096);
+    ring->sqTail = ring->sh->sqTail;
+    ring->sqpoll = (flags & URING_SETUP_SQPOLL) != 0;
+    return 0;
+}
+
+// 取得提交队列的下一个空槽位，队列已满时返回 0
+IoSqe *
+uringGetSqe(IoUring *ring)
+{
+    uint32 head = __atomic_load_n(&ring->sh->sqHead, __ATOMIC_ACQUIRE);
+    if(ring->sqTail - head == URING_SQ_ENTRIES) {
+        return 0;
+    }
+    IoSqe *sqe = &ring->sh->sqes[ring->sqTail & (URING_SQ_ENTRIES - 1)];
+    ring->sqTail += 1;
+    sqe->flags = 0;
+    sqe->reserved = 0;
+    return sqe;
+}
+
+/*
+ * 发布已填写的请求并提交，wait 不为 0 时再等待完成队列中至少有 wait 项
+ * 有轮询线程时不陷入内核，除非轮询线程已休眠或需要等待
+ * 返回内核取走的请求数（轮询模式下为 0）
+ */
+long
+uringSubmit(IoUring *ring, int wait)
+{
+    __atomic_store_n(&ring->sh->sqTail, ring->sqTail, __ATOMIC_SEQ_CST);
+    uint32 flags = wait ? URING_ENTER_GETEVENTS : 0;
+    if(ring->sqpoll) {
+        if(__atomic_load_n(&ring->sh->flags, __ATOMIC_SEQ_CST) & URING_SQ_NEED_WAKEUP) {
+            flags |= URING_ENTER_SQ_WAKEUP;
+        }
+        if(flags == 0) {
+            return 0;
+        }
+        return (long)sys_io_uring_enter(0, wait, flags);
+    }
+    uint32 pending = ring->sqTail - __atomic_load_n(&ring->sh->sqHead, __ATOMIC_ACQUIRE);
+    return (long)sys_io_uring_enter(pending, wait, flags);
+}
+
+// 取得最早的未处理完成项，没有时返回 0，不陷入内核
+IoCqe *
+uringPeekCqe(IoUring *ring)
+{
+    uint32 head = ring->sh->cqHead;
+    if(head == __atomic_load_n(&ring->sh->cqTail, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    return &ring->cqes[head & (URING_CQ_ENTRIES - 1)];
+}
+
+// 取得最早的未处理完成项，没有时在内核中等待；没有执行中的请求时返回 0
+IoCqe *
+uringWaitCqe(IoUring *ring)
+{
+    IoCqe *cqe = uringPeekCqe(ring);
+    if(cqe == 0) {
+        uringSubmit(ring, 1);
+        cqe = uringPeekCqe(ring);
+    }
+    return cqe;
+}
+
+// 完成项处理完毕，归还其槽位
+void
+uringCqeSeen(IoUring *ring)
+{
+    __atomic_store_n(&ring->sh->cqHead, ring->sh->cqHead + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,82 @@
+/*********************** 用户程序uringbench.c ****************************
+ * Author：Joker001014
+ * 2025.03.30
+ * 比较逐个系统调用与通过环形队列批量提交的吞吐量，请求为长度为 0 的 write，只测量进出内核的开销
+ *      syscall：每个请求一次 write 系统调用
+ *      batched：每 BATCH 个请求一次 io_uring_enter，完成项直接从共享内存收割
+ *      sqpoll ：由内核轮询线程取走请求，提交和收割都不陷入内核
+***********************************************************************/
+
+#include "types.h"
+#include "ulib.h"
+
+#define OPS         20000
+#define BATCH       32
+
+static char BUF[1];
+
+// 打印一种方式的吞吐量
+static void
+report(char *name, uint64 ns)
+{
+    printf("uringbench: %s %d ops in %d us, %d ops/sec\n",
+            name, OPS, (int)(ns / 1000), (int)((uint64)OPS * 1000000000 / (ns ? ns : 1)));
+}
+
+// 通过环形队列完成 OPS 个请求，每次最多填写 BATCH 个
+static uint64
+runRing(IoUring *ring)
+{
+    uint64 start = clockNs();
+    int issued = 0, done = 0;
+    while(done < OPS) {
+        int n = 0;
+        IoSqe *sqe;
+        while(issued < OPS && n < BATCH && (sqe = uringGetSqe(ring)) != 0) {
+            sqe->opcode = URING_OP_WRITE;
+            sqe->fd = 1;
+            sqe->addr = (uint64)BUF;
+            sqe->len = 0;
+            sqe->userData = issued;
+            issued ++;
+            n ++;
+        }
+        uringSubmit(ring, ring->sqpoll ? 0 : n);
+        IoCqe *cqe;
+        while((cqe = uringPeekCqe(ring)) != 0) {
+            if(cqe->res != 0) {
+                printf("uringbench: request %d failed %d\n", (int)cqe->userData, (int)cqe->res);
+            }
+            uringCqeSeen(ring);
+            done ++;
+        }
+    }
+    return clockNs() - start;
+}
+
+uint64
+main()
+{
+    int i;
+    flush();
+    uint64 start = clockNs();
+    for(i = 0; i < OPS; i ++) {
+        write(1, BUF, 0);
+    }
+    report("syscall", clockNs() - start);
+
+    IoUring ring;
+    if(uringSetup(&ring, 0) < 0) {
+        printf("uringbench: io_uring_setup failed\n");
+        return 1;
+    }
+    report("batched", runRing(&ring));
+
+    // 为同一组队列启动轮询线程
+    if(uringSetup(&ring, URING_SETUP_SQPOLL) < 0) {
+        printf("uringbench: sqpoll setup failed\n");
+        return 1;
+    }
+    report("sqpoll ", runRing(&ring));
+    return 0;
+}
@@ -0,0 +1,27 @@
+/************************** 用户程序wc.c ********************************
+ * Author：Joker001014
+ * 2025.03.30
+ * 从标准输入读到结束，统计行数和字节数，用于管道的末端，如 hello | wc
+***********************************************************************/
+
+#include "types.h"
+#include "ulib.h"
+
+uint64
+main()
+{
+    char buf[512];
+    uint64 lines = 0, bytes = 0;
+    long n;
+    while((n = read(0, buf, sizeof(buf))) > 0) {
+        int i;
+        for(i = 0; i < n; i ++) {
+            if(buf[i] == '\n') {
+                lines ++;
+            }
+        }
+        bytes += n;
+    }
+    printf("%d lines, %d bytes\n", (int)lines, (int)bytes);
+    return 0;
+}